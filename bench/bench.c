@@ -0,0 +1,406 @@
+// End-to-end benchmark runner used by `make bench`.
+//
+// Every benchmark spawns the real `wodo` binary inside a repository made by
+// `genrepo`, so the numbers include process startup, database load and I/O.
+// Results are written as JSON (one benchmark per line so it's easy to diff)
+// and compared against a stored baseline when one exists.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define MAX_ARGS 8
+
+typedef struct {
+    const char *name;
+    const char *args[MAX_ARGS];
+    // file used as stdin, NULL means /dev/null
+    const char *stdin_path;
+    // bytes processed by one run, used for throughput
+    uint64_t bytes;
+    // `init` runs on a fresh directory every time
+    bool fresh_directory;
+    // `add` creates a file that must be removed after each run
+    bool cleanup_added_file;
+} Benchmark;
+
+typedef struct {
+    const char *wodo;
+    const char *repository;
+    const char *out;
+    const char *baseline;
+    int runs;
+    int warmup;
+    double threshold;
+} Options;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t file_size(const char *path) {
+    struct stat st;
+
+    if (stat(path, &st) != 0) return 0;
+
+    return (uint64_t)st.st_size;
+}
+
+static uint64_t repository_size(const char *repository) {
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s/.wodo", repository);
+
+    DIR *dir = opendir(path);
+
+    if (dir == NULL) return 0;
+
+    uint64_t total = 0;
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+        char file_path[8192];
+
+        snprintf(file_path, sizeof(file_path), "%s/%s", path, entry->d_name);
+
+        total += file_size(file_path);
+    }
+
+    closedir(dir);
+
+    return total;
+}
+
+// runs the command and returns its wall time, -1 when it could not run or exited
+// with an error. stdout is captured only when `out` is not NULL
+static int64_t run(const Options *options, const char *cwd, const Benchmark *benchmark, char *out, size_t out_size) {
+    int pipe_fds[2] = { -1, -1 };
+
+    if (out != NULL && pipe(pipe_fds) != 0) return -1;
+
+    uint64_t start = now_ns();
+
+    pid_t pid = fork();
+
+    if (pid < 0) return -1;
+
+    if (pid == 0) {
+        if (chdir(cwd) != 0) _exit(127);
+
+        int in = open(benchmark->stdin_path != NULL ? benchmark->stdin_path : "/dev/null", O_RDONLY);
+        int null = open("/dev/null", O_WRONLY);
+
+        if (in < 0 || null < 0) _exit(127);
+
+        dup2(in, STDIN_FILENO);
+        dup2(out != NULL ? pipe_fds[1] : null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+
+        if (out != NULL) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+        }
+
+        char *argv[MAX_ARGS + 2] = { (char *)options->wodo };
+
+        for (int i = 0; i < MAX_ARGS && benchmark->args[i] != NULL; i++) {
+            argv[i + 1] = (char *)benchmark->args[i];
+        }
+
+        execv(options->wodo, argv);
+
+        _exit(127);
+    }
+
+    if (out != NULL) {
+        close(pipe_fds[1]);
+
+        size_t used = 0;
+        ssize_t n;
+
+        while ((n = read(pipe_fds[0], out + used, out_size - used - 1)) > 0) {
+            used += n;
+
+            if (used + 1 >= out_size) break;
+        }
+
+        out[used] = '\0';
+
+        close(pipe_fds[0]);
+    }
+
+    int status;
+
+    if (waitpid(pid, &status, 0) < 0) return -1;
+
+    uint64_t elapsed = now_ns() - start;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return -1;
+
+    return (int64_t)elapsed;
+}
+
+static void remove_directory(const char *path) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        execlp("rm", "rm", "-rf", path, (char *)NULL);
+        _exit(127);
+    }
+
+    if (pid > 0) waitpid(pid, NULL, 0);
+}
+
+static int64_t run_once(const Options *options, const Benchmark *benchmark) {
+    if (benchmark->fresh_directory) {
+        char directory[] = "/tmp/wodo-bench-init-XXXXXX";
+
+        if (mkdtemp(directory) == NULL) return -1;
+
+        int64_t elapsed = run(options, directory, benchmark, NULL, 0);
+
+        remove_directory(directory);
+
+        return elapsed;
+    }
+
+    if (benchmark->cleanup_added_file) {
+        char path[4096];
+
+        int64_t elapsed = run(options, options->repository, benchmark, path, sizeof(path));
+
+        if (elapsed < 0) return elapsed;
+
+        path[strcspn(path, "\n")] = '\0';
+
+        Benchmark remove = { .name = "remove", .args = { "remove", path } };
+
+        if (run(options, options->repository, &remove, NULL, 0) < 0) return -1;
+
+        return elapsed;
+    }
+
+    return run(options, options->repository, benchmark, NULL, 0);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, int count, double p) {
+    int index = (int)(p * (count - 1) + 0.5);
+
+    return sorted[index];
+}
+
+// reads "p50_ns" of `name` from a file written by this program
+static bool baseline_p50(const char *baseline, const char *name, uint64_t *out) {
+    FILE *file = fopen(baseline, "r");
+
+    if (file == NULL) return false;
+
+    char key[128];
+    char line[1024];
+    bool found = false;
+
+    snprintf(key, sizeof(key), "{\"name\":\"%s\",", name);
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *start = strstr(line, key);
+
+        if (start == NULL) continue;
+
+        char *p50 = strstr(start, "\"p50_ns\":");
+
+        if (p50 == NULL) continue;
+
+        *out = strtoull(p50 + strlen("\"p50_ns\":"), NULL, 10);
+        found = true;
+
+        break;
+    }
+
+    fclose(file);
+
+    return found;
+}
+
+static void usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s --wodo <bin> --repo <dir> [options]\n\n", program_name);
+    fprintf(stderr, "  --runs <n>           Measured runs per benchmark (default 30)\n");
+    fprintf(stderr, "  --warmup <n>         Unmeasured runs per benchmark (default 3)\n");
+    fprintf(stderr, "  --out <file>         Write the results to <file> instead of stdout\n");
+    fprintf(stderr, "  --baseline <file>    Compare p50 against a previous result\n");
+    fprintf(stderr, "  --threshold <pct>    Slowdown that counts as regression (default 10)\n");
+}
+
+int main(int argc, char **argv) {
+    Options options = {
+        .runs = 30,
+        .warmup = 3,
+        .threshold = 10.0,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL) {
+            usage(argv[0]);
+
+            return 1;
+        }
+
+        if (strcmp(arg, "--wodo") == 0) options.wodo = value;
+        else if (strcmp(arg, "--repo") == 0) options.repository = value;
+        else if (strcmp(arg, "--out") == 0) options.out = value;
+        else if (strcmp(arg, "--baseline") == 0) options.baseline = value;
+        else if (strcmp(arg, "--runs") == 0) options.runs = atoi(value);
+        else if (strcmp(arg, "--warmup") == 0) options.warmup = atoi(value);
+        else if (strcmp(arg, "--threshold") == 0) options.threshold = atof(value);
+        else {
+            usage(argv[0]);
+
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (options.wodo == NULL || options.repository == NULL || options.runs <= 0) {
+        usage(argv[0]);
+
+        return 1;
+    }
+
+    // execv does not search PATH, so make the binary path absolute before changing directories
+    char *wodo = realpath(options.wodo, NULL);
+
+    if (wodo == NULL) {
+        fprintf(stderr, "error: invalid wodo binary %s: %s\n", options.wodo, strerror(errno));
+
+        return 1;
+    }
+
+    options.wodo = wodo;
+
+    char input_path[4096];
+
+    snprintf(input_path, sizeof(input_path), "%s/input.wodo", options.repository);
+
+    uint64_t input_size = file_size(input_path);
+    uint64_t repo_size = repository_size(options.repository);
+
+    Benchmark benchmarks[] = {
+        { .name = "init", .args = { "init" }, .fresh_directory = true },
+        { .name = "add", .args = { "add", "bench task file" }, .cleanup_added_file = true },
+        { .name = "list", .args = { "list" }, .bytes = repo_size },
+        { .name = "list_ft", .args = { "list", "-ft", "tag_a" }, .bytes = repo_size },
+        { .name = "reminders", .args = { "reminders" }, .bytes = repo_size },
+        { .name = "parse", .args = { "parse", "input.wodo" }, .stdin_path = input_path, .bytes = input_size },
+        { .name = "format", .args = { "format", "input.wodo" }, .stdin_path = input_path, .bytes = input_size },
+    };
+
+    size_t benchmarks_count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+    FILE *out = stdout;
+
+    if (options.out != NULL) {
+        out = fopen(options.out, "w");
+
+        if (out == NULL) {
+            fprintf(stderr, "error: could not open %s: %s\n", options.out, strerror(errno));
+
+            return 1;
+        }
+    }
+
+    uint64_t *samples = malloc(sizeof(uint64_t) * options.runs);
+    int regressions = 0;
+
+    fprintf(out, "{\"runs\":%d,\"benchmarks\":[\n", options.runs);
+
+    for (size_t i = 0; i < benchmarks_count; i++) {
+        Benchmark *benchmark = &benchmarks[i];
+
+        fprintf(stderr, "bench: %s\n", benchmark->name);
+
+        for (int j = 0; j < options.warmup; j++) run_once(&options, benchmark);
+
+        uint64_t total = 0;
+
+        for (int j = 0; j < options.runs; j++) {
+            int64_t elapsed = run_once(&options, benchmark);
+
+            if (elapsed < 0) {
+                fprintf(stderr, "error: benchmark %s failed to run\n", benchmark->name);
+
+                return 1;
+            }
+
+            samples[j] = (uint64_t)elapsed;
+            total += samples[j];
+        }
+
+        qsort(samples, options.runs, sizeof(uint64_t), compare_u64);
+
+        uint64_t p50 = percentile(samples, options.runs, 0.50);
+        uint64_t p99 = percentile(samples, options.runs, 0.99);
+        double mean = (double)total / options.runs;
+
+        fprintf(out, "{\"name\":\"%s\",", benchmark->name);
+        fprintf(out, "\"min_ns\":%lu,", samples[0]);
+        fprintf(out, "\"p50_ns\":%lu,", p50);
+        fprintf(out, "\"p99_ns\":%lu,", p99);
+        fprintf(out, "\"mean_ns\":%.0f,", mean);
+        fprintf(out, "\"ops_per_sec\":%.2f", 1e9 / mean);
+
+        if (benchmark->bytes > 0) {
+            fprintf(out, ",\"bytes\":%lu,\"bytes_per_sec\":%.0f", benchmark->bytes, benchmark->bytes * 1e9 / mean);
+        }
+
+        uint64_t baseline;
+
+        if (options.baseline != NULL && baseline_p50(options.baseline, benchmark->name, &baseline) && baseline > 0) {
+            double delta = ((double)p50 - (double)baseline) * 100.0 / (double)baseline;
+            bool regression = delta > options.threshold;
+
+            if (regression) regressions++;
+
+            fprintf(out, ",\"baseline_p50_ns\":%lu,\"delta_pct\":%.2f,\"regression\":%s", baseline, delta, regression ? "true" : "false");
+        }
+
+        fprintf(out, "}%s\n", i + 1 < benchmarks_count ? "," : "");
+    }
+
+    fprintf(out, "],\"regressions\":%d}\n", regressions);
+
+    if (out != stdout) fclose(out);
+
+    free(samples);
+    free(wodo);
+
+    if (regressions > 0) {
+        fprintf(stderr, "bench: %d benchmark(s) regressed more than %.1f%%\n", regressions, options.threshold);
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+// Synthetic repository generator used by `make bench`.
+//
+// It builds a deterministic .wodo repository (same seed, same bytes) with a
+// configurable number of files, tasks per file, tags vocabulary and
+// description size. Besides the repository it writes a standalone
+// `input.wodo` file used to benchmark `parse` and `format` from stdin.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+typedef struct {
+    const char *out;
+    int files;
+    int tasks;
+    int tags;
+    int description_size;
+    int input_tasks;
+    uint64_t seed;
+} Options;
+
+static uint64_t rng_state;
+
+static uint64_t rng(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static int rng_range(int min, int max) {
+    if (max <= min) return min;
+
+    return min + (int)(rng() % (uint64_t)(max - min + 1));
+}
+
+static const char *words[] = {
+    "fix", "add", "remove", "parser", "database", "review", "deploy", "write",
+    "docs", "release", "cache", "index", "bug", "feature", "refactor", "test",
+    "plugin", "picker", "format", "date", "timezone", "reminder", "archive", "sync",
+    "the", "a", "for", "with", "on", "and", "to", "from",
+};
+
+#define WORDS_COUNT (sizeof(words) / sizeof(words[0]))
+
+static const char *states[] = { "todo", "doing", "blocked", "done" };
+
+static void write_tag(FILE *file, int index) {
+    // tags only accept [a-z_]
+    fprintf(file, "tag_");
+
+    do {
+        fputc('a' + index % 26, file);
+        index /= 26;
+    } while (index > 0);
+}
+
+static void write_words(FILE *file, int count) {
+    for (int i = 0; i < count; i++) {
+        if (i > 0) fputc(' ', file);
+
+        fputs(words[rng() % WORDS_COUNT], file);
+    }
+}
+
+static void write_task(FILE *file, const Options *options, int index) {
+    fprintf(file, "%% ");
+    write_words(file, rng_range(2, 8));
+    fprintf(file, " #%d\n\n", index);
+
+    fprintf(file, ".state %s\n", states[rng() % 4]);
+
+    int offset = rng_range(-12, 13);
+
+    fprintf(file, ".date %04d-%02d-%02d %02d:%02d:%02d",
+            rng_range(2024, 2027), rng_range(1, 12), rng_range(1, 28),
+            rng_range(0, 23), rng_range(0, 59), rng_range(0, 59));
+
+    if (offset == 0) {
+        fprintf(file, "Z\n");
+    } else {
+        fprintf(file, "%c%02d:%02d\n", offset < 0 ? '-' : '+', abs(offset), (int)(rng() % 2) * 30);
+    }
+
+    fprintf(file, ".tags");
+
+    int tags_count = options->tags > 0 ? rng_range(0, 4) : 0;
+
+    for (int i = 0; i < tags_count; i++) {
+        fputc(' ', file);
+        write_tag(file, (int)(rng() % options->tags));
+    }
+
+    fputc('\n', file);
+
+    if (rng() % 20 == 0) fprintf(file, ".remind\n");
+
+    int description_size = rng_range(options->description_size / 2, options->description_size * 3 / 2);
+
+    if (description_size > 0) {
+        fputc('\n', file);
+
+        int written = 0;
+
+        while (written < description_size) {
+            const char *word = words[rng() % WORDS_COUNT];
+
+            if (rng() % 40 == 0) {
+                fputs("\"quoted\"", file);
+                written += 8;
+            } else {
+                fputs(word, file);
+                written += strlen(word);
+            }
+
+            if (rng() % 12 == 0) {
+                fputc('\n', file);
+            } else {
+                fputc(' ', file);
+            }
+
+            written++;
+        }
+
+        fputc('\n', file);
+    }
+
+    fputc('\n', file);
+}
+
+static int write_database(const Options *options, const char *wodo_folder) {
+    char path[8192];
+
+    snprintf(path, sizeof(path), "%s/.wodo.db", wodo_folder);
+
+    FILE *db = fopen(path, "wb");
+
+    if (db == NULL) {
+        fprintf(stderr, "error: could not create %s: %s\n", path, strerror(errno));
+
+        return 1;
+    }
+
+    // same layout as `save_database_latest_version` (DBV_2)
+    short version = 2;
+    uint64_t length = options->files;
+
+    fwrite(".WODO", sizeof(char), 6, db);
+    fwrite(&version, sizeof(short), 1, db);
+    fwrite(&length, sizeof(uint64_t), 1, db);
+
+    for (int i = 0; i < options->files; i++) {
+        char name[64];
+        char relative[64];
+
+        snprintf(name, sizeof(name), "Project %d", i);
+        snprintf(relative, sizeof(relative), "bench-%06d.wodo", i);
+
+        uint64_t name_size = strlen(name) + 1;
+        uint64_t path_size = strlen(relative) + 1;
+
+        fwrite(&name_size, sizeof(uint64_t), 1, db);
+        fwrite(name, sizeof(char), name_size, db);
+        fwrite(&path_size, sizeof(uint64_t), 1, db);
+        fwrite(relative, sizeof(char), path_size, db);
+    }
+
+    fclose(db);
+
+    return 0;
+}
+
+static void usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s --out <dir> [options]\n\n", program_name);
+    fprintf(stderr, "  --files <n>          Number of files in the repository (default 100)\n");
+    fprintf(stderr, "  --tasks <n>          Average tasks per file, it varies +-50%% (default 50)\n");
+    fprintf(stderr, "  --tags <n>           Tags vocabulary size (default 32)\n");
+    fprintf(stderr, "  --description <n>    Average description size in bytes (default 256)\n");
+    fprintf(stderr, "  --input-tasks <n>    Tasks in the standalone input.wodo (default 5000)\n");
+    fprintf(stderr, "  --seed <n>           Random seed (default 42)\n");
+}
+
+int main(int argc, char **argv) {
+    Options options = {
+        .out = NULL,
+        .files = 100,
+        .tasks = 50,
+        .tags = 32,
+        .description_size = 256,
+        .input_tasks = 5000,
+        .seed = 42,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL) {
+            usage(argv[0]);
+
+            return 1;
+        }
+
+        if (strcmp(arg, "--out") == 0) options.out = value;
+        else if (strcmp(arg, "--files") == 0) options.files = atoi(value);
+        else if (strcmp(arg, "--tasks") == 0) options.tasks = atoi(value);
+        else if (strcmp(arg, "--tags") == 0) options.tags = atoi(value);
+        else if (strcmp(arg, "--description") == 0) options.description_size = atoi(value);
+        else if (strcmp(arg, "--input-tasks") == 0) options.input_tasks = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = strtoull(value, NULL, 10);
+        else {
+            usage(argv[0]);
+
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (options.out == NULL) {
+        usage(argv[0]);
+
+        return 1;
+    }
+
+    rng_state = options.seed == 0 ? 1 : options.seed;
+
+    char wodo_folder[4096];
+
+    snprintf(wodo_folder, sizeof(wodo_folder), "%s/.wodo", options.out);
+
+    if (mkdir(options.out, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "error: could not create %s: %s\n", options.out, strerror(errno));
+
+        return 1;
+    }
+
+    if (mkdir(wodo_folder, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "error: could not create %s: %s\n", wodo_folder, strerror(errno));
+
+        return 1;
+    }
+
+    if (write_database(&options, wodo_folder) != 0) return 1;
+
+    size_t total_tasks = 0;
+
+    for (int i = 0; i < options.files; i++) {
+        char path[8192];
+
+        snprintf(path, sizeof(path), "%s/bench-%06d.wodo", wodo_folder, i);
+
+        FILE *file = fopen(path, "w");
+
+        if (file == NULL) {
+            fprintf(stderr, "error: could not create %s: %s\n", path, strerror(errno));
+
+            return 1;
+        }
+
+        int tasks = rng_range(options.tasks / 2, options.tasks * 3 / 2);
+
+        for (int j = 0; j < tasks; j++) write_task(file, &options, j);
+
+        total_tasks += tasks;
+
+        fclose(file);
+    }
+
+    char input_path[8192];
+
+    snprintf(input_path, sizeof(input_path), "%s/input.wodo", options.out);
+
+    FILE *input = fopen(input_path, "w");
+
+    if (input == NULL) {
+        fprintf(stderr, "error: could not create %s: %s\n", input_path, strerror(errno));
+
+        return 1;
+    }
+
+    for (int j = 0; j < options.input_tasks; j++) write_task(input, &options, j);
+
+    fclose(input);
+
+    printf("generated %d files with %zu tasks at %s\n", options.files, total_tasks, options.out);
+
+    return 0;
+}
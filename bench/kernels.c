@@ -0,0 +1,436 @@
+// Kernel-level microbenchmarks used by `make bench-kernels`.
+//
+// Each kernel runs in-process over a fixed corpus (the input.wodo made by
+// `genrepo` and its repository). The harness pins the CPU, warms up, grows
+// the iteration count until a batch is long enough to time, and reports
+// ns/op and bytes/s together with hardware counters read through
+// perf_event_open. When counters are not available (containers, missing
+// permissions) it falls back to plain timers and prints them as null.
+#define _GNU_SOURCE
+#define CL_ARRAY_IMPLEMENTATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "../src/arr.h"
+#include "../src/database.h"
+#include "../src/date.h"
+#include "../src/io.h"
+#include "../src/parser.h"
+#include "../src/utils.h"
+#include "../src/visualizer.h"
+
+// defined in wodo.c, which is not linked here
+Database global_database = {0};
+
+database_status_code_t load_database_v2(FILE *file);
+
+#define COUNTERS_COUNT 4
+#define MIN_BATCH_NS 20000000ULL
+#define SAMPLES 7
+
+typedef struct {
+    const char *name;
+    void (*run)(uint64_t iterations);
+    // average bytes processed by one op, 0 when it does not make sense
+    double bytes_per_op;
+} Kernel;
+
+typedef struct {
+    int group_fd;
+    int fds[COUNTERS_COUNT];
+    bool available;
+} Counters;
+
+static const char *counters_names[COUNTERS_COUNT] = { "cycles", "instructions", "branch_misses", "cache_misses" };
+static const uint64_t counters_configs[COUNTERS_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+// corpus
+static char *corpus = NULL;
+static size_t corpus_length = 0;
+static wodo_task_t *corpus_tasks = CL_ARRAY_INIT;
+static const char *db_path = NULL;
+static Flags tag_flags = {0};
+static FILE *devnull = NULL;
+
+// keeps the compiler from dropping results
+static volatile uint64_t sink = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags) {
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static Counters counters_open(void) {
+    Counters counters = { .group_fd = -1, .available = true };
+
+    for (int i = 0; i < COUNTERS_COUNT; i++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counters_configs[i];
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        counters.fds[i] = (int)perf_event_open(&attr, 0, -1, counters.group_fd, 0);
+
+        if (counters.fds[i] < 0) {
+            for (int j = 0; j < i; j++) close(counters.fds[j]);
+
+            counters.available = false;
+
+            return counters;
+        }
+
+        if (i == 0) counters.group_fd = counters.fds[0];
+    }
+
+    return counters;
+}
+
+static void counters_start(Counters *counters) {
+    if (!counters->available) return;
+
+    ioctl(counters->group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static bool counters_stop(Counters *counters, uint64_t values[COUNTERS_COUNT]) {
+    if (!counters->available) return false;
+
+    ioctl(counters->group_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    struct { uint64_t nr; uint64_t values[COUNTERS_COUNT]; } data;
+
+    if (read(counters->group_fd, &data, sizeof(data)) != (ssize_t)sizeof(data) || data.nr != COUNTERS_COUNT) {
+        return false;
+    }
+
+    memcpy(values, data.values, sizeof(data.values));
+
+    return true;
+}
+
+// one op = parse the whole corpus
+static void kernel_parse_tasks(uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        reset_parser_state();
+
+        wodo_task_t *tasks = parse_tasks("input.wodo", corpus, corpus_length);
+
+        sink += cl_arr_len(tasks);
+
+        free_tasks(tasks);
+    }
+}
+
+// one op = escape one description
+static void kernel_print_scaped_string(uint64_t iterations) {
+    size_t count = cl_arr_len(corpus_tasks);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        print_scaped_string_to_fd(corpus_tasks[i % count].description.string, devnull);
+    }
+}
+
+// one op = print one date (including the conversion)
+static void kernel_print_wodo_datetime(uint64_t iterations) {
+    size_t count = cl_arr_len(corpus_tasks);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        print_wodo_datetime(corpus_tasks[i % count].date_property.datetime, false);
+    }
+}
+
+// one op = convert one date
+static void kernel_convert_to_local(uint64_t iterations) {
+    size_t count = cl_arr_len(corpus_tasks);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        wodo_datetime_t local = convert_to_local(corpus_tasks[i % count].date_property.datetime);
+
+        sink += local.minute;
+    }
+}
+
+// one op = test one task against a tag filter
+static void kernel_default_task_predicate(uint64_t iterations) {
+    size_t count = cl_arr_len(corpus_tasks);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += default_task_predicate(corpus_tasks[i % count], tag_flags);
+    }
+}
+
+// one op = load the whole database file
+static void kernel_load_database_v2(uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        FILE *file = fopen(db_path, "rb");
+
+        if (file == NULL) {
+            fprintf(stderr, "error: could not open %s: %s\n", db_path, strerror(errno));
+            exit(1);
+        }
+
+        // magic bytes + \0 + version
+        fseek(file, 6 + sizeof(short), SEEK_SET);
+
+        if (load_database_v2(file) != DATABASE_OK_STATUS_CODE) {
+            fprintf(stderr, "error: could not load %s\n", db_path);
+            exit(1);
+        }
+
+        sink += cl_arr_len(global_database.files);
+
+        for (size_t j = 0; j < cl_arr_len(global_database.files); j++) {
+            Database_File *it = global_database.files[j];
+
+            free(it->name);
+            free(it->relative_filepath);
+            free(it->view_absolute_filepath);
+            free(it);
+        }
+
+        cl_arr_free(global_database.files);
+    }
+}
+
+// one op = join two paths
+static void kernel_join_paths(uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        char *path = join_paths("%s/%s", "/home/user/projects/wodo/.wodo", "aaf4c61ddcc5e8a2dabede0f3b482cd9aea9434d-1792343220.wodo");
+
+        sink += path[0];
+
+        free(path);
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void measure(const Kernel *kernel, Counters *counters, FILE *out, bool last) {
+    // warmup and find a batch size that takes at least MIN_BATCH_NS
+    uint64_t iterations = 1;
+
+    while (true) {
+        uint64_t start = now_ns();
+
+        kernel->run(iterations);
+
+        if (now_ns() - start >= MIN_BATCH_NS || iterations >= (1ULL << 40)) break;
+
+        iterations *= 2;
+    }
+
+    double samples[SAMPLES];
+    double counter_totals[COUNTERS_COUNT] = {0};
+    bool have_counters = counters->available;
+
+    for (int i = 0; i < SAMPLES; i++) {
+        uint64_t values[COUNTERS_COUNT];
+
+        counters_start(counters);
+
+        uint64_t start = now_ns();
+
+        kernel->run(iterations);
+
+        uint64_t elapsed = now_ns() - start;
+
+        if (counters_stop(counters, values)) {
+            for (int j = 0; j < COUNTERS_COUNT; j++) counter_totals[j] += (double)values[j];
+        } else {
+            have_counters = false;
+        }
+
+        samples[i] = (double)elapsed / (double)iterations;
+    }
+
+    qsort(samples, SAMPLES, sizeof(double), compare_double);
+
+    double ns_per_op = samples[SAMPLES / 2];
+
+    fprintf(out, "{\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.2f,\"min_ns_per_op\":%.2f", kernel->name, iterations, ns_per_op, samples[0]);
+
+    if (kernel->bytes_per_op > 0) {
+        fprintf(out, ",\"bytes_per_sec\":%.0f", kernel->bytes_per_op * 1e9 / ns_per_op);
+    } else {
+        fprintf(out, ",\"bytes_per_sec\":null");
+    }
+
+    for (int j = 0; j < COUNTERS_COUNT; j++) {
+        if (have_counters) {
+            fprintf(out, ",\"%s_per_op\":%.2f", counters_names[j], counter_totals[j] / (double)(iterations * SAMPLES));
+        } else {
+            fprintf(out, ",\"%s_per_op\":null", counters_names[j]);
+        }
+    }
+
+    fprintf(out, "}%s\n", last ? "" : ",");
+    fflush(out);
+}
+
+static void kernels_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s --repo <dir> [options]\n\n", program_name);
+    fprintf(stderr, "  --cpu <n>            Pin the benchmark to cpu <n> (default: current cpu)\n");
+    fprintf(stderr, "  --only <name>        Run a single kernel\n");
+}
+
+int main(int argc, char **argv) {
+    const char *repository = NULL;
+    const char *only = NULL;
+    int cpu = -1;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL) {
+            kernels_usage(argv[0]);
+
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--repo") == 0) repository = value;
+        else if (strcmp(argv[i], "--cpu") == 0) cpu = atoi(value);
+        else if (strcmp(argv[i], "--only") == 0) only = value;
+        else {
+            kernels_usage(argv[0]);
+
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (repository == NULL) {
+        kernels_usage(argv[0]);
+
+        return 1;
+    }
+
+    if (cpu < 0) cpu = sched_getcpu();
+
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "warning: could not pin to cpu %d: %s\n", cpu, strerror(errno));
+    }
+
+    if (chdir(repository) != 0) {
+        fprintf(stderr, "error: could not enter %s: %s\n", repository, strerror(errno));
+
+        return 1;
+    }
+
+    if (load_wodo_database_working_directory() != DATABASE_OK_STATUS_CODE) {
+        fprintf(stderr, "error: %s is not a wodo repository\n", repository);
+
+        return 1;
+    }
+
+    db_path = ".wodo/.wodo.db";
+    corpus_length = read_from_file("input.wodo", &corpus);
+
+    reset_parser_state();
+
+    corpus_tasks = parse_tasks("input.wodo", corpus, corpus_length);
+
+    if (cl_arr_len(corpus_tasks) == 0) {
+        fprintf(stderr, "error: input.wodo has no tasks\n");
+
+        return 1;
+    }
+
+    size_t description_bytes = 0;
+
+    for (size_t i = 0; i < cl_arr_len(corpus_tasks); i++) {
+        description_bytes += corpus_tasks[i].description.string.length;
+    }
+
+    cl_arr_push(tag_flags.tag_filter, "tag_b");
+
+    devnull = fopen("/dev/null", "w");
+
+    // print_wodo_datetime writes to stdout, results go to the original stdout
+    FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+
+    if (devnull == NULL || out == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        fprintf(stderr, "error: could not redirect stdout: %s\n", strerror(errno));
+
+        return 1;
+    }
+
+    Kernel kernels[] = {
+        { .name = "parse_tasks", .run = kernel_parse_tasks, .bytes_per_op = (double)corpus_length },
+        { .name = "print_scaped_string_to_fd", .run = kernel_print_scaped_string, .bytes_per_op = (double)description_bytes / cl_arr_len(corpus_tasks) },
+        { .name = "print_wodo_datetime", .run = kernel_print_wodo_datetime },
+        { .name = "convert_to_local", .run = kernel_convert_to_local },
+        { .name = "default_task_predicate", .run = kernel_default_task_predicate },
+        { .name = "load_database_v2", .run = kernel_load_database_v2 },
+        { .name = "join_paths", .run = kernel_join_paths },
+    };
+
+    size_t kernels_count = sizeof(kernels) / sizeof(kernels[0]);
+
+    Counters counters = counters_open();
+
+    if (!counters.available) {
+        fprintf(stderr, "warning: hardware counters are not available (%s), using timers only\n", strerror(errno));
+    }
+
+    fprintf(out, "{\"cpu\":%d,\"counters\":%s,\"kernels\":[\n", cpu, counters.available ? "true" : "false");
+
+    size_t last = kernels_count - 1;
+
+    if (only != NULL) {
+        for (size_t i = 0; i < kernels_count; i++) {
+            if (strcmp(kernels[i].name, only) == 0) last = i;
+        }
+    }
+
+    for (size_t i = 0; i < kernels_count; i++) {
+        if (only != NULL && strcmp(kernels[i].name, only) != 0) continue;
+
+        fprintf(stderr, "kernel: %s\n", kernels[i].name);
+
+        measure(&kernels[i], &counters, out, i == last);
+    }
+
+    fprintf(out, "]}\n");
+    fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,310 @@
+// Concurrency stress test used by `make stress`.
+//
+// Runs many `wodo list` readers against a fresh repository while several
+// writers add, rename and remove files in it at the same time. Every read must
+// succeed with a complete database and, once the writers are done, the
+// database must have exactly the files that were added and not removed.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MAX_ARGS 8
+#define MAX_WORKERS 256
+#define OUTPUT_SIZE (1 << 20)
+
+typedef struct {
+    const char *wodo;
+    const char *repository;
+    int readers;
+    int writers;
+    int iterations;
+} Options;
+
+// shared by every worker process
+typedef struct {
+    volatile int stop;
+    int reads;
+    int read_failures;
+    int writes;
+    int write_failures;
+    int added;
+    int removed;
+} Counters;
+
+// runs wodo in `cwd` with `args`, the output goes to `out` when it's not NULL.
+// returns the exit code, -1 when it could not run
+static int run(const Options *options, const char *cwd, const char **args, char *out, size_t out_size) {
+    int pipe_fds[2] = { -1, -1 };
+
+    if (out != NULL && pipe(pipe_fds) != 0) return -1;
+
+    pid_t pid = fork();
+
+    if (pid < 0) return -1;
+
+    if (pid == 0) {
+        if (chdir(cwd) != 0) _exit(127);
+
+        int null = open("/dev/null", O_RDWR);
+
+        if (null < 0) _exit(127);
+
+        dup2(null, STDIN_FILENO);
+        dup2(out != NULL ? pipe_fds[1] : null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+
+        if (out != NULL) {
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+        }
+
+        char *argv[MAX_ARGS + 2] = { (char *)options->wodo };
+
+        for (int i = 0; i < MAX_ARGS && args[i] != NULL; i++) argv[i + 1] = (char *)args[i];
+
+        execv(options->wodo, argv);
+
+        _exit(127);
+    }
+
+    if (out != NULL) {
+        close(pipe_fds[1]);
+
+        size_t used = 0;
+        ssize_t n;
+
+        while ((n = read(pipe_fds[0], out + used, out_size - used - 1)) > 0) {
+            used += n;
+
+            if (used + 1 >= out_size) break;
+        }
+
+        out[used] = '\0';
+
+        close(pipe_fds[0]);
+    }
+
+    int status;
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) == 127) return -1;
+
+    return WEXITSTATUS(status);
+}
+
+static int count_files(const char *output) {
+    int count = 0;
+
+    for (const char *cursor = output; (cursor = strstr(cursor, "\"name\":")) != NULL; cursor++) count++;
+
+    return count;
+}
+
+static void reader(const Options *options, Counters *counters) {
+    const char *args[] = { "list", "--fields", "title", "--no-locations", NULL };
+    char *out = malloc(OUTPUT_SIZE);
+
+    while (!counters->stop) {
+        int code = run(options, options->repository, args, out, OUTPUT_SIZE);
+        bool ok = code == 0 && strncmp(out, "{\"files\":[", 10) == 0 && strstr(out, "\"diagnostics\":") != NULL;
+
+        __atomic_fetch_add(&counters->reads, 1, __ATOMIC_RELAXED);
+
+        if (!ok) __atomic_fetch_add(&counters->read_failures, 1, __ATOMIC_RELAXED);
+    }
+
+    free(out);
+}
+
+// every iteration adds a file, every third one is renamed and every fourth
+// one removed
+static void writer(const Options *options, Counters *counters, int id) {
+    char title[64];
+    char path[4096];
+
+    for (int i = 0; i < options->iterations; i++) {
+        snprintf(title, sizeof(title), "stress %d %d", id, i);
+
+        const char *add[] = { "add", title, NULL };
+
+        __atomic_fetch_add(&counters->writes, 1, __ATOMIC_RELAXED);
+
+        if (run(options, options->repository, add, path, sizeof(path)) != 0) {
+            __atomic_fetch_add(&counters->write_failures, 1, __ATOMIC_RELAXED);
+
+            continue;
+        }
+
+        __atomic_fetch_add(&counters->added, 1, __ATOMIC_RELAXED);
+
+        path[strcspn(path, "\n")] = '\0';
+
+        if (i % 3 == 0) {
+            snprintf(title, sizeof(title), "stress %d %d renamed", id, i);
+
+            const char *rename[] = { "rename", path, title, NULL };
+
+            __atomic_fetch_add(&counters->writes, 1, __ATOMIC_RELAXED);
+
+            if (run(options, options->repository, rename, NULL, 0) != 0) __atomic_fetch_add(&counters->write_failures, 1, __ATOMIC_RELAXED);
+        }
+
+        if (i % 4 == 0) {
+            const char *remove[] = { "remove", path, NULL };
+
+            __atomic_fetch_add(&counters->writes, 1, __ATOMIC_RELAXED);
+
+            if (run(options, options->repository, remove, NULL, 0) != 0) {
+                __atomic_fetch_add(&counters->write_failures, 1, __ATOMIC_RELAXED);
+            } else {
+                __atomic_fetch_add(&counters->removed, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+static void usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s --wodo <bin> [options]\n\n", program_name);
+    fprintf(stderr, "  --readers <n>        Processes running list in a loop (default 8)\n");
+    fprintf(stderr, "  --writers <n>        Processes adding, renaming and removing files (default 4)\n");
+    fprintf(stderr, "  --iterations <n>     Files added by every writer (default 50)\n");
+}
+
+int main(int argc, char **argv) {
+    Options options = {
+        .readers = 8,
+        .writers = 4,
+        .iterations = 50,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (value == NULL) {
+            usage(argv[0]);
+
+            return 1;
+        }
+
+        if (strcmp(arg, "--wodo") == 0) options.wodo = value;
+        else if (strcmp(arg, "--readers") == 0) options.readers = atoi(value);
+        else if (strcmp(arg, "--writers") == 0) options.writers = atoi(value);
+        else if (strcmp(arg, "--iterations") == 0) options.iterations = atoi(value);
+        else {
+            usage(argv[0]);
+
+            return 1;
+        }
+
+        i++;
+    }
+
+    if (options.wodo == NULL || options.readers < 0 || options.writers <= 0 || options.iterations <= 0 || options.readers + options.writers > MAX_WORKERS) {
+        usage(argv[0]);
+
+        return 1;
+    }
+
+    // execv does not search PATH, so make the binary path absolute before changing directories
+    char *wodo = realpath(options.wodo, NULL);
+
+    if (wodo == NULL) {
+        fprintf(stderr, "error: invalid wodo binary %s: %s\n", options.wodo, strerror(errno));
+
+        return 1;
+    }
+
+    options.wodo = wodo;
+
+    char repository[] = "/tmp/wodo-stress-XXXXXX";
+
+    if (mkdtemp(repository) == NULL) {
+        fprintf(stderr, "error: could not create a repository: %s\n", strerror(errno));
+
+        return 1;
+    }
+
+    options.repository = repository;
+
+    const char *init[] = { "init", NULL };
+
+    if (run(&options, repository, init, NULL, 0) != 0) {
+        fprintf(stderr, "error: could not init the repository at %s\n", repository);
+
+        return 1;
+    }
+
+    Counters *counters = mmap(NULL, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (counters == MAP_FAILED) {
+        fprintf(stderr, "error: could not map the counters: %s\n", strerror(errno));
+
+        return 1;
+    }
+
+    memset(counters, 0, sizeof(Counters));
+
+    pid_t readers[MAX_WORKERS];
+    pid_t writers[MAX_WORKERS];
+
+    for (int i = 0; i < options.readers; i++) {
+        if ((readers[i] = fork()) == 0) {
+            reader(&options, counters);
+            _exit(0);
+        }
+    }
+
+    for (int i = 0; i < options.writers; i++) {
+        if ((writers[i] = fork()) == 0) {
+            writer(&options, counters, i);
+            _exit(0);
+        }
+    }
+
+    for (int i = 0; i < options.writers; i++) {
+        if (writers[i] > 0) waitpid(writers[i], NULL, 0);
+    }
+
+    counters->stop = 1;
+
+    for (int i = 0; i < options.readers; i++) {
+        if (readers[i] > 0) waitpid(readers[i], NULL, 0);
+    }
+
+    const char *list[] = { "list", "--fields", "title", "--no-locations", NULL };
+    char *out = malloc(OUTPUT_SIZE);
+    int files = run(&options, repository, list, out, OUTPUT_SIZE) == 0 ? count_files(out) : -1;
+    int expected = counters->added - counters->removed;
+    bool ok = counters->read_failures == 0 && counters->write_failures == 0 && files == expected;
+
+    printf("{\"readers\":%d,\"writers\":%d,\"reads\":%d,\"read_failures\":%d,", options.readers, options.writers, counters->reads, counters->read_failures);
+    printf("\"writes\":%d,\"write_failures\":%d,\"expected_files\":%d,\"files\":%d,\"ok\":%s}\n", counters->writes, counters->write_failures, expected, files, ok ? "true" : "false");
+
+    if (ok) {
+        const char *rm[] = { "rm", "-rf", repository, NULL };
+        pid_t pid = fork();
+
+        if (pid == 0) {
+            execvp(rm[0], (char **)rm);
+            _exit(127);
+        }
+
+        if (pid > 0) waitpid(pid, NULL, 0);
+    } else {
+        fprintf(stderr, "stress: failed, the repository was kept at %s\n", repository);
+    }
+
+    free(out);
+    free(wodo);
+    munmap(counters, sizeof(Counters));
+
+    return ok ? 0 : 1;
+}
@@ -255,7 +255,9 @@ local function parse_wodo_file_action(flags)
   local path = vim.api.nvim_buf_get_name(0)
   local lines = table.concat(vim.api.nvim_buf_get_lines(0, 0, -1, false), "\n")
 
-  local cmd = { "wodo", "p", path }
+  -- the picker only needs the title line, the state and the description for the preview
+  -- msgpack is decoded natively and its strings are not escaped
+  local cmd = { "wodo", "p", path, "--format", "msgpack", "--fields", "title,state,description" }
 
   if flags and #flags > 0 then
     for _, v in ipairs(flags) do
@@ -263,8 +265,10 @@ local function parse_wodo_file_action(flags)
     end
   end
 
-  local result = vim.system(cmd, { text = true, stdin = lines }):wait()
-  local ok, data = pcall(vim.json.decode, result.stdout)
+  local result = vim.system(cmd, { stdin = lines }):wait()
+  if result.code ~= 0 then return end
+
+  local ok, data = pcall(vim.mpack.decode, result.stdout)
   if not ok then return end
 
   local tasks = {}
@@ -409,6 +413,36 @@ local function rename_wodo_file_action()
   end)
 end
 
+local function notify_diagnostics(diagnostics)
+  if not diagnostics or #diagnostics == 0 then return end
+
+  local lines = {}
+
+  for _, diagnostic in ipairs(diagnostics) do
+    table.insert(lines, string.format("%s:%d:%d %s: %s", diagnostic.file, diagnostic.line, diagnostic.col, diagnostic.severity, diagnostic.message))
+  end
+
+  vim.schedule(function()
+    vim.notify(table.concat(lines, "\n"), vim.log.levels.WARN, { title = "Wodo diagnostics" })
+  end)
+end
+
+local pending_diagnostics = {}
+
+-- diagnostics arrive one per line in ndjson mode, show them in a single notification
+local function queue_diagnostic(diagnostic)
+  table.insert(pending_diagnostics, diagnostic)
+
+  if #pending_diagnostics > 1 then return end
+
+  vim.defer_fn(function()
+    local diagnostics = pending_diagnostics
+    pending_diagnostics = {}
+
+    notify_diagnostics(diagnostics)
+  end, 200)
+end
+
 local function list_action(flags)
   local pickers = require("telescope.pickers")
   local finders = require("telescope.finders")
@@ -417,7 +451,9 @@ local function list_action(flags)
   local action_state = require("telescope.actions.state")
   local previewers = require("telescope.previewers")
 
-  local cmd = { "wodo", "l" }
+  -- one file per line, so the picker is populated while wodo is still parsing.
+  -- the preview only shows state, date and title of each task
+  local cmd = { "wodo", "l", "--ndjson", "--fields", "title,state,date", "--no-locations" }
 
   if flags and #flags > 0 then
     for _, v in ipairs(flags) do
@@ -425,100 +461,81 @@ local function list_action(flags)
     end
   end
 
-  vim.system(cmd, { text = true }, function(result)
-    if result.code ~= 0 then
-      vim.schedule(function()
-        vim.notify("Failed to list task files", vim.log.levels.ERROR)
-      end)
-      return
-    end
-
-    local ok, data = pcall(vim.json.decode, result.stdout)
-    if not ok then
-      vim.schedule(function()
-        vim.notify("Invalid JSON from wodo", vim.log.levels.ERROR)
-      end)
-      return
-    end
+  pickers.new({}, {
+    prompt_title = "Wodo Task Files",
 
-    if #data == 0 then
-      vim.schedule(function()
-        vim.notify("There is not task to list", vim.log.levels.INFO)
-      end)
-      return
-    end
+    finder = finders.new_oneshot_job(cmd, {
+      entry_maker = function(line)
+        local ok, item = pcall(vim.json.decode, line)
 
-    vim.schedule(function()
-      pickers.new({}, {
-        prompt_title = "Wodo Task Files",
+        if not ok or type(item) ~= "table" then return nil end
 
-        finder = finders.new_table({
-          results = data,
+        if item.diagnostic then
+          queue_diagnostic(item.diagnostic)
+          return nil
+        end
 
-          entry_maker = function(item)
-            return {
-              value = item,
-              ordinal = item.name,
-              display = item.name,
-            }
-          end,
-        }),
+        return {
+          value = item,
+          ordinal = item.name,
+          display = item.name,
+        }
+      end,
+    }),
 
-        sorter = conf.generic_sorter({}),
+    sorter = conf.generic_sorter({}),
 
-        previewer = previewers.new_buffer_previewer({
-          title = "Tasks",
+    previewer = previewers.new_buffer_previewer({
+      title = "Tasks",
 
-          define_preview = function(self, entry)
-            local tasks = entry.value.tasks or {}
-            local bufnr = self.state.bufnr
+      define_preview = function(self, entry)
+        local tasks = entry.value.tasks or {}
+        local bufnr = self.state.bufnr
 
-            vim.bo[bufnr].modifiable = true
+        vim.bo[bufnr].modifiable = true
 
-            local lines = {}
+        local lines = {}
 
-            for _, task in ipairs(tasks) do
-              local state = task.state.content
-              local date = task.date.content
-              local title = task.title.content
+        for _, task in ipairs(tasks) do
+          local state = task.state.content
+          local date = task.date.content
+          local title = task.title.content
 
-              table.insert(lines, string.format("%-8s %-20s %s", state, date, title))
-            end
+          table.insert(lines, string.format("%-8s %-20s %s", state, date, title))
+        end
 
-            vim.api.nvim_buf_set_lines(bufnr, 0, -1, false, lines)
+        vim.api.nvim_buf_set_lines(bufnr, 0, -1, false, lines)
 
-            -- Apply highlight to state column
-            for i, task in ipairs(tasks) do
-              local state = task.state.content
-              local hl = "Normal"
+        -- Apply highlight to state column
+        for i, task in ipairs(tasks) do
+          local state = task.state.content
+          local hl = "Normal"
 
-              if state == "todo" then hl = "wodoStateTodo" end
-              if state == "doing" then hl = "wodoStateDoing" end
-              if state == "done" then hl = "wodoStateDone" end
-              if state == "blocked" then hl = "wodoStateBlocked" end
+          if state == "todo" then hl = "wodoStateTodo" end
+          if state == "doing" then hl = "wodoStateDoing" end
+          if state == "done" then hl = "wodoStateDone" end
+          if state == "blocked" then hl = "wodoStateBlocked" end
 
-              vim.api.nvim_buf_add_highlight(bufnr, -1, hl, i - 1, 0, #state)
-            end
+          vim.api.nvim_buf_add_highlight(bufnr, -1, hl, i - 1, 0, #state)
+        end
 
-            vim.bo[bufnr].modifiable = false
-          end,
-        }),
+        vim.bo[bufnr].modifiable = false
+      end,
+    }),
 
-        attach_mappings = function(prompt_bufnr)
-          actions.select_default:replace(function()
-            local entry = action_state.get_selected_entry()
-            actions.close(prompt_bufnr)
+    attach_mappings = function(prompt_bufnr)
+      actions.select_default:replace(function()
+        local entry = action_state.get_selected_entry()
+        actions.close(prompt_bufnr)
 
-            local path = entry.value.path
-            vim.cmd({ cmd = "edit", args = { path } })
-            set_winbar_title(entry.value.name)
-          end)
+        local path = entry.value.path
+        vim.cmd({ cmd = "edit", args = { path } })
+        set_winbar_title(entry.value.name)
+      end)
 
-          return true
-        end,
-      }):find()
-    end)
-  end)
+      return true
+    end,
+  }):find()
 end
 
 local function confirm_delete(on_confirm)
@@ -595,6 +612,76 @@ local function format_wodo_file_action()
   end
 end
 
+-- wodo ranks and cuts the results on every keystroke, so the picker only
+-- ever holds the best matches no matter how big the repository is
+local function pick_action(files)
+  local pickers = require("telescope.pickers")
+  local finders = require("telescope.finders")
+  local sorters = require("telescope.sorters")
+  local actions = require("telescope.actions")
+  local action_state = require("telescope.actions.state")
+
+  local function make_display(entry)
+    local item = entry.value
+    local prefix = ""
+    local text = item.name
+
+    if not files then
+      prefix = string.format("%-8s ", item.state.content)
+      text = item.title.content
+    end
+
+    local highlights = {}
+
+    for _, position in ipairs(item.positions or {}) do
+      table.insert(highlights, { { #prefix + position, #prefix + position + 1 }, "TelescopeMatching" })
+    end
+
+    return prefix .. text, highlights
+  end
+
+  pickers.new({}, {
+    prompt_title = files and "Wodo Files" or "Wodo Tasks",
+
+    finder = finders.new_job(function(prompt)
+      local cmd = { "wodo", "pick", "--query", prompt or "", "--limit", "100", "--ndjson" }
+
+      if files then table.insert(cmd, "--files") end
+
+      return cmd
+    end, function(line)
+      local ok, item = pcall(vim.json.decode, line)
+
+      if not ok or type(item) ~= "table" then return nil end
+
+      return {
+        value = item,
+        ordinal = files and item.name or item.title.content,
+        display = make_display,
+      }
+    end),
+
+    -- the lines already come in the right order
+    sorter = sorters.empty(),
+
+    attach_mappings = function(prompt_bufnr)
+      actions.select_default:replace(function()
+        local entry = action_state.get_selected_entry()
+        actions.close(prompt_bufnr)
+
+        vim.cmd({ cmd = "edit", args = { entry.value.path } })
+        set_winbar_title(entry.value.name)
+
+        if not files then
+          vim.api.nvim_win_set_cursor(0, { entry.value.title.location.line, 0 })
+        end
+      end)
+
+      return true
+    end,
+  }):find()
+end
+
 local function filter_tasks_locally_action()
   vim.ui.input({ prompt = "Filters: state:<state>, tag:<tag>" }, function(input)
     if not input or input == "" then
@@ -678,6 +765,8 @@ vim.api.nvim_create_autocmd("BufEnter", {
     vim.keymap.set("n", "<leader>wa", add_wodo_file_action)
     vim.keymap.set("n", "<leader>wL", function() list_action(nil) end)
     vim.keymap.set("n", "<leader>wS", filter_tasks_globally_action)
+    vim.keymap.set("n", "<leader>wp", function() pick_action(false) end)
+    vim.keymap.set("n", "<leader>wP", function() pick_action(true) end)
   end
 })
 
@@ -689,34 +778,41 @@ vim.api.nvim_set_hl(0, "wodoStateBlocked", { fg = "#ff5555" })
 vim.api.nvim_create_autocmd("VimEnter", {
   group = vim.api.nvim_create_augroup("WodoReminders", { clear = true }),
   callback = function()
-    vim.fn.jobstart({ "wodo", "reminders" }, {
-      stdout_buffered = true,
+    local partial = ""
+
+    local function notify_reminder(event)
+      local project_name = event.name or "Unknown Project"
+      local task = event.task
+      local title = task.title and task.title.content or "No Title"
+      local state = "[" .. task.state.content .. "]"
+
+      vim.schedule(function()
+        Snacks.notifier.notify(task.description.content, vim.log.levels.INFO, {
+          title = state .. " (" .. project_name .. ") " .. title,
+          ft = "wodo",
+          style = "fancy",
+          timeout = 5000
+        })
+      end)
+    end
+
+    -- keeps running for the whole session and prints one event per line when a reminder is due,
+    -- the last chunk of a callback may be an incomplete line
+    vim.fn.jobstart({ "wodo", "reminders", "--follow", "--fields", "title,state,description", "--no-locations" }, {
       on_stdout = function(_, data)
-        if not data or #data == 0 or (#data == 1 and data[1] == "") then return end
-
-        local json_output = table.concat(data, "\n")
-        local ok, parsed_data = pcall(vim.json.decode, json_output)
-
-        if not ok or type(parsed_data) ~= "table" then return end
-
-        for _, file_data in ipairs(parsed_data) do
-          local project_name = file_data.name or "Unknown Project"
-
-          if file_data.tasks then
-            for _, task in ipairs(file_data.tasks) do
-              if task.remind and task.remind.content == true then
-                local title = task.title and task.title.content or "No Title"
-                local state = "[" .. task.state.content .. "]"
-
-                vim.schedule(function()
-                  Snacks.notifier.notify(task.description.content, vim.log.levels.INFO, {
-                    title = state .. " (" .. project_name .. ") " .. title,
-                    ft = "wodo",
-                    style = "fancy",
-                    timeout = 5000
-                  })
-                end)
-              end
+        if not data or #data == 0 then return end
+
+        data[1] = partial .. data[1]
+        partial = table.remove(data)
+
+        for _, line in ipairs(data) do
+          local ok, item = pcall(vim.json.decode, line)
+
+          if ok and type(item) == "table" then
+            if item.diagnostic then
+              queue_diagnostic(item.diagnostic)
+            elseif item.event == "reminder" then
+              notify_reminder(item)
             end
           end
         end
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include "io.h"
 #include "json.h"
+#include "msgpack.h"
+#include "reminders.h"
 #include "io.h"
 #include "database.h"
 #include "visualizer.h"
@@ -13,6 +15,9 @@
 #include "utils.h"
 #include "arr.h"
 #include "crossplatformops.h"
+#include "taskid.h"
+#include "properties.h"
+#include "sort.h"
 
 int add_wodo_file_action(char *name) {
     char *absolute_filepath;
@@ -54,27 +59,129 @@ int remove_wodo_file_action(const char *filepath) {
     return result;
 }
 
+typedef struct {
+    Flags flags;
+    Task_Id_Counter ids;
+    size_t printed;
+} Parse_Stream;
+
+static void print_parsed_stream_task(wodo_task_t task, void *data) {
+    Parse_Stream *stream = data;
+    Flags flags = stream->flags;
+    Task_Id id;
+
+    // every task takes its id, even the filtered ones, like in the whole file
+    if (flags.fields & WODO_FIELD_ID) id = next_task_id(&stream->ids, task);
+
+    if (!default_task_predicate(task, flags)) return;
+
+    const char *id_value = (flags.fields & WODO_FIELD_ID) ? id.value : NULL;
+
+    if (flags.format == OF_MSGPACK) {
+        print_task_to_stdout_as_msgpack(task, id_value, flags);
+    } else {
+        if (!flags.ndjson && stream->printed > 0) printf(",");
+
+        print_task_to_stdout_as_json(task, id_value, flags);
+
+        if (flags.ndjson) printf("\n");
+    }
+
+    if (flags.ndjson) fflush(stdout);
+
+    stream->printed++;
+}
+
+// `parse --stream`, the tasks are written while the input is read
+static int parse_wodo_stream_from_stdin(const char *filepath, Flags flags) {
+    if (flags.format == OF_MSGPACK && !flags.ndjson) {
+        fprintf(stderr, "error: --stream with --format msgpack needs --ndjson\n");
+
+        return 1;
+    }
+
+    Parse_Stream stream = { .flags = flags };
+
+    set_parser_options(parser_options_from_flags(flags));
+
+    if (!flags.ndjson) printf("[");
+
+    bool ok = parse_tasks_stream(filepath, STDIN_FILENO, print_parsed_stream_task, &stream);
+
+    if (!flags.ndjson) printf("]\n");
+
+    free_task_id_counter(&stream.ids);
+
+    if (!ok) {
+        fprintf(stderr, "error: could not read stdin: %s\n", strerror(errno));
+
+        return 1;
+    }
+
+    return 0;
+}
+
 int parse_wodo_file_from_stdin_action(const char *filepath, Flags flags) {
+    if (flags.stream) return parse_wodo_stream_from_stdin(filepath, flags);
+
     char *content;
 
     size_t length = read_from_stdin(&content);
 
     reset_parser_state();
+    set_parser_options(parser_options_from_flags(flags));
 
     wodo_task_t *tasks = parse_tasks(filepath, content, length);
 
-    print_tasks_to_stdout_as_json(tasks, default_task_predicate, flags);
+    if (flags.format == OF_MSGPACK) {
+        if (flags.ndjson) {
+            print_tasks_to_stdout_as_msgpack_stream(tasks, default_task_predicate, flags);
+        } else {
+            print_tasks_to_stdout_as_msgpack(tasks, default_task_predicate, flags);
+        }
+    } else if (flags.ndjson) {
+        print_tasks_to_stdout_as_ndjson(tasks, default_task_predicate, flags);
+    } else {
+        print_tasks_to_stdout_as_json(tasks, default_task_predicate, flags);
 
-    printf("\n");
+        printf("\n");
+    }
 
     free(content);
-    cl_arr_free(tasks);
+    free_tasks(tasks);
 
     return 0;
 }
 
 int list_action(Flags flags) {
-    print_database_files_to_stdout_as_json(default_task_predicate, flags);
+    if (flags.format == OF_MSGPACK && flags.include_archive) {
+        fprintf(stderr, "error: --include-archive is only supported with --format json\n");
+
+        return 1;
+    }
+
+    if (flags.sort != NULL) {
+        if (flags.format == OF_MSGPACK || flags.include_archive) {
+            fprintf(stderr, "error: --sort is only supported with --format json and without --include-archive\n");
+
+            return 1;
+        }
+
+        return sorted_list_action(flags);
+    }
+
+    // the files are written as they are read, there is no "first" task to keep
+    if (flags.limit > 0) {
+        fprintf(stderr, "error: --limit is only supported with --sort\n");
+
+        return 1;
+    }
+
+    if (flags.format == OF_MSGPACK) {
+        print_database_files_to_stdout_as_msgpack(default_task_predicate, flags);
+    } else {
+        print_database_files_to_stdout_as_json(default_task_predicate, flags);
+    }
 
     return 0;
 }
@@ -138,60 +245,108 @@ static void print_trimed_line_string(wodo_string_t string) {
     printf("%.*s", (int)(last_line - first_line + 1), string.value + first_line);
 }
 
-int format_wodo_file_from_stdin_action(const char *filepath) {
-    char *content;
+static void print_formatted_task(wodo_task_t task) {
+    printf("%% ");
+    print_trimed_string(task.title.string);
+    printf("\n");
+    printf("\n");
+    printf(".state ");
+    switch (task.state_property.state) {
+        case Wodo_Task_State_Todo: printf("todo\n"); break;
+        case Wodo_Task_State_Doing: printf("doing\n"); break;
+        case Wodo_Task_State_Blocked: printf("blocked\n"); break;
+        case Wodo_Task_State_Done: printf("done\n"); break;
+        default: assert(0 && "unhandled state during formatting");
+    }
+    printf(".date ");
+    print_wodo_datetime(task.date_property.datetime, false);
+    printf("\n");
+    printf(".tags");
 
-    size_t length = read_from_stdin(&content);
+    if (cl_arr_len(task.tags_property.node_array) > 0) {
+        printf(" ");
+        for (size_t j = 0; j < (cl_arr_len(task.tags_property.node_array)); j++) {
+            if (j > 0) printf(" ");
 
-    reset_parser_state();
+            wodo_string_t tag = task.tags_property.node_array[j].string;
 
-    wodo_task_t *tasks = parse_tasks(filepath, content, length);
+            printf("%.*s", (int)tag.length, tag.value);
+        }
+    }
+    printf("\n");
 
-    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
-        if (i > 0) printf("\n");
+    if (task.remind_property.boolean) {
+        printf(".remind\n");
+    }
 
-        wodo_task_t task = tasks[i];
+    if (cl_arr_len(task.depends_property.node_array) > 0) {
+        printf(".depends");
 
-        printf("%% ");
-        print_trimed_string(task.title.string);
-        printf("\n");
-        printf("\n");
-        printf(".state ");
-        switch (task.state_property.state) {
-            case Wodo_Task_State_Todo: printf("todo\n"); break;
-            case Wodo_Task_State_Doing: printf("doing\n"); break;
-            case Wodo_Task_State_Blocked: printf("blocked\n"); break;
-            case Wodo_Task_State_Done: printf("done\n"); break;
-            default: assert(0 && "unhandled state during formatting");
+        for (size_t j = 0; j < cl_arr_len(task.depends_property.node_array); j++) {
+            wodo_string_t id = task.depends_property.node_array[j].string;
+
+            printf(" %.*s", (int)id.length, id.value);
         }
-        printf(".date ");
-        print_wodo_datetime(task.date_property.datetime, false);
+
         printf("\n");
-        printf(".tags");
+    }
 
-        if (cl_arr_len(task.tags_property.node_array) > 0) {
-            printf(" ");
-            for (size_t j = 0; j < (cl_arr_len(task.tags_property.node_array)); j++) {
-                if (j > 0) printf(" ");
+    for (size_t i = 0; i < task.properties_count; i++) {
+        const wodo_property_t *property = property_at(task.properties[i].property);
+        char value[WODO_PROPERTY_VALUE_MAX_SIZE];
 
-                wodo_string_t tag = task.tags_property.node_array[j].string;
+        format_property_value(value, property, task.properties[i].value);
 
-                printf("%.*s", (int)tag.length, tag.value);
-            }
-        }
+        printf(".%s %s\n", property->name, value);
+    }
+
+    if (task.description.string.length > 0) {
         printf("\n");
+        print_trimed_line_string(task.description.string);
+        printf("\n");
+    }
+}
 
-        if (task.remind_property.boolean) {
-            printf(".remind\n");
-        }
+static void print_formatted_stream_task(wodo_task_t task, void *data) {
+    size_t *printed = data;
+
+    if (*printed > 0) printf("\n");
+
+    (*printed)++;
 
-        if (task.description.string.length > 0) {
-            printf("\n");
-            print_trimed_line_string(task.description.string);
-            printf("\n");
+    print_formatted_task(task);
+}
+
+int format_wodo_file_from_stdin_action(const char *filepath, Flags flags) {
+    if (flags.stream) {
+        size_t printed = 0;
+
+        if (!parse_tasks_stream(filepath, STDIN_FILENO, print_formatted_stream_task, &printed)) {
+            fprintf(stderr, "error: could not read stdin: %s\n", strerror(errno));
+
+            return 1;
         }
+
+        return 0;
     }
 
+    char *content;
+
+    size_t length = read_from_stdin(&content);
+
+    reset_parser_state();
+
+    wodo_task_t *tasks = parse_tasks(filepath, content, length);
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        if (i > 0) printf("\n");
+
+        print_formatted_task(tasks[i]);
+    }
+
+    free(content);
+    free_tasks(tasks);
+
     return 0;
 }
 
@@ -223,8 +378,14 @@ static bool get_reminders_action_task_predicate(wodo_task_t task, Flags flags) {
     return task.state_property.state != Wodo_Task_State_Done && task.remind_property.boolean;
 }
 
-int get_reminders_action() {
-    print_database_files_to_stdout_as_json(get_reminders_action_task_predicate, (Flags){0});
+int get_reminders_action(Flags flags) {
+    if (flags.follow) return follow_reminders(flags);
+
+    if (flags.format == OF_MSGPACK) {
+        print_database_files_to_stdout_as_msgpack(get_reminders_action_task_predicate, flags);
+    } else {
+        print_database_files_to_stdout_as_json(get_reminders_action_task_predicate, flags);
+    }
 
     return 0;
 }
@@ -250,3 +411,54 @@ int init_repository_action() {
 
     return DATABASE_OK_STATUS_CODE;
 }
+
+int check_action() {
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+    size_t errors_count = 0;
+    size_t warnings_count = 0;
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        Database_File *it = global_database.files[i];
+
+        char *content;
+        size_t length;
+
+        if (!read_from_file_no_quit(it->view_absolute_filepath, &content, &length)) {
+            push_diagnostic(&diagnostics, it->view_absolute_filepath, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+
+            continue;
+        }
+
+        reset_parser_state();
+
+        wodo_task_t *tasks = parse_tasks_recovering(it->view_absolute_filepath, content, length, &diagnostics);
+
+        free(content);
+        free_tasks(tasks);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(diagnostics); i++) {
+        wodo_diagnostic_t diagnostic = diagnostics[i];
+
+        const char *severity = "error";
+
+        if (diagnostic.severity == Wodo_Diagnostic_Error) {
+            errors_count++;
+        } else {
+            severity = "warning";
+            warnings_count++;
+        }
+
+        if (diagnostic.location.line == 0) {
+            printf("%s: %s: %s\n", diagnostic.filename, severity, diagnostic.message);
+        } else {
+            printf("%s:%d:%d %s: %s\n", diagnostic.filename, diagnostic.location.line, diagnostic.location.col, severity, diagnostic.message);
+        }
+    }
+
+    printf("checked %zu files: %zu errors, %zu warnings\n", cl_arr_len(global_database.files), errors_count, warnings_count);
+
+    free_diagnostics(&diagnostics);
+
+    return errors_count > 0;
+}
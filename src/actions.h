@@ -12,9 +12,10 @@ int parse_wodo_file_from_stdin_action(const char *filepath, Flags flags);
 int list_action(Flags flags);
 // filepath here is gonna be used just for error reporting at
 // precise locations. The content will be read from stdin.
-int format_wodo_file_from_stdin_action(const char *filepath);
+int format_wodo_file_from_stdin_action(const char *filepath, Flags flags);
 int rename_wodo_file_action(const char *filepath, char *title);
-int get_reminders_action();
+int get_reminders_action(Flags flags);
 int init_repository_action();
+int check_action();
 
 #endif // !_WODO_ACTIONS_H_
@@ -0,0 +1,600 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "archive.h"
+#include "arr.h"
+#include "database.h"
+#include "date.h"
+#include "io.h"
+#include "json.h"
+#include "lz.h"
+#include "parser.h"
+#include "utils.h"
+#include "trace.h"
+
+/*
+ * .wodo/archive/<segment>.seg layout (native endianness, like the database file):
+ *
+ *   Segment_Header
+ *   the records compressed as a single lz block, every record is
+ *     uint32 name size, name, uint32 path size, relative path,
+ *     uint32 text size, the text of the archived tasks of that file
+ *
+ * .wodo/archive/index is an Index_Header followed by one Index_Entry per
+ * segment, in the order they were written. It's the only file of the archive
+ * that is ever rewritten.
+ */
+static const char *archive_folder_name = "archive";
+static const char *index_file_name = "index";
+static const char segment_magic[8] = "WODOSEG";
+static const char index_magic[8] = "WODOARX";
+
+#define ARCHIVE_VERSION 1
+#define TAGS_BLOOM_WORDS 4
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t padding;
+    uint64_t raw_size;
+    uint64_t compressed_size;
+} Segment_Header;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entries_count;
+} Index_Header;
+
+typedef struct {
+    uint32_t segment;
+    uint32_t tasks_count;
+    // unix timestamps of the oldest and newest task
+    int64_t min_date, max_date;
+    // two bits per tag, so queries can skip the segments without their tags
+    uint64_t tags_bloom[TAGS_BLOOM_WORDS];
+} Index_Entry;
+
+typedef struct {
+    size_t start, end;
+} Task_Range;
+
+typedef struct {
+    Database_File *file;
+    struct stat st;
+    char *content;
+    size_t length;
+    Task_Range *ranges;             // CL_ARRAY
+    size_t archived_length;
+} Archived_File;
+
+// the archived tasks and their diagnostics point to these, so they are kept
+// until the process exits
+static char **kept_strings = CL_ARRAY_INIT;
+
+static void bloom_add(uint64_t *bloom, const char *tag, size_t length) {
+    uint64_t hash = fnv1a(FNV1A_OFFSET_BASIS, tag, length);
+    unsigned first = hash & 255;
+    unsigned second = (hash >> 8) & 255;
+
+    bloom[first / 64] |= 1ULL << (first % 64);
+    bloom[second / 64] |= 1ULL << (second % 64);
+}
+
+static bool bloom_may_contain(const uint64_t *bloom, const char *tag, size_t length) {
+    uint64_t hash = fnv1a(FNV1A_OFFSET_BASIS, tag, length);
+    unsigned first = hash & 255;
+    unsigned second = (hash >> 8) & 255;
+
+    return (bloom[first / 64] & (1ULL << (first % 64))) && (bloom[second / 64] & (1ULL << (second % 64)));
+}
+
+// the tag filter matches the task tags that are a prefix of it, see
+// `default_task_predicate`, so every prefix of every filter is looked up
+static bool entry_may_match_tags(const Index_Entry *entry, Flags flags) {
+    if (cl_arr_len(flags.tag_filter) == 0) return true;
+
+    for (size_t i = 0; i < cl_arr_len(flags.tag_filter); i++) {
+        const char *filter = flags.tag_filter[i];
+        size_t length = strlen(filter);
+
+        for (size_t prefix = 1; prefix <= length; prefix++) {
+            if (bloom_may_contain(entry->tags_bloom, filter, prefix)) return true;
+        }
+    }
+
+    return false;
+}
+
+static char *archive_path(const char *name) {
+    return join_paths("%s/%s/%s", database_folder(), archive_folder_name, name);
+}
+
+static char *segment_path(uint32_t segment) {
+    char name[32];
+
+    snprintf(name, sizeof(name), "%06u.seg", segment);
+
+    return archive_path(name);
+}
+
+// a missing index is an empty archive
+static bool read_index(Index_Entry **entries) {
+    char *path = archive_path(index_file_name);
+    char *content;
+    size_t length;
+
+    if (!read_from_file_no_quit(path, &content, &length)) {
+        free(path);
+
+        return errno == ENOENT;
+    }
+
+    free(path);
+
+    Index_Header header;
+
+    if (length < sizeof(header)) goto corrupted;
+
+    memcpy(&header, content, sizeof(header));
+
+    if (memcmp(header.magic, index_magic, sizeof(index_magic)) != 0 || header.version != ARCHIVE_VERSION) goto corrupted;
+    if ((length - sizeof(header)) / sizeof(Index_Entry) != header.entries_count) goto corrupted;
+
+    for (uint32_t i = 0; i < header.entries_count; i++) {
+        Index_Entry entry;
+
+        memcpy(&entry, content + sizeof(header) + i * sizeof(Index_Entry), sizeof(entry));
+        cl_arr_push(*entries, entry);
+    }
+
+    free(content);
+
+    return true;
+
+corrupted:
+    free(content);
+    errno = EINVAL;
+
+    return false;
+}
+
+static bool write_index(Index_Entry *entries) {
+    Index_Header header = {
+        .version = ARCHIVE_VERSION,
+        .entries_count = cl_arr_len(entries),
+    };
+
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+
+    size_t length = sizeof(header) + cl_arr_len(entries) * sizeof(Index_Entry);
+    char *content = malloc(length);
+
+    memcpy(content, &header, sizeof(header));
+    if (cl_arr_len(entries) > 0) memcpy(content + sizeof(header), entries, cl_arr_len(entries) * sizeof(Index_Entry));
+
+    char *path = archive_path(index_file_name);
+    bool ok = write_file_atomically(path, content, length);
+
+    free(path);
+    free(content);
+
+    return ok;
+}
+
+static char *write_record_field(char *out, const char *value, size_t length) {
+    uint32_t size = (uint32_t)length;
+
+    memcpy(out, &size, sizeof(size));
+    memcpy(out + sizeof(size), value, length);
+
+    return out + sizeof(size) + length;
+}
+
+static bool read_record_field(const char **cursor, const char *end, const char **value, uint32_t *length) {
+    if ((size_t)(end - *cursor) < sizeof(uint32_t)) return false;
+
+    memcpy(length, *cursor, sizeof(uint32_t));
+    *cursor += sizeof(uint32_t);
+
+    if ((size_t)(end - *cursor) < *length) return false;
+
+    *value = *cursor;
+    *cursor += *length;
+
+    return true;
+}
+
+// writes the records of `files` as a new segment, returns its path or NULL
+static char *write_segment(Archived_File *files, uint32_t segment, uint64_t *raw_size, uint64_t *compressed_size) {
+    size_t length = 0;
+
+    for (size_t i = 0; i < cl_arr_len(files); i++) {
+        if (cl_arr_len(files[i].ranges) == 0) continue;
+
+        length += 3 * sizeof(uint32_t) + strlen(files[i].file->name) + strlen(files[i].file->relative_filepath) + files[i].archived_length;
+    }
+
+    char *records = malloc(length);
+    char *cursor = records;
+
+    for (size_t i = 0; i < cl_arr_len(files); i++) {
+        Archived_File *it = &files[i];
+
+        if (cl_arr_len(it->ranges) == 0) continue;
+
+        cursor = write_record_field(cursor, it->file->name, strlen(it->file->name));
+        cursor = write_record_field(cursor, it->file->relative_filepath, strlen(it->file->relative_filepath));
+
+        uint32_t size = (uint32_t)it->archived_length;
+
+        memcpy(cursor, &size, sizeof(size));
+        cursor += sizeof(size);
+
+        for (size_t j = 0; j < cl_arr_len(it->ranges); j++) {
+            memcpy(cursor, it->content + it->ranges[j].start, it->ranges[j].end - it->ranges[j].start);
+            cursor += it->ranges[j].end - it->ranges[j].start;
+        }
+    }
+
+    char *content = malloc(sizeof(Segment_Header) + lz_compress_bound(length));
+    size_t compressed = lz_compress(records, length, content + sizeof(Segment_Header));
+
+    Segment_Header header = {
+        .version = ARCHIVE_VERSION,
+        .raw_size = length,
+        .compressed_size = compressed,
+    };
+
+    memcpy(header.magic, segment_magic, sizeof(segment_magic));
+    memcpy(content, &header, sizeof(header));
+
+    char *path = segment_path(segment);
+    bool ok = write_file_atomically(path, content, sizeof(header) + compressed);
+
+    free(records);
+    free(content);
+
+    if (!ok) {
+        free(path);
+
+        return NULL;
+    }
+
+    *raw_size = length;
+    *compressed_size = compressed;
+
+    return path;
+}
+
+// the content of the file without its archived ranges
+static char *remove_ranges(const Archived_File *file, size_t *length) {
+    char *content = malloc(file->length - file->archived_length + 1);
+    size_t cursor = 0;
+    size_t written = 0;
+
+    for (size_t i = 0; i < cl_arr_len(file->ranges); i++) {
+        memcpy(content + written, file->content + cursor, file->ranges[i].start - cursor);
+        written += file->ranges[i].start - cursor;
+        cursor = file->ranges[i].end;
+    }
+
+    memcpy(content + written, file->content + cursor, file->length - cursor);
+    written += file->length - cursor;
+
+    *length = written;
+
+    return content;
+}
+
+static void collect_file(Archived_File *file, time_t cutoff, Index_Entry *entry, wodo_diagnostic_t **diagnostics) {
+    const char *path = file->file->view_absolute_filepath;
+
+    if (stat(path, &file->st) != 0 || !read_from_file_no_quit(path, &file->content, &file->length)) {
+        push_diagnostic(diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+
+        return;
+    }
+
+    reset_parser_state();
+
+    wodo_task_t *tasks = parse_tasks_recovering(path, file->content, file->length, diagnostics);
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        wodo_task_t task = tasks[i];
+
+        if (task.state_property.state != Wodo_Task_State_Done) continue;
+
+        time_t date = datetime_to_timestamp(task.date_property.datetime);
+
+        if (date >= cutoff) continue;
+
+        Task_Range range;
+
+        task_byte_range(file->content, file->length, task, &range.start, &range.end);
+
+        cl_arr_push(file->ranges, range);
+        file->archived_length += range.end - range.start;
+
+        if (entry->tasks_count == 0 || date < entry->min_date) entry->min_date = date;
+        if (entry->tasks_count == 0 || date > entry->max_date) entry->max_date = date;
+
+        entry->tasks_count++;
+
+        for (size_t j = 0; j < cl_arr_len(task.tags_property.node_array); j++) {
+            wodo_string_t tag = task.tags_property.node_array[j].string;
+
+            bloom_add(entry->tags_bloom, tag.value, tag.length);
+        }
+    }
+
+    free_tasks(tasks);
+}
+
+static void print_archive_summary(Archived_File *files, const char *segment, uint64_t raw_size, uint64_t compressed_size, wodo_diagnostic_t *diagnostics) {
+    size_t archived_files = 0;
+    size_t archived_tasks = 0;
+
+    printf("{\"segment\":");
+
+    if (segment != NULL) {
+        print_scaped_string_to_fd((wodo_string_t){ .value = segment, .length = strlen(segment) }, stdout);
+    } else {
+        printf("null");
+    }
+
+    printf(",\"files\":[");
+
+    for (size_t i = 0; i < cl_arr_len(files); i++) {
+        Archived_File *it = &files[i];
+
+        if (cl_arr_len(it->ranges) == 0) continue;
+
+        if (archived_files > 0) printf(",");
+
+        archived_files++;
+        archived_tasks += cl_arr_len(it->ranges);
+
+        printf("{\"name\":");
+        print_scaped_string_to_fd((wodo_string_t){ .value = it->file->name, .length = strlen(it->file->name) }, stdout);
+        printf(",\"path\":");
+        print_scaped_string_to_fd((wodo_string_t){ .value = it->file->view_absolute_filepath, .length = strlen(it->file->view_absolute_filepath) }, stdout);
+        printf(",\"tasks\":%zu}", cl_arr_len(it->ranges));
+    }
+
+    printf("],\"archived\":{\"files\":%zu,\"tasks\":%zu}", archived_files, archived_tasks);
+    printf(",\"size\":{\"raw\":%lu,\"compressed\":%lu}", (unsigned long)raw_size, (unsigned long)compressed_size);
+    printf(",\"diagnostics\":");
+    print_diagnostics_to_stdout_as_json(diagnostics);
+    printf("}\n");
+}
+
+int archive_action(Flags flags) {
+    TRACE_SCOPE("archive");
+
+    if (flags.older_than < 0) {
+        fprintf(stderr, "error: archive expects --older-than <duration>\n");
+
+        return 1;
+    }
+
+    Index_Entry *entries = CL_ARRAY_INIT;
+
+    if (!read_index(&entries)) {
+        fprintf(stderr, "error: could not read the archive index: %s\n", strerror(errno));
+
+        return 1;
+    }
+
+    char *folder = join_paths("%s/%s", database_folder(), archive_folder_name);
+
+    if (mkdir(folder, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "error: could not create %s: %s\n", folder, strerror(errno));
+        free(folder);
+        cl_arr_free(entries);
+
+        return 1;
+    }
+
+    free(folder);
+
+    // the tags are needed for the index, the descriptions are copied as bytes
+    set_parser_options((wodo_parser_options_t){ .skip_description = true });
+
+    time_t cutoff = time(NULL) - flags.older_than;
+    Archived_File *files = CL_ARRAY_INIT;
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+    Index_Entry entry = { .segment = cl_arr_len(entries) > 0 ? entries[cl_arr_len(entries) - 1].segment + 1 : 0 };
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        if (global_database.files[i]->view_deleted) continue;
+
+        Archived_File file = { .file = global_database.files[i] };
+
+        collect_file(&file, cutoff, &entry, &diagnostics);
+        cl_arr_push(files, file);
+    }
+
+    char *segment = NULL;
+    uint64_t raw_size = 0;
+    uint64_t compressed_size = 0;
+    int return_code = 0;
+
+    // the segment and the index are written before the files change, so a
+    // crash in between leaves the tasks duplicated instead of lost
+    if (entry.tasks_count > 0) {
+        segment = write_segment(files, entry.segment, &raw_size, &compressed_size);
+
+        cl_arr_push(entries, entry);
+
+        if (segment == NULL || !write_index(entries)) {
+            fprintf(stderr, "error: could not write the archive: %s\n", strerror(errno));
+
+            return_code = 1;
+        }
+    }
+
+    for (size_t i = 0; return_code == 0 && i < cl_arr_len(files); i++) {
+        Archived_File *it = &files[i];
+        const char *path = it->file->view_absolute_filepath;
+
+        if (cl_arr_len(it->ranges) == 0) continue;
+
+        size_t length;
+        char *content = remove_ranges(it, &length);
+        struct stat now;
+
+        // someone else saved the file while it was being archived
+        if (stat(path, &now) != 0 || now.st_mtim.tv_sec != it->st.st_mtim.tv_sec || now.st_mtim.tv_nsec != it->st.st_mtim.tv_nsec || now.st_size != it->st.st_size) {
+            push_diagnostic(&diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "file changed while it was being archived, its tasks are in the archive and still in the file");
+        } else if (!write_file_atomically(path, content, length)) {
+            push_diagnostic(&diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not write file, its tasks are in the archive and still in the file: %s", strerror(errno));
+        }
+
+        free(content);
+    }
+
+    if (return_code == 0) print_archive_summary(files, segment, raw_size, compressed_size, diagnostics);
+
+    for (size_t i = 0; i < cl_arr_len(files); i++) {
+        free(files[i].content);
+        cl_arr_free(files[i].ranges);
+    }
+
+    free(segment);
+    free_diagnostics(&diagnostics);
+    cl_arr_free(files);
+    cl_arr_free(entries);
+
+    return return_code;
+}
+
+static char *keep_string(const char *value, size_t length) {
+    char *string = malloc(length + 1);
+
+    memcpy(string, value, length);
+    string[length] = '\0';
+
+    cl_arr_push(kept_strings, string);
+
+    return string;
+}
+
+// decompressed records of the segment, NULL when it can't be read
+static char *read_segment(const char *path, size_t *length, wodo_diagnostic_t **diagnostics) {
+    char *content;
+    size_t content_length;
+
+    if (!read_from_file_no_quit(path, &content, &content_length)) {
+        push_diagnostic(diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read archive segment: %s", strerror(errno));
+
+        return NULL;
+    }
+
+    Segment_Header header;
+    char *records = NULL;
+
+    if (content_length >= sizeof(header)) memcpy(&header, content, sizeof(header));
+
+    if (content_length < sizeof(header)
+        || memcmp(header.magic, segment_magic, sizeof(segment_magic)) != 0
+        || header.version != ARCHIVE_VERSION
+        || header.compressed_size != content_length - sizeof(header)
+        || (records = malloc(header.raw_size + 1)) == NULL
+        || !lz_decompress(content + sizeof(header), header.compressed_size, records, header.raw_size)) {
+        push_diagnostic(diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "corrupted archive segment");
+        free(records);
+        free(content);
+
+        return NULL;
+    }
+
+    free(content);
+
+    *length = header.raw_size;
+
+    return records;
+}
+
+void for_each_archived_file(Flags flags, wodo_diagnostic_t **diagnostics, void (*callback)(const char *name, const char *filepath, wodo_task_t *tasks, void *data), void *data) {
+    TRACE_SCOPE("for_each_archived_file");
+
+    // only done tasks are archived
+    wodo_task_t done_task = { .state_property.state = Wodo_Task_State_Done };
+    Flags state_flags = flags;
+
+    state_flags.tag_filter = NULL;
+    state_flags.property_filters = NULL;
+
+    if (!default_task_predicate(done_task, state_flags)) return;
+
+    Index_Entry *entries = CL_ARRAY_INIT;
+
+    if (!read_index(&entries)) {
+        char *path = archive_path(index_file_name);
+
+        push_diagnostic(diagnostics, keep_string(path, strlen(path)), (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read the archive index: %s", strerror(errno));
+        free(path);
+
+        return;
+    }
+
+    for (size_t i = 0; i < cl_arr_len(entries); i++) {
+        if (!entry_may_match_tags(&entries[i], flags)) continue;
+
+        char *path = segment_path(entries[i].segment);
+        const char *kept_path = keep_string(path, strlen(path));
+        size_t length;
+        char *records = read_segment(kept_path, &length, diagnostics);
+
+        free(path);
+
+        if (records == NULL) continue;
+
+        const char *cursor = records;
+        const char *end = records + length;
+
+        while (cursor < end) {
+            const char *name, *relative_filepath, *text;
+            uint32_t name_size, path_size, text_size;
+
+            if (!read_record_field(&cursor, end, &name, &name_size)
+                || !read_record_field(&cursor, end, &relative_filepath, &path_size)
+                || !read_record_field(&cursor, end, &text, &text_size)) {
+                push_diagnostic(diagnostics, kept_path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "corrupted archive segment");
+
+                break;
+            }
+
+            const char *kept_name = keep_string(name, name_size);
+            char *relative = strndup(relative_filepath, path_size);
+            char *filepath = join_paths("%s/%s", database_folder(), relative);
+            const char *kept_filepath = keep_string(filepath, strlen(filepath));
+            // the parser expects the text to be null terminated, like a file
+            char *content = malloc(text_size + 1);
+
+            memcpy(content, text, text_size);
+            content[text_size] = '\0';
+            free(relative);
+            free(filepath);
+
+            reset_parser_state();
+
+            wodo_task_t *tasks = parse_tasks_recovering(kept_filepath, content, text_size, diagnostics);
+
+            callback(kept_name, kept_filepath, tasks, data);
+
+            free_tasks(tasks);
+            free(content);
+        }
+
+        free(records);
+    }
+
+    cl_arr_free(entries);
+}
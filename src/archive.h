@@ -0,0 +1,21 @@
+#ifndef _WODO_ARCHIVE_H_
+#define _WODO_ARCHIVE_H_
+
+#include "argparser.h"
+#include "systemtypes.h"
+
+// `wodo archive --older-than <duration>`
+//
+// moves the done tasks with a date older than the duration out of the
+// database files into a new compressed segment in .wodo/archive/. Segments
+// are never changed once written, .wodo/archive/index keeps the date range
+// and a bloom filter of the tags of every segment.
+int archive_action(Flags flags);
+
+// calls `callback` with the archived tasks of every file, only for the
+// segments whose index entry can match the state and tag filters of `flags`.
+// The diagnostics of the archived tasks point to strings that are kept until
+// the process exits.
+void for_each_archived_file(Flags flags, wodo_diagnostic_t **diagnostics, void (*callback)(const char *name, const char *filepath, wodo_task_t *tasks, void *data), void *data);
+
+#endif // !_WODO_ARCHIVE_H_
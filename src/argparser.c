@@ -1,10 +1,82 @@
 #define CL_ARRAY_IMPLEMENTATION
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <limits.h>
 #include "argparser.h"
 #include "utils.h"
 #include "arr.h"
 
+// "title,state" -> WODO_FIELD_TITLE | WODO_FIELD_STATE. returns 0 on unknown fields
+static unsigned parse_fields(const char *value) {
+    static const struct { const char *name; unsigned field; } fields[] = {
+        { "title", WODO_FIELD_TITLE },
+        { "state", WODO_FIELD_STATE },
+        { "date", WODO_FIELD_DATE },
+        { "tags", WODO_FIELD_TAGS },
+        { "remind", WODO_FIELD_REMIND },
+        { "description", WODO_FIELD_DESCRIPTION },
+        { "id", WODO_FIELD_ID },
+        { "properties", WODO_FIELD_PROPERTIES },
+        { "depends", WODO_FIELD_DEPENDS },
+    };
+
+    unsigned mask = 0;
+
+    while (*value != '\0') {
+        size_t size = strcspn(value, ",");
+        unsigned field = 0;
+
+        for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+            if (cmp_sized_strings(value, fields[i].name, size, strlen(fields[i].name))) {
+                field = fields[i].field;
+                break;
+            }
+        }
+
+        if (field == 0) return 0;
+
+        mask |= field;
+        value += size;
+
+        if (*value == ',') value++;
+    }
+
+    return mask;
+}
+
+// "30d" -> seconds, without a unit the number is in days. returns -1 when invalid
+static long parse_duration(const char *value) {
+    static const struct { char unit; long seconds; } units[] = {
+        { 's', 1 },
+        { 'm', 60 },
+        { 'h', 60 * 60 },
+        { 'd', 24 * 60 * 60 },
+        { 'w', 7 * 24 * 60 * 60 },
+    };
+
+    char *end = NULL;
+    long count = strtol(value, &end, 10);
+
+    if (end == value || count < 0) return -1;
+
+    long seconds = 24 * 60 * 60;
+
+    if (*end != '\0') {
+        seconds = -1;
+
+        for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+            if (units[i].unit == *end) seconds = units[i].seconds;
+        }
+
+        if (seconds < 0 || end[1] != '\0') return -1;
+    }
+
+    if (count > LONG_MAX / seconds) return -1;
+
+    return count * seconds;
+}
+
 static char *shift(int *argc, char ***argv) {
     if (*argc == 0) return NULL;
 
@@ -20,6 +92,9 @@ Arguments *parse_arguments(int argc, char **argv) {
 
     args->flags.state_filter = NULL;
     args->flags.tag_filter = NULL;
+    args->flags.fields = WODO_FIELD_ALL;
+    args->flags.description_preview = -1;
+    args->flags.older_than = -1;
 
     char *arg;
 
@@ -102,6 +177,135 @@ Arguments *parse_arguments(int argc, char **argv) {
             args->kind = AK_GET_REMINDERS;
         } else if (arg_cmp_single(arg, "init")) {
             args->kind = AK_INIT;
+        } else if (arg_cmp_single(arg, "check")) {
+            args->kind = AK_CHECK;
+        } else if (arg_cmp_single(arg, "search")) {
+            args->kind = AK_SEARCH;
+
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "action \"%s\" expects a query.", arg);
+
+                goto error;
+            }
+
+            args->arg1 = value;
+        } else if (arg_cmp_single(arg, "diff")) {
+            char *old_path = getarg();
+            char *new_path = getarg();
+
+            if (old_path == NULL || new_path == NULL) {
+                usage(stderr, args->program_name, "action \"%s\" expects two paths.", arg);
+
+                goto error;
+            }
+
+            args->kind = AK_DIFF;
+            args->arg1 = old_path;
+            args->arg2 = new_path;
+        } else if (arg_cmp_single(arg, "get")) {
+            char *path = getarg();
+            char *id = getarg();
+
+            if (path == NULL || id == NULL) {
+                usage(stderr, args->program_name, "action \"%s\" expects a path and a task id.", arg);
+
+                goto error;
+            }
+
+            args->kind = AK_GET;
+            args->arg1 = path;
+            args->arg2 = id;
+        } else if (arg_cmp_single(arg, "set")) {
+            args->kind = AK_SET;
+        } else if (arg_cmp_single(arg, "--state")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a state.", arg);
+
+                goto error;
+            }
+
+            args->flags.set_state = value;
+        } else if (arg_cmp_single(arg, "--add-tag") || arg_cmp_single(arg, "--remove-tag") || arg_cmp_single(arg, "--rename-tag")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a tag.", arg);
+
+                goto error;
+            }
+
+            if (strcmp(arg, "--add-tag") == 0) {
+                cl_arr_push(args->flags.add_tags, value);
+            } else if (strcmp(arg, "--remove-tag") == 0) {
+                cl_arr_push(args->flags.remove_tags, value);
+            } else {
+                cl_arr_push(args->flags.rename_tags, value);
+            }
+        } else if (arg_cmp_single(arg, "--dry-run")) {
+            args->flags.dry_run = true;
+        } else if (arg_cmp_single(arg, "archive")) {
+            args->kind = AK_ARCHIVE;
+        } else if (arg_cmp_single(arg, "--older-than")) {
+            char *value = getarg();
+
+            args->flags.older_than = value == NULL ? -1 : parse_duration(value);
+
+            if (args->flags.older_than < 0) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a duration like 30d, 12h or 2w.", arg);
+
+                goto error;
+            }
+        } else if (arg_cmp_single(arg, "--include-archive")) {
+            args->flags.include_archive = true;
+        } else if (arg_cmp_single(arg, "gc")) {
+            args->kind = AK_GC;
+        } else if (arg_cmp_single(arg, "next")) {
+            args->kind = AK_NEXT;
+        } else if (arg_cmp_single(arg, "--adopt")) {
+            args->flags.adopt = true;
+        } else if (arg_cmp_single(arg, "batch")) {
+            args->kind = AK_BATCH;
+        } else if (arg_cmp_single(arg, "pick")) {
+            args->kind = AK_PICK;
+        } else if (arg_cmp_single(arg, "--query")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a query.", arg);
+
+                goto error;
+            }
+
+            args->flags.query = value;
+        } else if (arg_cmp_single(arg, "--files")) {
+            args->flags.files = true;
+        } else if (arg_cmp_single(arg, "--sort")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a sort key.", arg);
+
+                goto error;
+            }
+
+            args->flags.sort = value;
+        } else if (arg_cmp_single(arg, "--limit")) {
+            char *value = getarg();
+            char *end = NULL;
+
+            long limit = value == NULL ? -1 : strtol(value, &end, 10);
+
+            if (value == NULL || *end != '\0' || limit <= 0 || limit > INT_MAX) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a positive number.", arg);
+
+                goto error;
+            }
+
+            args->flags.limit = (int)limit;
         } else if (arg_cmp(arg, "--filter-tag", "-ft")) {
             char *value = getarg();
 
@@ -112,6 +316,75 @@ Arguments *parse_arguments(int argc, char **argv) {
             }
 
             cl_arr_push(args->flags.tag_filter, value);
+        } else if (arg_cmp_single(arg, "--stream")) {
+            args->flags.stream = true;
+        } else if (arg_cmp_single(arg, "--follow")) {
+            args->flags.follow = true;
+        } else if (arg_cmp_single(arg, "--ndjson")) {
+            args->flags.ndjson = true;
+        } else if (arg_cmp_single(arg, "--fields")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a list of fields.", arg);
+
+                goto error;
+            }
+
+            args->flags.fields = parse_fields(value);
+
+            if (args->flags.fields == 0) {
+                usage(stderr, args->program_name, "invalid fields \"%s\".", value);
+
+                goto error;
+            }
+        } else if (arg_cmp_single(arg, "--no-locations")) {
+            args->flags.no_locations = true;
+        } else if (arg_cmp_single(arg, "--desc-preview")) {
+            char *value = getarg();
+            char *end = NULL;
+
+            long preview = value == NULL ? -1 : strtol(value, &end, 10);
+
+            if (value == NULL || *end != '\0' || preview < 0 || preview > INT_MAX) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a number of characters.", arg);
+
+                goto error;
+            }
+
+            args->flags.description_preview = (int)preview;
+        } else if (arg_cmp_single(arg, "--format")) {
+            char *value = getarg();
+
+            if (value != NULL && strcmp(value, "json") == 0) {
+                args->flags.format = OF_JSON;
+            } else if (value != NULL && strcmp(value, "msgpack") == 0) {
+                args->flags.format = OF_MSGPACK;
+            } else {
+                usage(stderr, args->program_name, "flag \"%s\" expects json or msgpack.", arg);
+
+                goto error;
+            }
+        } else if (arg_cmp_single(arg, "--trace")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a file path.", arg);
+
+                goto error;
+            }
+
+            args->trace_output = value;
+        } else if (arg_cmp_single(arg, "--workspace")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "flag \"%s\" expects a file path.", arg);
+
+                goto error;
+            }
+
+            args->workspace = value;
         } else if (arg_cmp(arg, "--filter-state", "-fs")) {
             char *value = getarg();
 
@@ -122,6 +395,16 @@ Arguments *parse_arguments(int argc, char **argv) {
             }
 
             cl_arr_push(args->flags.state_filter, value);
+        } else if (arg_cmp(arg, "--filter-property", "-fp")) {
+            char *value = getarg();
+
+            if (value == NULL) {
+                usage(stderr, args->program_name, "action \"%s\" expects a value.", arg);
+
+                goto error;
+            }
+
+            cl_arr_push(args->flags.property_filter, value);
         } else {
             if (*arg == '-') {
                 usage(stderr, args->program_name, "flag %s does not exists.", arg);
@@ -156,19 +439,66 @@ void usage(FILE *stream, const char *program_name, char *error_message, ...) {
     fprintf(stream, "  remove, r  <path>             Remove a file from the system\n");
     fprintf(stream, "  rename, n  <path> <title>     Rename an existing .wodo file\n");
     fprintf(stream, "  format, f  <path>             Format and clean a .wodo file from stdin;\n");
-    fprintf(stream, "                                <path> here is used only for error reporting.\n\n");
+    fprintf(stream, "                                <path> here is used only for error reporting.\n");
+    fprintf(stream, "                                --stream writes every task as soon as it's read.\n");
+    fprintf(stream, "  batch                         Apply one command per line from stdin and save the database once:\n");
+    fprintf(stream, "                                {\"op\":\"add\",\"title\":..}, {\"op\":\"rename\",\"path\":..,\"title\":..}\n");
+    fprintf(stream, "                                or {\"op\":\"remove\",\"path\":..}. Prints one result line per command.\n");
+    fprintf(stream, "  set        [flags]            Edit every task matching -ft/-fs in place and print a summary:\n");
+    fprintf(stream, "                                --state <state>, --add-tag <tag>, --remove-tag <tag> and\n");
+    fprintf(stream, "                                --rename-tag <old>=<new> (all can be repeated but --state);\n");
+    fprintf(stream, "                                --dry-run only prints what would change.\n");
+    fprintf(stream, "  archive    --older-than <n>   Move the done tasks older than <n> (30d, 12h, 2w; s, m, h, d or w,\n");
+    fprintf(stream, "                                days by default) into a compressed segment in .wodo/archive.\n");
+    fprintf(stream, "  gc         [flags]            Drop the database entries whose file is gone and report the .wodo\n");
+    fprintf(stream, "                                files missing from the database; --adopt adds them back,\n");
+    fprintf(stream, "                                --dry-run only prints what would change.\n\n");
 
     // --- DATA & INSPECTION GROUP ---
     fprintf(stream, "Data & Inspection:\n");
     fprintf(stream, "  reminders                     List all (not done) tasks marked with 'remind' property\n");
-    fprintf(stream, "  list, l    [flags]            List all database files\n");
+    fprintf(stream, "  reminders --follow            Keep running and print an event line when a reminder is due\n");
+    fprintf(stream, "  check                         Validate every database file and report all errors\n");
+    fprintf(stream, "  search     <query> [flags]    Find tasks with every word of <query> in the title or description;\n");
+    fprintf(stream, "                                --limit <n> keeps the best <n> results.\n");
+    fprintf(stream, "  pick --query <q> [flags]      Fuzzy match <q> against every task title (or file name with\n");
+    fprintf(stream, "                                --files) and output the best --limit <n> matches, best first.\n");
+    fprintf(stream, "  diff       <old> <new>        Task level changes between two versions of a .wodo file\n");
+    fprintf(stream, "                                (\"-\" reads one of them from stdin): add, remove, modify and move events.\n");
+    fprintf(stream, "  get        <path> <id>        Output the task with <id> (the \"id\" field of list/parse)\n");
+    fprintf(stream, "                                reading only its lines of <path>.\n");
+    fprintf(stream, "  next       [--limit <n>]      Output the tasks that are not done and whose .depends tasks\n");
+    fprintf(stream, "                                (<id> of the same file or <file name>:<id>) are all done,\n");
+    fprintf(stream, "                                with the dependency cycles and the ids no task has.\n");
+    fprintf(stream, "  list, l    [flags]            List all database files;\n");
+    fprintf(stream, "                                --include-archive also lists the archived tasks.\n");
+    fprintf(stream, "                                --sort <key> outputs every task in one list ordered by date, state,\n");
+    fprintf(stream, "                                title, file, mtime or a property ('-' before it for descending),\n");
+    fprintf(stream, "                                with --sort, --limit <n> keeps only the first <n> tasks.\n");
     fprintf(stream, "  parse, p   <path> [flags]     Parse a .wodo file;\n");
-    fprintf(stream, "                                <path> here is used only for error reporting.\n\n");
+    fprintf(stream, "                                <path> here is used only for error reporting.\n");
+    fprintf(stream, "                                --stream writes every task as soon as it's read, keeping\n");
+    fprintf(stream, "                                only that task in memory (msgpack needs --ndjson).\n\n");
 
     // --- FILTER FLAGS GROUP ---
-    fprintf(stream, "Global Filter Flags (use with list/parse):\n");
+    fprintf(stream, "Global Filter Flags (use with list/parse/set):\n");
     fprintf(stream, "  -ft, --filter-tag   <tag>     Filter by tag (can be used multiple times)\n");
-    fprintf(stream, "  -fs, --filter-state <state>   Filter by state (can be used multiple times)\n\n");
+    fprintf(stream, "  -fs, --filter-state <state>   Filter by state (can be used multiple times)\n");
+    fprintf(stream, "  -fp, --filter-property <p>    Filter by a property of .wodo/properties: <name><op><value> with\n");
+    fprintf(stream, "                                =, !=, <, <=, > or >=, e.g. priority>=medium or estimate<2h\n");
+    fprintf(stream, "                                (can be used multiple times, every one must match)\n\n");
+
+    // --- OUTPUT FLAGS GROUP ---
+    fprintf(stream, "Output Flags (use with list/parse/reminders/get):\n");
+    fprintf(stream, "  --ndjson                      One JSON object per line, flushed as soon as it's ready;\n");
+    fprintf(stream, "                                a file per line for list/reminders, a task per line for parse.\n");
+    fprintf(stream, "  --format <json|msgpack>       Output format, json by default. With --ndjson and msgpack\n");
+    fprintf(stream, "                                every object is written as its own MessagePack value.\n");
+    fprintf(stream, "  --fields <f1,f2,...>          Only output these task fields:\n");
+    fprintf(stream, "                                id, title, state, date, tags, remind, description, properties,\n");
+    fprintf(stream, "                                depends\n");
+    fprintf(stream, "  --no-locations                Do not output locations\n");
+    fprintf(stream, "  --desc-preview <n>            Truncate descriptions to <n> characters\n\n");
 
     // --- REFERENCE DATA ---
     fprintf(stream, "Available States:\n");
@@ -176,6 +506,10 @@ void usage(FILE *stream, const char *program_name, char *error_message, ...) {
 
     fprintf(stream, "General:\n");
     fprintf(stream, "  help, h                       Display this help message\n");
+    fprintf(stream, "  --trace <file>                Write a Chrome trace of the execution (build with TRACE=1)\n");
+    fprintf(stream, "  --workspace <file>            Run list, reminders or search in every repository listed in <file>\n");
+    fprintf(stream, "                                (one root per line) at the same time and merge the results,\n");
+    fprintf(stream, "                                every object gets a \"repository\" field.\n");
 
     if (error_message != NULL) {
         va_start(args, error_message);
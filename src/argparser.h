@@ -2,21 +2,71 @@
 #define _WODO_ARGPARSER_H_
 
 #include <stdio.h>
+#include <stdbool.h>
+#include "systemtypes.h"
 
 typedef enum {
     AK_ADD = 1,         // arg1(title)
     AK_REMOVE,          // arg1(path)
-    AK_PARSE,           // (stdin) tag_filter(-ft) state_filter(-fs)
-    AK_LIST,            // tag_filter(-ft) state_filter(-fs)
-    AK_FORMAT,          // (stdin)
+    AK_PARSE,           // (stdin) tag_filter(-ft) state_filter(-fs) property_filter(-fp) stream(--stream)
+    AK_LIST,            // tag_filter(-ft) state_filter(-fs) property_filter(-fp) sort(--sort) limit(--limit)
+    AK_FORMAT,          // (stdin) stream(--stream)
     AK_RENAME,          // arg1(path) arg2(title)
     AK_GET_REMINDERS,   //
     AK_INIT,            //
+    AK_CHECK,           //
+    AK_SEARCH,          // arg1(query) limit(--limit)
+    AK_PICK,            // query(--query) limit(--limit) files(--files)
+    AK_DIFF,            // arg1(old path) arg2(new path)
+    AK_GET,             // arg1(path) arg2(id)
+    AK_BATCH,           // (stdin)
+    AK_SET,             // tag_filter(-ft) state_filter(-fs) property_filter(-fp) set_state(--state) add_tags(--add-tag) remove_tags(--remove-tag) rename_tags(--rename-tag) dry_run(--dry-run)
+    AK_ARCHIVE,         // older_than(--older-than)
+    AK_GC,              // adopt(--adopt) dry_run(--dry-run)
+    AK_NEXT,            // limit(--limit)
 } ArgumentKind;
 
+// task fields that can be selected with --fields
+#define WODO_FIELD_TITLE        (1 << 0)
+#define WODO_FIELD_STATE        (1 << 1)
+#define WODO_FIELD_DATE         (1 << 2)
+#define WODO_FIELD_TAGS         (1 << 3)
+#define WODO_FIELD_REMIND       (1 << 4)
+#define WODO_FIELD_DESCRIPTION  (1 << 5)
+#define WODO_FIELD_ID           (1 << 6)
+#define WODO_FIELD_PROPERTIES   (1 << 7)
+#define WODO_FIELD_DEPENDS      (1 << 8)
+#define WODO_FIELD_ALL          ((1 << 9) - 1)
+
+typedef enum {
+    OF_JSON = 0,
+    OF_MSGPACK,
+} OutputFormat;
+
 typedef struct {
-    char **tag_filter;   // CL_ARRAY_INIT
-    char **state_filter; // CL_ARRAY_INIT
+    char **tag_filter;          // CL_ARRAY_INIT
+    char **state_filter;        // CL_ARRAY_INIT
+    char **property_filter;     // --filter-property <name><op><value>, CL_ARRAY_INIT
+    wodo_property_filter_t *property_filters; // `property_filter` resolved by compile_property_filters, CL_ARRAY_INIT
+    bool ndjson;                // --ndjson
+    unsigned fields;            // --fields, WODO_FIELD_* mask. Default is WODO_FIELD_ALL
+    bool no_locations;          // --no-locations
+    int description_preview;    // --desc-preview, in UTF-8 characters. -1 means the whole description
+    OutputFormat format;        // --format
+    bool follow;                // --follow
+    int limit;                  // --limit, 0 means no limit
+    const char *query;          // --query
+    bool files;                 // --files
+    const char *set_state;      // --state
+    char **add_tags;            // --add-tag, CL_ARRAY_INIT
+    char **remove_tags;         // --remove-tag, CL_ARRAY_INIT
+    char **rename_tags;         // --rename-tag <old>=<new>, CL_ARRAY_INIT
+    bool dry_run;               // --dry-run
+    long older_than;            // --older-than <n>[s|m|h|d|w], in seconds. -1 when not given
+    bool include_archive;       // --include-archive
+    bool adopt;                 // --adopt
+    bool stream;                // --stream
+    const char *sort;           // --sort <key>, NULL keeps the database order
 } Flags;
 
 typedef struct {
@@ -25,6 +75,12 @@ typedef struct {
     char *arg1;
     char *arg2;
 
+    // --trace <file>, NULL when tracing is disabled
+    const char *trace_output;
+
+    // --workspace <file>, NULL to use the repository of the working directory
+    const char *workspace;
+
     Flags flags;
 } Arguments;
 
@@ -52,6 +52,14 @@ typedef struct {
 
 #define cl_arr_len(arr) ((arr) ? ((CL_ArrayHeader*)(arr) - 1)->count : 0)
 
+// drops the elements from `len` on, it never grows the array
+#define cl_arr_truncate(arr, len)                                                           \
+    do {                                                                                    \
+        if ((arr) != CL_ARRAY_INIT && (size_t)(len) < ((CL_ArrayHeader*)(arr) - 1)->count) {\
+            ((CL_ArrayHeader*)(arr) - 1)->count = (len);                                    \
+        }                                                                                   \
+    } while (0)
+
 #define cl_arr_free(arr)                    \
     do {                                    \
         if (arr != CL_ARRAY_INIT) {         \
@@ -0,0 +1,349 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "batch.h"
+#include "arr.h"
+#include "database.h"
+#include "io.h"
+#include "utils.h"
+#include "trace.h"
+
+typedef struct {
+    char *op;
+    char *title;
+    char *path;
+} Batch_Command;
+
+typedef struct {
+    const char *cursor;
+    const char *end;
+} Json_Reader;
+
+static void skip_spaces(Json_Reader *reader) {
+    while (reader->cursor < reader->end && (*reader->cursor == ' ' || *reader->cursor == '\t' || *reader->cursor == '\r')) reader->cursor++;
+}
+
+static bool expect(Json_Reader *reader, char c) {
+    skip_spaces(reader);
+
+    if (reader->cursor >= reader->end || *reader->cursor != c) return false;
+
+    reader->cursor++;
+
+    return true;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+    return -1;
+}
+
+static bool read_hex4(Json_Reader *reader, uint32_t *out) {
+    if (reader->end - reader->cursor < 4) return false;
+
+    uint32_t value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        int digit = hex_value(reader->cursor[i]);
+
+        if (digit < 0) return false;
+
+        value = value * 16 + digit;
+    }
+
+    reader->cursor += 4;
+    *out = value;
+
+    return true;
+}
+
+static void push_utf8(char **out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        cl_arr_push(*out, (char)codepoint);
+    } else if (codepoint < 0x800) {
+        cl_arr_push(*out, (char)(0xc0 | (codepoint >> 6)));
+        cl_arr_push(*out, (char)(0x80 | (codepoint & 0x3f)));
+    } else if (codepoint < 0x10000) {
+        cl_arr_push(*out, (char)(0xe0 | (codepoint >> 12)));
+        cl_arr_push(*out, (char)(0x80 | ((codepoint >> 6) & 0x3f)));
+        cl_arr_push(*out, (char)(0x80 | (codepoint & 0x3f)));
+    } else {
+        cl_arr_push(*out, (char)(0xf0 | (codepoint >> 18)));
+        cl_arr_push(*out, (char)(0x80 | ((codepoint >> 12) & 0x3f)));
+        cl_arr_push(*out, (char)(0x80 | ((codepoint >> 6) & 0x3f)));
+        cl_arr_push(*out, (char)(0x80 | (codepoint & 0x3f)));
+    }
+}
+
+// returns a null terminated copy of the string without the escapes, NULL when it's invalid
+static char *read_string(Json_Reader *reader) {
+    if (!expect(reader, '"')) return NULL;
+
+    char *value = CL_ARRAY_INIT;
+
+    while (reader->cursor < reader->end && *reader->cursor != '"') {
+        char c = *reader->cursor++;
+
+        if (c != '\\') {
+            cl_arr_push(value, c);
+
+            continue;
+        }
+
+        if (reader->cursor >= reader->end) break;
+
+        c = *reader->cursor++;
+
+        switch (c) {
+            case '"': case '\\': case '/': cl_arr_push(value, c); break;
+            case 'b': cl_arr_push(value, '\b'); break;
+            case 'f': cl_arr_push(value, '\f'); break;
+            case 'n': cl_arr_push(value, '\n'); break;
+            case 'r': cl_arr_push(value, '\r'); break;
+            case 't': cl_arr_push(value, '\t'); break;
+            case 'u': {
+                uint32_t codepoint, low;
+
+                if (!read_hex4(reader, &codepoint)) goto invalid;
+
+                // surrogate pair
+                if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
+                    if (reader->end - reader->cursor < 2 || reader->cursor[0] != '\\' || reader->cursor[1] != 'u') goto invalid;
+
+                    reader->cursor += 2;
+
+                    if (!read_hex4(reader, &low) || low < 0xdc00 || low > 0xdfff) goto invalid;
+
+                    codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+
+                push_utf8(&value, codepoint);
+            } break;
+            default: goto invalid;
+        }
+    }
+
+    if (reader->cursor >= reader->end) goto invalid;
+
+    reader->cursor++;
+
+    size_t length = cl_arr_len(value);
+    char *string = malloc(length + 1);
+
+    if (length > 0) memcpy(string, value, length);
+
+    string[length] = '\0';
+
+    cl_arr_free(value);
+
+    return string;
+
+invalid:
+    cl_arr_free(value);
+
+    return NULL;
+}
+
+static void free_command(Batch_Command *command) {
+    free(command->op);
+    free(command->title);
+    free(command->path);
+}
+
+// a flat object with string values, unknown keys are ignored
+static const char *parse_command(const char *line, size_t length, Batch_Command *command) {
+    Json_Reader reader = { .cursor = line, .end = line + length };
+
+    if (!expect(&reader, '{')) return "expected an object";
+
+    skip_spaces(&reader);
+
+    if (reader.cursor < reader.end && *reader.cursor == '}') {
+        reader.cursor++;
+    } else {
+        while (true) {
+            char *key = read_string(&reader);
+
+            if (key == NULL) return "expected a string key";
+
+            if (!expect(&reader, ':')) {
+                free(key);
+
+                return "expected ':' after the key";
+            }
+
+            char *value = read_string(&reader);
+
+            if (value == NULL) {
+                free(key);
+
+                return "expected a string value";
+            }
+
+            char **field = NULL;
+
+            if (strcmp(key, "op") == 0) field = &command->op;
+            else if (strcmp(key, "title") == 0) field = &command->title;
+            else if (strcmp(key, "path") == 0) field = &command->path;
+
+            free(key);
+
+            if (field != NULL) {
+                free(*field);
+                *field = value;
+            } else {
+                free(value);
+            }
+
+            if (expect(&reader, ',')) continue;
+            if (expect(&reader, '}')) break;
+
+            return "expected ',' or '}'";
+        }
+    }
+
+    skip_spaces(&reader);
+
+    if (reader.cursor != reader.end) return "unexpected characters after the object";
+    if (command->op == NULL) return "missing \"op\"";
+
+    return NULL;
+}
+
+static void print_error(size_t line, const char *message) {
+    printf("{\"line\":%zu,\"ok\":false,\"error\":", line);
+    print_scaped_string_to_fd((wodo_string_t){ .value = message, .length = strlen(message) }, stdout);
+    printf("}\n");
+}
+
+static void print_status_error(size_t line, database_status_code_t status_code) {
+    print_error(line, status_code == DATABASE_ERRNO ? strerror(errno) : database_status_code_string(status_code));
+}
+
+static void print_ok(size_t line, const char *op, const char *path) {
+    printf("{\"line\":%zu,\"ok\":true,\"op\":\"%s\",\"path\":", line, op);
+    print_scaped_string_to_fd((wodo_string_t){ .value = path, .length = strlen(path) }, stdout);
+    printf("}\n");
+}
+
+// returns false when the command failed, the error is already printed
+static bool run_command(size_t line, Batch_Command *command) {
+    const char *op = command->op;
+
+    if (strcmp(op, "add") == 0) {
+        if (command->title == NULL) {
+            print_error(line, "add expects a \"title\"");
+
+            return false;
+        }
+
+        char *absolute_filepath;
+        // the database keeps the name
+        database_status_code_t status_code = database_add_file(strdup(command->title), &absolute_filepath);
+
+        if (status_code != DATABASE_OK_STATUS_CODE) {
+            print_status_error(line, status_code);
+
+            return false;
+        }
+
+        print_ok(line, op, absolute_filepath);
+
+        return true;
+    }
+
+    if (strcmp(op, "rename") != 0 && strcmp(op, "remove") != 0) {
+        print_error(line, "unknown \"op\", expected add, rename or remove");
+
+        return false;
+    }
+
+    if (command->path == NULL) {
+        print_error(line, "expected a \"path\"");
+
+        return false;
+    }
+
+    bool rename = strcmp(op, "rename") == 0;
+
+    if (rename && command->title == NULL) {
+        print_error(line, "rename expects a \"title\"");
+
+        return false;
+    }
+
+    char *absolute_filepath = realpath(command->path, NULL);
+    database_status_code_t status_code = DATABASE_NOT_FOUND_STATUS_CODE;
+
+    if (absolute_filepath != NULL && database_get_file_by_filepath(NULL, absolute_filepath) == DATABASE_OK_STATUS_CODE) {
+        status_code = rename
+            ? database_rename_file(absolute_filepath, command->title)
+            : database_delete_file(absolute_filepath);
+    }
+
+    if (status_code == DATABASE_OK_STATUS_CODE) {
+        print_ok(line, op, absolute_filepath);
+    } else {
+        print_status_error(line, status_code);
+    }
+
+    free(absolute_filepath);
+
+    return status_code == DATABASE_OK_STATUS_CODE;
+}
+
+int batch_action(void) {
+    TRACE_SCOPE("batch");
+
+    char *content;
+    size_t length = read_from_stdin(&content);
+    const char *cursor = content;
+    const char *end = content + length;
+    size_t line = 0;
+    int return_code = 0;
+
+    database_begin_batch();
+
+    while (cursor < end) {
+        const char *newline = memchr(cursor, '\n', end - cursor);
+        size_t line_length = (newline == NULL ? end : newline) - cursor;
+        const char *line_start = cursor;
+
+        cursor += line_length + 1;
+        line++;
+
+        while (line_length > 0 && (line_start[line_length - 1] == '\r' || line_start[line_length - 1] == ' ')) line_length--;
+
+        if (line_length == 0) continue;
+
+        Batch_Command command = {0};
+        const char *error = parse_command(line_start, line_length, &command);
+
+        if (error != NULL) {
+            print_error(line, error);
+            return_code = 1;
+        } else if (!run_command(line, &command)) {
+            return_code = 1;
+        }
+
+        free_command(&command);
+    }
+
+    free(content);
+
+    database_status_code_t status_code = database_commit();
+
+    if (status_code != DATABASE_OK_STATUS_CODE) {
+        fprintf(stderr, "error: could not save the database: %s\n", status_code == DATABASE_ERRNO ? strerror(errno) : database_status_code_string(status_code));
+
+        return 1;
+    }
+
+    return return_code;
+}
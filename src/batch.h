@@ -0,0 +1,15 @@
+#ifndef _WODO_BATCH_H_
+#define _WODO_BATCH_H_
+
+// `wodo batch`
+//
+// reads one command per line from stdin:
+//   {"op":"add","title":"..."}
+//   {"op":"rename","path":"...","title":"..."}
+//   {"op":"remove","path":"..."}
+// and prints one result per command: {"line":1,"ok":true,...} or
+// {"line":1,"ok":false,"error":"..."}. The database is loaded and written
+// only once, when every command was applied.
+int batch_action(void);
+
+#endif // !_WODO_BATCH_H_
@@ -8,26 +8,50 @@
 #include <assert.h>
 #include <unistd.h>
 #include <libgen.h>
+#include <fcntl.h>
+#include <sys/file.h>
 #include "database.h"
 #include "utils.h"
 #include "arr.h"
 #include "crypt.h"
 #include "crossplatformops.h"
+#include "trace.h"
 
 
 static const char *db_folder_name = ".wodo";
 static const char *file_extension = ".wodo";
 static const char *db_filename = ".wodo.db";
 static const char *db_file_magic_bytes = ".WODO";
+static const char *lock_filename = ".lock";
 static char *wodo_current_working_directory = NULL;
 static char *wodo_current_working_directory_db = NULL;
 
-static Database_File_Path get_unix_filepath(const char *name, size_t name_size) {
+// view_absolute_filepath -> index in global_database.files + 1, 0 is a free
+// slot. It's built by the first lookup and kept up to date by the mutations
+static size_t *file_index = NULL;
+static size_t file_index_capacity = 0;
+static size_t file_index_count = 0;
+
+// with a batch open the mutations only change the database in memory and the
+// removed files are deleted once it's committed
+static bool batch_open = false;
+static bool batch_dirty = false;
+static char **batch_removed_files = CL_ARRAY_INIT;
+
+// .wodo/.lock, held exclusively by the process that changes the repository
+static int lock_fd = -1;
+
+// attempt 0 is <name-hash>-<unix>.wodo, the next ones <name-hash>-<unix>-<attempt>.wodo
+static Database_File_Path get_unix_filepath(const char *name, size_t name_size, unsigned attempt) {
     unsigned char *hash = hash_bytes(name, name_size);
     unsigned long timestamp = get_current_timestamp();
-    char timestamp_string[32];
+    char timestamp_string[48];
 
-    snprintf(timestamp_string, sizeof(timestamp_string), "%lu", timestamp);
+    if (attempt == 0) {
+        snprintf(timestamp_string, sizeof(timestamp_string), "%lu", timestamp);
+    } else {
+        snprintf(timestamp_string, sizeof(timestamp_string), "%lu-%u", timestamp, attempt);
+    }
 
     char *relative_filepath = join_paths("%s-%s%s", hash, timestamp_string, file_extension);
     char *absolute_filepath = join_paths("%s/%s", wodo_current_working_directory, relative_filepath);
@@ -74,12 +98,16 @@ static void save_database_latest_version(FILE *file) {
     }
 }
 
-static void database_save() {
-    FILE *file = fopen(wodo_current_working_directory_db, "wb");
+// the database is written to a temporary file that replaces the old one, so
+// readers see either the old or the new database, never half of it
+static bool write_database() {
+    char *temp_filepath = join_paths("%s.tmp", wodo_current_working_directory_db);
+    FILE *file = fopen(temp_filepath, "wb");
 
     if (file == NULL) {
-        fprintf(stderr, "could not open database file: %s\n", strerror(errno));
-        exit(1);
+        free(temp_filepath);
+
+        return false;
     }
 
     switch (global_database.version) {
@@ -89,7 +117,91 @@ static void database_save() {
         default: fprintf(stderr, "error: could not handle database version %d\n", global_database.version); exit(1);
     }
 
-    fclose(file);
+    // the new snapshot must be on the disk before it replaces the old one
+    bool ok = fflush(file) == 0 && !ferror(file) && fsync(fileno(file)) == 0;
+
+    ok = fclose(file) == 0 && ok && rename(temp_filepath, wodo_current_working_directory_db) == 0;
+
+    if (!ok) unlink(temp_filepath);
+
+    free(temp_filepath);
+
+    return ok;
+}
+
+static void database_save() {
+    if (batch_open) {
+        batch_dirty = true;
+
+        return;
+    }
+
+    if (!write_database()) {
+        fprintf(stderr, "could not save database file: %s\n", strerror(errno));
+        exit(1);
+    }
+}
+
+static size_t hash_filepath(const char *filepath) {
+    return (size_t)fnv1a(FNV1A_OFFSET_BASIS, filepath, strlen(filepath));
+}
+
+static void file_index_put(size_t file) {
+    size_t slot = hash_filepath(global_database.files[file]->view_absolute_filepath) & (file_index_capacity - 1);
+
+    while (file_index[slot] != 0) slot = (slot + 1) & (file_index_capacity - 1);
+
+    file_index[slot] = file + 1;
+    file_index_count++;
+}
+
+static void file_index_reset() {
+    free(file_index);
+
+    file_index = NULL;
+    file_index_capacity = 0;
+    file_index_count = 0;
+}
+
+static void file_index_build() {
+    size_t files_count = cl_arr_len(global_database.files);
+
+    file_index_reset();
+
+    file_index_capacity = 64;
+
+    while (file_index_capacity < files_count * 2) file_index_capacity *= 2;
+
+    file_index = calloc(file_index_capacity, sizeof(size_t));
+
+    for (size_t i = 0; i < files_count; i++) file_index_put(i);
+}
+
+// called right after a file is pushed to the database
+static void file_index_add_last() {
+    if (file_index == NULL) return;
+
+    if ((file_index_count + 1) * 2 > file_index_capacity) {
+        file_index_build();
+    } else {
+        file_index_put(cl_arr_len(global_database.files) - 1);
+    }
+}
+
+// removed files keep their slot, so the probing goes on until a free slot to
+// find a file that was added again with the same path
+static Database_File *file_index_find(const char *filepath) {
+    if (file_index == NULL) file_index_build();
+
+    size_t slot = hash_filepath(filepath) & (file_index_capacity - 1);
+
+    for (; file_index[slot] != 0; slot = (slot + 1) & (file_index_capacity - 1)) {
+        Database_File *it = global_database.files[file_index[slot] - 1];
+
+        if (!it->view_deleted && strcmp(it->view_absolute_filepath, filepath) == 0) return it;
+    }
+
+    return NULL;
 }
 
 bool has_repository_at(const char *base_path) {
@@ -99,6 +211,8 @@ bool has_repository_at(const char *base_path) {
 }
 
 database_status_code_t load_wodo_database_working_directory() {
+    TRACE_SCOPE("load_wodo_database_working_directory");
+
     char current_dir_buffer[FILENAME_MAX];
 
     if (GetCurrentDir(current_dir_buffer, sizeof(current_dir_buffer)) == NULL) {
@@ -328,6 +442,8 @@ database_status_code_t read_database(FILE *file) {
 }
 
 database_status_code_t database_load() {
+    TRACE_SCOPE("database_load");
+
     FILE *file = fopen(wodo_current_working_directory_db, "rb");
 
     if (file == NULL) {
@@ -335,6 +451,15 @@ database_status_code_t database_load() {
         exit(1);
     }
 
+    // writers never change an existing snapshot, they rename a new one over
+    // it, so this shared lock never waits on them and only marks the snapshot
+    // as being read
+    if (flock(fileno(file), LOCK_SH) != 0) {
+        fclose(file);
+
+        return DATABASE_ERRNO;
+    }
+
     char magic_bytes[6] = {0}; // .WODO\0
 
     if (fread(&magic_bytes, sizeof(char), 6, file) != 6) {
@@ -439,6 +564,51 @@ char *database_init(const char *base_path) {
     return wodo_current_working_directory;
 }
 
+database_status_code_t database_reload() {
+    file_index_reset();
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        free_db_file(global_database.files[i]);
+    }
+
+    cl_arr_free(global_database.files);
+
+    return database_load();
+}
+
+database_status_code_t database_lock_exclusive() {
+    TRACE_SCOPE("database_lock_exclusive");
+
+    if (lock_fd >= 0) return DATABASE_OK_STATUS_CODE;
+
+    char *lock_filepath = join_paths("%s/%s", wodo_current_working_directory, lock_filename);
+
+    lock_fd = open(lock_filepath, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+
+    free(lock_filepath);
+
+    if (lock_fd < 0) return DATABASE_ERRNO;
+
+    while (flock(lock_fd, LOCK_EX) != 0) {
+        if (errno == EINTR) continue;
+
+        close(lock_fd);
+        lock_fd = -1;
+
+        return DATABASE_ERRNO;
+    }
+
+    return DATABASE_OK_STATUS_CODE;
+}
+
+const char *database_folder() {
+    return wodo_current_working_directory;
+}
+
+const char *database_filepath() {
+    return wodo_current_working_directory_db;
+}
+
 void database_free() {
     if (wodo_current_working_directory != NULL) {
         free(wodo_current_working_directory);
@@ -454,43 +624,47 @@ void database_free() {
     };
 
     cl_arr_free(global_database.files);
+    file_index_reset();
+
+    if (lock_fd >= 0) {
+        close(lock_fd);
+        lock_fd = -1;
+    }
 }
 
 database_status_code_t database_get_file_by_filepath(Database_File **out, const char *filepath) {
-    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
-        Database_File *it = global_database.files[i];
+    Database_File *it = file_index_find(filepath);
 
-        if (it->view_deleted) continue;
-
-        if (strncmp(filepath, it->view_absolute_filepath, strlen(filepath)) == 0) {
-            if (out != NULL)
-                *out = it;
+    if (it == NULL) return DATABASE_NOT_FOUND_STATUS_CODE;
 
-            return DATABASE_OK_STATUS_CODE;
-        }
-    }
+    if (out != NULL) *out = it;
 
-    return DATABASE_NOT_FOUND_STATUS_CODE;
+    return DATABASE_OK_STATUS_CODE;
 }
 
 database_status_code_t database_add_file(char *name, char **out_absolute_filepath) {
-    Database_File_Path db_filepath = get_unix_filepath(name, strlen(name));
-
-    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
-        Database_File *it = global_database.files[i];
-
-        if (it->view_deleted) continue;
-
-        if (strncmp(db_filepath.absolute, it->view_absolute_filepath, strlen(it->view_absolute_filepath)) == 0) {
-            return DATABASE_CONFLICT_STATUS_CODE;
-        }
-    };
+    size_t name_size = strlen(name);
+    unsigned attempt = 0;
+    Database_File_Path db_filepath = get_unix_filepath(name, name_size, attempt);
+    int fd = -1;
+
+    // files with the same name added in the same second get a suffix
+    while (file_index_find(db_filepath.absolute) != NULL
+           || ((fd = open(db_filepath.absolute, O_WRONLY | O_CREAT | O_EXCL, 0666)) < 0 && errno == EEXIST)) {
+        free(db_filepath.absolute);
+        free(db_filepath.relative);
+
+        db_filepath = get_unix_filepath(name, name_size, ++attempt);
+    }
 
-    FILE* fd = fopen(db_filepath.absolute, "w");
+    if (fd < 0) {
+        free(db_filepath.absolute);
+        free(db_filepath.relative);
 
-    if (fd == NULL) return DATABASE_ERRNO;
+        return DATABASE_ERRNO;
+    }
 
-    fclose(fd);
+    close(fd);
 
     Database_File *file = malloc(sizeof(Database_File));
 
@@ -500,6 +674,7 @@ database_status_code_t database_add_file(char *name, char **out_absolute_filepat
     file->name = name;
 
     cl_arr_push(global_database.files, file);
+    file_index_add_last();
 
     if (out_absolute_filepath != NULL) {
         *out_absolute_filepath = file->view_absolute_filepath;
@@ -510,6 +685,30 @@ database_status_code_t database_add_file(char *name, char **out_absolute_filepat
     return DATABASE_OK_STATUS_CODE;
 }
 
+database_status_code_t database_adopt_file(char *name, const char *relative_filepath) {
+    char *absolute_filepath = join_paths("%s/%s", wodo_current_working_directory, relative_filepath);
+
+    if (file_index_find(absolute_filepath) != NULL) {
+        free(absolute_filepath);
+
+        return DATABASE_CONFLICT_STATUS_CODE;
+    }
+
+    Database_File *file = malloc(sizeof(Database_File));
+
+    file->view_absolute_filepath = absolute_filepath;
+    file->relative_filepath = strdup(relative_filepath);
+    file->view_deleted = false;
+    file->name = name;
+
+    cl_arr_push(global_database.files, file);
+    file_index_add_last();
+
+    database_save();
+
+    return DATABASE_OK_STATUS_CODE;
+}
+
 database_status_code_t database_delete_file(const char *absolute_filepath) {
     database_status_code_t status_code;
 
@@ -529,7 +728,9 @@ database_status_code_t database_delete_file(const char *absolute_filepath) {
 
     file->view_deleted = true;
 
-    if (remove(absolute_filepath) != 0) {
+    if (batch_open) {
+        cl_arr_push(batch_removed_files, strdup(file->view_absolute_filepath));
+    } else if (remove(absolute_filepath) != 0) {
         fprintf(stderr, "error: could not remove file from the system: %s\n", strerror(errno));
         exit(1);
     }
@@ -541,21 +742,46 @@ database_status_code_t database_delete_file(const char *absolute_filepath) {
 }
 
 database_status_code_t database_rename_file(const char *absolute_filepath, const char *name) {
-    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
-        Database_File *file = global_database.files[i];
+    Database_File *file = file_index_find(absolute_filepath);
+
+    if (file == NULL) return DATABASE_NOT_FOUND_STATUS_CODE;
 
-        if (strncmp(file->view_absolute_filepath, absolute_filepath, strlen(file->view_absolute_filepath)) == 0) {
-            size_t name_size = strlen(name);
+    // the new name can be longer than the old one
+    file->name = strdup(name);
+
+    database_save();
 
-            memcpy((void *)file->name, name, name_size);
+    return DATABASE_OK_STATUS_CODE;
+}
 
-            file->name[name_size] = '\0';
+void database_begin_batch() {
+    batch_open = true;
+    batch_dirty = false;
+}
 
-            database_save();
+database_status_code_t database_commit() {
+    batch_open = false;
 
-            return DATABASE_OK_STATUS_CODE;
+    if (batch_dirty && !write_database()) {
+        for (size_t i = 0; i < cl_arr_len(batch_removed_files); i++) free(batch_removed_files[i]);
+
+        cl_arr_free(batch_removed_files);
+
+        return DATABASE_ERRNO;
+    }
+
+    batch_dirty = false;
+
+    // the database doesn't point to them anymore, so it's safe to delete them now
+    for (size_t i = 0; i < cl_arr_len(batch_removed_files); i++) {
+        if (remove(batch_removed_files[i]) != 0 && errno != ENOENT) {
+            fprintf(stderr, "warning: could not remove file %s from the system: %s\n", batch_removed_files[i], strerror(errno));
         }
+
+        free(batch_removed_files[i]);
     }
 
-    return DATABASE_NOT_FOUND_STATUS_CODE;
+    cl_arr_free(batch_removed_files);
+
+    return DATABASE_OK_STATUS_CODE;
 }
@@ -49,18 +49,34 @@ extern Database global_database;
 database_status_code_t load_wodo_database_working_directory();
 // TODO: maybe in the future, do not load the entire database in memory
 database_status_code_t database_load();
+// frees the loaded files and reads the database file again
+database_status_code_t database_reload();
+// waits for the other writers and holds .wodo/.lock until `database_free` or
+// the process exits. Writers call it before `database_load` so what they change
+// is the latest database; readers never need it
+database_status_code_t database_lock_exclusive();
+// the .wodo folder of the current repository
+const char *database_folder();
+const char *database_filepath();
 char *database_init(const char *base_path);
 bool has_repository_at(const char *base_path);
 void database_free();
 database_status_code_t database_get_file_by_filepath(Database_File **out, const char *filepath);
 database_status_code_t database_add_file(char *name, char **out_absolute_filepath);
+// adds a file that is already in the .wodo folder, `name` is kept by the database
+database_status_code_t database_adopt_file(char *name, const char *relative_filepath);
 database_status_code_t database_delete_file(const char *absolute_filepath);
 database_status_code_t database_rename_file(const char *absolute_filepath, const char *name);
+// until `database_commit`, add, delete and rename only change the database in
+// memory and the deleted files stay in the disk
+void database_begin_batch();
+// writes the database once and deletes the files removed in the batch
+database_status_code_t database_commit();
 const char *database_status_code_string(database_status_code_t status_code);
 // this function returns a file path inside the data folder with 
 // a hash of the name suffixed with the current unix UTC timestamp
 // /path/to/data/folder/<name-hash>-unix.wodo
 // You need to free the memory of the return string when you're done
-/* Database_File_Path get_unix_filepath(const char *name, size_t name_size); */
+/* Database_File_Path get_unix_filepath(const char *name, size_t name_size, unsigned attempt); */
 
 #endif // _WODO_DATABASE_H_
@@ -1,4 +1,8 @@
 #include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include "date.h"
 
 static const int MAX_TIMEZONE_OFFSET = 14 * 60;
@@ -8,7 +12,7 @@ static int is_leap(int y) {
 }
 
 static int days_in_month(int y, int m) {
-    int days[] = {31,28,31,30,31,30,31,31,30,31,30,31};
+    static const int days[] = {31,28,31,30,31,30,31,31,30,31,30,31};
 
     if (m == 2 && is_leap(y))
         return 29;
@@ -50,7 +54,7 @@ static long long days_from_civil(int y, int m, int d)
     return era * 146097LL + (long long)doe - 719468LL;
 }
 
-static time_t datetime_to_timestamp(wodo_datetime_t dt)
+time_t datetime_to_timestamp(wodo_datetime_t dt)
 {
     long long days = days_from_civil(dt.year, dt.month, dt.day);
 
@@ -66,18 +70,54 @@ static time_t datetime_to_timestamp(wodo_datetime_t dt)
     return (time_t)seconds;
 }
 
-wodo_datetime_t convert_to_local(wodo_datetime_t dt)
+/* inverse of days_from_civil */
+static void civil_from_days(long long z, int *y, int *m, int *d)
 {
-    time_t t = datetime_to_timestamp(dt);
+    z += 719468;
+    long long era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    unsigned doy = doe - (365*yoe + yoe/4 - yoe/100);
+    unsigned mp = (5*doy + 2)/153;
+
+    *d = (int)(doy - (153*mp + 2)/5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = (int)(yoe + era * 400 + (*m <= 2));
+}
+
+wodo_datetime_t timestamp_to_utc_datetime(time_t timestamp)
+{
+    long long t = (long long)timestamp;
+    long long days = t >= 0 ? t / 86400 : (t - 86399) / 86400;
+    int seconds = (int)(t - days * 86400);
 
+    wodo_datetime_t result = {
+        .hour = seconds / 3600,
+        .minute = seconds / 60 % 60,
+        .second = seconds % 60,
+        .tz_offset = 0,
+    };
+
+    civil_from_days(days, &result.year, &result.month, &result.day);
+
+    return result;
+}
+
+static wodo_datetime_t convert_to_local_libc(time_t t)
+{
     struct tm local;
     localtime_r(&t, &local);
 
     struct tm gmt;
     gmtime_r(&t, &gmt);
 
-    int tz_offset =
-        (int)difftime(mktime(&local), mktime(&gmt)) / 60;
+    // mktime starts from the offset of its previous call, which decides the
+    // gmtime fields that fall in a gap or an overlap of the zone. `local` goes
+    // first so that offset is always the one of the period `t` is in
+    time_t local_time = mktime(&local);
+    time_t gmt_time = mktime(&gmt);
+
+    int tz_offset = (int)difftime(local_time, gmt_time) / 60;
 
     return (wodo_datetime_t){
         .year = local.tm_year + 1900,
@@ -89,3 +129,238 @@ wodo_datetime_t convert_to_local(wodo_datetime_t dt)
         .tz_offset = tz_offset
     };
 }
+
+/*
+ * Local zone table, read once from the TZif file libc itself would use.
+ *
+ * `tz_offset` from convert_to_local_libc is not the UTC offset at `t`:
+ * mktime() reads the gmtime fields with tm_isdst = 0, so it's the standard
+ * offset around `t` (the DST part is dropped). mktime starts from the offset
+ * of its previous call, so around a change of the standard offset it depends
+ * on the dates converted before. The table always takes it from the period
+ * `t` is in: its own offset, or in a DST period the one of the closest
+ * standard period, found in steps like mktime does.
+ */
+#define TZ_STANDARD_STRIDE 601200LL
+typedef struct {
+    long long start;    // first second of the period
+    int utoff;          // seconds east of UTC
+    bool is_dst;
+} tz_period_t;
+
+static struct {
+    bool loaded;
+    bool usable;
+    tz_period_t *periods;
+    size_t count;
+    // the last period also covers everything after it (no DST rule in the footer)
+    bool last_is_open;
+} local_zone;
+
+static long long read_be(const unsigned char *p, int size)
+{
+    unsigned long long value = 0;
+
+    for (int i = 0; i < size; i++) value = (value << 8) | p[i];
+
+    // sign extend
+    if (size < 8 && (value >> (size * 8 - 1)) & 1) value |= ~0ULL << (size * 8);
+
+    return (long long)value;
+}
+
+static char *read_zone_file(size_t *out_size)
+{
+    const char *tz = getenv("TZ");
+    char path[4096];
+
+    if (tz == NULL) {
+        snprintf(path, sizeof(path), "/etc/localtime");
+    } else {
+        if (*tz == ':') tz++;
+
+        // empty TZ is UTC, POSIX rules like "EST5EDT" are left to libc
+        if (*tz == '\0') return NULL;
+
+        if (*tz == '/') {
+            snprintf(path, sizeof(path), "%s", tz);
+        } else {
+            const char *tzdir = getenv("TZDIR");
+
+            snprintf(path, sizeof(path), "%s/%s", tzdir != NULL ? tzdir : "/usr/share/zoneinfo", tz);
+        }
+    }
+
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) return NULL;
+
+    size_t capacity = 4096, size = 0;
+    char *data = malloc(capacity);
+    size_t n;
+
+    while ((n = fread(data + size, 1, capacity - size, file)) > 0) {
+        size += n;
+
+        if (size == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+
+    fclose(file);
+
+    *out_size = size;
+
+    return data;
+}
+
+// only the 64-bit (version 2+) data block is used, like glibc does
+static bool parse_zone_file(const unsigned char *data, size_t size)
+{
+    if (size < 44 || memcmp(data, "TZif", 4) != 0 || data[4] < '2') return false;
+
+    long long counts[6];
+
+    for (int i = 0; i < 6; i++) counts[i] = read_be(data + 20 + i * 4, 4);
+
+    // skip the 32-bit block
+    size_t offset = 44 + counts[3] * 5 + counts[4] * 6 + counts[5] + counts[2] * 8 + counts[1] + counts[0];
+
+    if (offset + 44 > size || memcmp(data + offset, "TZif", 4) != 0) return false;
+
+    for (int i = 0; i < 6; i++) counts[i] = read_be(data + offset + 20 + i * 4, 4);
+
+    long long isutcnt = counts[0], isstdcnt = counts[1], leapcnt = counts[2];
+    long long timecnt = counts[3], typecnt = counts[4], charcnt = counts[5];
+
+    // leap seconds ("right/" zones) are left to libc
+    if (leapcnt != 0 || typecnt == 0) return false;
+
+    const unsigned char *times = data + offset + 44;
+    const unsigned char *indexes = times + timecnt * 8;
+    const unsigned char *types = indexes + timecnt;
+    const unsigned char *footer = types + typecnt * 6 + charcnt + isstdcnt + isutcnt;
+
+    if ((size_t)(footer - data) > size) return false;
+
+    // a footer with a DST rule means the table ends at the last transition
+    const unsigned char *end = data + size;
+    bool footer_has_rule = true;
+
+    if (footer < end && *footer == '\n') {
+        footer_has_rule = memchr(footer + 1, ',', end - footer - 1) != NULL;
+    }
+
+    size_t count = timecnt;
+
+    // zones without transitions (UTC) only have a type
+    if (count == 0) {
+        if (footer_has_rule || types[4]) return false;
+
+        count = 1;
+    }
+
+    tz_period_t *periods = malloc(sizeof(tz_period_t) * count);
+
+    for (size_t i = 0; i < count; i++) {
+        int type = timecnt == 0 ? 0 : indexes[i];
+
+        if (type >= typecnt) {
+            free(periods);
+
+            return false;
+        }
+
+        periods[i].start = timecnt == 0 ? LLONG_MIN : read_be(times + i * 8, 8);
+        periods[i].utoff = (int)read_be(types + type * 6, 4);
+        periods[i].is_dst = types[type * 6 + 4] != 0;
+    }
+
+    local_zone.periods = periods;
+    local_zone.count = count;
+    local_zone.last_is_open = !footer_has_rule;
+
+    return true;
+}
+
+static void load_local_zone(void)
+{
+    local_zone.loaded = true;
+
+    size_t size;
+    char *data = read_zone_file(&size);
+
+    if (data == NULL) return;
+
+    local_zone.usable = parse_zone_file((unsigned char *)data, size);
+
+    free(data);
+}
+
+// returns NULL when `t` is outside of the table or libc must be used
+static const tz_period_t *find_period(long long t)
+{
+    if (!local_zone.loaded) load_local_zone();
+
+    if (!local_zone.usable || t < local_zone.periods[0].start) return NULL;
+
+    size_t low = 0, high = local_zone.count;
+
+    // last period whose start is <= t
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+
+        if (local_zone.periods[middle].start <= t) low = middle;
+        else high = middle;
+    }
+
+    if (low + 1 == local_zone.count && !local_zone.last_is_open) return NULL;
+
+    return &local_zone.periods[low];
+}
+
+// minutes, the offset of `period` or, when it's a DST period, of the closest
+// standard period to `t`, the earlier one when both are as many steps away
+static int standard_offset(const tz_period_t *period, long long t)
+{
+    const tz_period_t *before = period, *after = period;
+    const tz_period_t *last = local_zone.periods + local_zone.count - 1;
+
+    while (before->is_dst && before > local_zone.periods) before--;
+    while (after->is_dst && after < last) after++;
+
+    if (before->is_dst && after->is_dst) return period->utoff / 60;
+    if (before->is_dst) return after->utoff / 60;
+    if (after->is_dst || before == period) return before->utoff / 60;
+
+    // steps to the last second of `before` and to the first one of `after`
+    long long back = (t - (before + 1)->start + TZ_STANDARD_STRIDE) / TZ_STANDARD_STRIDE;
+    long long forward = (after->start - t + TZ_STANDARD_STRIDE - 1) / TZ_STANDARD_STRIDE;
+
+    return (back <= forward ? before : after)->utoff / 60;
+}
+
+wodo_datetime_t convert_to_local(wodo_datetime_t dt)
+{
+    time_t t = datetime_to_timestamp(dt);
+
+    const tz_period_t *period = find_period(t);
+
+    if (period == NULL) return convert_to_local_libc(t);
+
+    long long local = (long long)t + period->utoff;
+    long long days = local >= 0 ? local / 86400 : (local - 86399) / 86400;
+    int seconds = (int)(local - days * 86400);
+
+    wodo_datetime_t result = {
+        .hour = seconds / 3600,
+        .minute = seconds / 60 % 60,
+        .second = seconds % 60,
+        .tz_offset = standard_offset(period, t),
+    };
+
+    civil_from_days(days, &result.year, &result.month, &result.day);
+
+    return result;
+}
@@ -6,5 +6,9 @@
 
 bool validate_datetime(wodo_datetime_t datetime);
 wodo_datetime_t convert_to_local(wodo_datetime_t datetime);
+// unix timestamp of the datetime, taking its own offset into account
+time_t datetime_to_timestamp(wodo_datetime_t datetime);
+// inverse of `datetime_to_timestamp` for the +00:00 offset
+wodo_datetime_t timestamp_to_utc_datetime(time_t timestamp);
 
 #endif // !_WODO_DATE_H_
@@ -0,0 +1,919 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "depends.h"
+#include "arr.h"
+#include "database.h"
+#include "io.h"
+#include "json.h"
+#include "parser.h"
+#include "taskid.h"
+#include "utils.h"
+#include "trace.h"
+
+/*
+ * .wodo/.depends-index layout (native endianness, like the database file):
+ *
+ *   Graph_Header
+ *   Graph_File * files_count, one per database file in the same order
+ *   Graph_Record * nodes_count
+ *   uint32_t * edges_count, the dependencies and then the dependents of
+ *     every node, as node indexes
+ *   char * strings_size, the titles of the nodes
+ *
+ * A file is only parsed again when its mtime or size changed, files with
+ * diagnostics are parsed every time so they are always reported. References
+ * are resolved with the names of the files, so the whole graph is built again
+ * when `files_hash` (the names and paths of the database files) changes.
+ */
+static const char *index_file_name = ".depends-index";
+static const char index_magic[8] = "WODODEP";
+
+#define DEPENDS_INDEX_VERSION 1
+// Graph_File.size of the files that have to be parsed again
+#define FILE_NOT_CACHED UINT64_MAX
+#define NO_NODE UINT32_MAX
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t files_count;
+    uint32_t nodes_count;
+    uint32_t edges_count;
+    uint64_t strings_size;
+    uint64_t files_hash;
+} Graph_Header;
+
+typedef struct {
+    int64_t mtime_sec, mtime_nsec;
+    uint64_t size;
+} Graph_File;
+
+typedef struct {
+    char id[TASK_ID_MAX_SIZE];
+    uint32_t file;
+    uint32_t pending;
+    uint32_t dependencies_count;
+    uint32_t dependents_count;
+    uint32_t title_start, title_length;
+    int32_t line;
+    uint8_t state;
+    uint8_t alive;
+    uint8_t in_cycle;
+    uint8_t padding;
+} Graph_Record;
+
+typedef struct {
+    char id[TASK_ID_MAX_SIZE];
+    // index of the database file
+    uint32_t file;
+    // dependencies that are in the repository and not done yet, the indegree
+    // of Kahn's algorithm: the task is actionable when it gets to 0
+    uint32_t pending;
+    // in `Graph.strings`
+    uint32_t title_start, title_length;
+    int32_t line;
+    wodo_task_state_t state;
+    // false for the ids that are only known because a task depends on them
+    bool alive;
+    bool in_cycle;
+    // seen in the file that is being updated
+    bool touched;
+    uint32_t *dependencies;     // node indexes, CL_ARRAY
+    uint32_t *dependents;       // node indexes, CL_ARRAY
+} Graph_Node;
+
+typedef struct {
+    Graph_Node *nodes;          // CL_ARRAY
+    // open addressing table of node index + 1 by file and id, 0 is free
+    uint32_t *slots;
+    size_t slots_capacity;
+    char *strings;
+    size_t strings_size, strings_capacity;
+    // a dependency list changed, so the cycles have to be found again
+    bool edges_changed;
+} Graph;
+
+// open addressing table of file index + 1 by name, the first file wins
+typedef struct {
+    uint32_t *slots;
+    size_t capacity;
+} File_Names;
+
+static inline bool is_done(wodo_task_state_t state) {
+    return state == Wodo_Task_State_Done;
+}
+
+static uint64_t node_hash(uint32_t file, const char *id) {
+    return fnv1a(fnv1a(FNV1A_OFFSET_BASIS, &file, sizeof(file)), id, strnlen(id, TASK_ID_MAX_SIZE));
+}
+
+static void slots_insert(Graph *graph, uint32_t node) {
+    const Graph_Node *it = &graph->nodes[node];
+    size_t slot = node_hash(it->file, it->id) & (graph->slots_capacity - 1);
+
+    while (graph->slots[slot] != 0) slot = (slot + 1) & (graph->slots_capacity - 1);
+
+    graph->slots[slot] = node + 1;
+}
+
+static void rebuild_slots(Graph *graph) {
+    size_t count = cl_arr_len(graph->nodes);
+
+    if (graph->slots_capacity == 0) graph->slots_capacity = 64;
+
+    while (graph->slots_capacity < count * 2) graph->slots_capacity *= 2;
+
+    free(graph->slots);
+    graph->slots = calloc(graph->slots_capacity, sizeof(uint32_t));
+
+    for (size_t i = 0; i < count; i++) slots_insert(graph, i);
+}
+
+static uint32_t find_node(const Graph *graph, uint32_t file, const char *id) {
+    if (graph->slots_capacity == 0) return NO_NODE;
+
+    size_t slot = node_hash(file, id) & (graph->slots_capacity - 1);
+
+    for (; graph->slots[slot] != 0; slot = (slot + 1) & (graph->slots_capacity - 1)) {
+        const Graph_Node *it = &graph->nodes[graph->slots[slot] - 1];
+
+        if (it->file == file && strncmp(it->id, id, TASK_ID_MAX_SIZE) == 0) return graph->slots[slot] - 1;
+    }
+
+    return NO_NODE;
+}
+
+// the new nodes are missing tasks until a file has them
+static uint32_t find_or_add_node(Graph *graph, uint32_t file, const char *id) {
+    uint32_t node = find_node(graph, file, id);
+
+    if (node != NO_NODE) return node;
+
+    Graph_Node it = { .file = file };
+
+    strncpy(it.id, id, TASK_ID_MAX_SIZE - 1);
+    cl_arr_push(graph->nodes, it);
+
+    node = cl_arr_len(graph->nodes) - 1;
+
+    if (cl_arr_len(graph->nodes) * 2 > graph->slots_capacity) {
+        rebuild_slots(graph);
+    } else {
+        slots_insert(graph, node);
+    }
+
+    return node;
+}
+
+static void set_title(Graph *graph, uint32_t node, wodo_string_t title) {
+    Graph_Node *it = &graph->nodes[node];
+
+    if (it->title_length == title.length && (title.length == 0 || memcmp(graph->strings + it->title_start, title.value, title.length) == 0)) return;
+
+    if (graph->strings_size + title.length > graph->strings_capacity) {
+        if (graph->strings_capacity == 0) graph->strings_capacity = 4096;
+
+        while (graph->strings_size + title.length > graph->strings_capacity) graph->strings_capacity *= 2;
+
+        graph->strings = realloc(graph->strings, graph->strings_capacity);
+    }
+
+    memcpy(graph->strings + graph->strings_size, title.value, title.length);
+
+    it->title_start = graph->strings_size;
+    it->title_length = title.length;
+    graph->strings_size += title.length;
+}
+
+static void free_graph(Graph *graph) {
+    for (size_t i = 0; i < cl_arr_len(graph->nodes); i++) {
+        cl_arr_free(graph->nodes[i].dependencies);
+        cl_arr_free(graph->nodes[i].dependents);
+    }
+
+    cl_arr_free(graph->nodes);
+    free(graph->slots);
+    free(graph->strings);
+
+    *graph = (Graph){0};
+}
+
+// a task blocks its dependents while it's in the repository and not done, so
+// only their counters change and only when that does
+static void set_node_state(Graph *graph, uint32_t node, bool alive, wodo_task_state_t state) {
+    Graph_Node *it = &graph->nodes[node];
+    bool was_blocking = it->alive && !is_done(it->state);
+    bool blocking = alive && !is_done(state);
+
+    it->alive = alive;
+    it->state = state;
+
+    if (was_blocking == blocking) return;
+
+    for (size_t i = 0; i < cl_arr_len(it->dependents); i++) {
+        Graph_Node *dependent = &graph->nodes[it->dependents[i]];
+
+        if (blocking) {
+            dependent->pending++;
+        } else {
+            dependent->pending--;
+        }
+    }
+}
+
+// `dependencies` is owned by the node from now on
+static void set_node_dependencies(Graph *graph, uint32_t node, uint32_t *dependencies) {
+    Graph_Node *it = &graph->nodes[node];
+    size_t count = cl_arr_len(dependencies);
+
+    if (count == cl_arr_len(it->dependencies) && (count == 0 || memcmp(dependencies, it->dependencies, count * sizeof(uint32_t)) == 0)) {
+        cl_arr_free(dependencies);
+
+        return;
+    }
+
+    for (size_t i = 0; i < cl_arr_len(it->dependencies); i++) {
+        uint32_t *dependents = graph->nodes[it->dependencies[i]].dependents;
+
+        for (size_t j = 0; j < cl_arr_len(dependents); j++) {
+            if (dependents[j] == node) {
+                cl_arr_u_remove(dependents, j);
+
+                break;
+            }
+        }
+    }
+
+    cl_arr_free(it->dependencies);
+
+    it->dependencies = dependencies;
+    it->pending = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        Graph_Node *dependency = &graph->nodes[dependencies[i]];
+
+        cl_arr_push(dependency->dependents, node);
+
+        if (dependency->alive && !is_done(dependency->state)) it->pending++;
+    }
+
+    graph->edges_changed = true;
+}
+
+static uint64_t name_hash(const char *name, size_t length) {
+    return fnv1a(FNV1A_OFFSET_BASIS, name, length);
+}
+
+static File_Names index_file_names(void) {
+    size_t count = cl_arr_len(global_database.files);
+    File_Names names = { .capacity = 64 };
+
+    while (names.capacity < count * 2) names.capacity *= 2;
+
+    names.slots = calloc(names.capacity, sizeof(uint32_t));
+
+    for (size_t i = 0; i < count; i++) {
+        const char *name = global_database.files[i]->name;
+        size_t slot = name_hash(name, strlen(name)) & (names.capacity - 1);
+        bool found = false;
+
+        for (; names.slots[slot] != 0; slot = (slot + 1) & (names.capacity - 1)) {
+            if (strcmp(global_database.files[names.slots[slot] - 1]->name, name) == 0) {
+                found = true;
+
+                break;
+            }
+        }
+
+        if (!found) names.slots[slot] = i + 1;
+    }
+
+    return names;
+}
+
+static uint32_t find_file_by_name(const File_Names *names, const char *name, size_t length) {
+    size_t slot = name_hash(name, length) & (names->capacity - 1);
+
+    for (; names->slots[slot] != 0; slot = (slot + 1) & (names->capacity - 1)) {
+        const char *it = global_database.files[names->slots[slot] - 1]->name;
+
+        if (cmp_sized_strings(it, name, strlen(it), length)) return names->slots[slot] - 1;
+    }
+
+    return NO_NODE;
+}
+
+static inline bool is_hex_digit(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+}
+
+// "a1b2c3d" or "a1b2c3d-2", see taskid.h
+static bool is_task_id(const char *id, size_t length) {
+    if (length < 7 || length >= TASK_ID_MAX_SIZE) return false;
+
+    for (size_t i = 0; i < 7; i++) {
+        if (!is_hex_digit(id[i])) return false;
+    }
+
+    if (length == 7) return true;
+
+    if (id[7] != '-' || length == 8 || id[8] == '0') return false;
+
+    for (size_t i = 8; i < length; i++) {
+        if (id[i] < '0' || id[i] > '9') return false;
+    }
+
+    return true;
+}
+
+// "<id>" is a task of `file` and "<name>:<id>" a task of the file called
+// <name>. The invalid ones are reported and left out
+static uint32_t *resolve_dependencies(Graph *graph, uint32_t file, wodo_task_t task, const File_Names *names, wodo_diagnostic_t **diagnostics) {
+    const char *filepath = global_database.files[file]->view_absolute_filepath;
+    wodo_node_t *depends = task.depends_property.node_array;
+    uint32_t *dependencies = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(depends); i++) {
+        wodo_string_t reference = depends[i].string;
+        const char *separator = NULL;
+
+        for (size_t j = reference.length; j > 0; j--) {
+            if (reference.value[j - 1] == ':') {
+                separator = &reference.value[j - 1];
+
+                break;
+            }
+        }
+
+        uint32_t target = file;
+        const char *id = reference.value;
+        size_t id_length = reference.length;
+
+        if (separator != NULL) {
+            target = find_file_by_name(names, reference.value, separator - reference.value);
+            id = separator + 1;
+            id_length = reference.value + reference.length - id;
+
+            if (target == NO_NODE) {
+                push_diagnostic(diagnostics, filepath, depends[i].location, Wodo_Diagnostic_Warning, "unknown file '%.*s' in dependency '%.*s'", (int)(separator - reference.value), reference.value, (int)reference.length, reference.value);
+
+                continue;
+            }
+        }
+
+        if (!is_task_id(id, id_length)) {
+            push_diagnostic(diagnostics, filepath, depends[i].location, Wodo_Diagnostic_Warning, "invalid task id '%.*s' in dependency '%.*s'", (int)id_length, id, (int)reference.length, reference.value);
+
+            continue;
+        }
+
+        char key[TASK_ID_MAX_SIZE] = {0};
+
+        memcpy(key, id, id_length);
+
+        uint32_t node = find_or_add_node(graph, target, key);
+        bool repeated = false;
+
+        for (size_t j = 0; j < cl_arr_len(dependencies) && !repeated; j++) repeated = dependencies[j] == node;
+
+        if (!repeated) cl_arr_push(dependencies, node);
+    }
+
+    return dependencies;
+}
+
+static wodo_string_t trimmed_title(wodo_task_t task) {
+    wodo_string_t title = task.title.string;
+
+    while (title.length > 0 && (title.value[0] == ' ' || title.value[0] == '\t')) {
+        title.value++;
+        title.length--;
+    }
+
+    while (title.length > 0 && (title.value[title.length - 1] == ' ' || title.value[title.length - 1] == '\t' || title.value[title.length - 1] == '\r')) title.length--;
+
+    return title;
+}
+
+// applies the tasks of `file` to the graph, `old_nodes` are the tasks it had.
+// Only the counters of the dependents of the tasks that appeared, disappeared
+// or changed between done and not done are touched
+static void update_file(Graph *graph, uint32_t file, uint32_t *old_nodes, wodo_task_t *tasks, const File_Names *names, wodo_diagnostic_t **diagnostics) {
+    Task_Id *ids = compute_task_ids(tasks);
+    uint32_t *new_nodes = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        uint32_t node = find_or_add_node(graph, file, ids[i].value);
+        uint32_t *dependencies = resolve_dependencies(graph, file, tasks[i], names, diagnostics);
+
+        graph->nodes[node].line = tasks[i].title.location.line;
+        graph->nodes[node].touched = true;
+
+        set_title(graph, node, trimmed_title(tasks[i]));
+        set_node_state(graph, node, true, tasks[i].state_property.state);
+        set_node_dependencies(graph, node, dependencies);
+
+        cl_arr_push(new_nodes, node);
+    }
+
+    // the tasks that are gone stay as missing ones while anything depends on them
+    for (size_t i = 0; i < cl_arr_len(old_nodes); i++) {
+        if (graph->nodes[old_nodes[i]].touched) continue;
+
+        set_node_dependencies(graph, old_nodes[i], CL_ARRAY_INIT);
+        set_node_state(graph, old_nodes[i], false, graph->nodes[old_nodes[i]].state);
+
+        graph->nodes[old_nodes[i]].line = 0;
+        graph->nodes[old_nodes[i]].title_length = 0;
+    }
+
+    for (size_t i = 0; i < cl_arr_len(new_nodes); i++) graph->nodes[new_nodes[i]].touched = false;
+
+    cl_arr_free(new_nodes);
+    cl_arr_free(ids);
+}
+
+// Kahn's algorithm over the edges, without looking at the states: the nodes
+// that never get to indegree 0 are in a cycle or depend on one. The ones that
+// only depend on a cycle are peeled off from the other side, so what is left
+// are the tasks of the cycles
+static void find_cycles(Graph *graph) {
+    TRACE_SCOPE("find_cycles");
+
+    size_t count = cl_arr_len(graph->nodes);
+    uint32_t *degrees = malloc((count + 1) * sizeof(uint32_t));
+    uint32_t *queue = malloc((count + 1) * sizeof(uint32_t));
+    size_t head = 0, tail = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        degrees[i] = cl_arr_len(graph->nodes[i].dependencies);
+
+        if (degrees[i] == 0) queue[tail++] = i;
+    }
+
+    while (head < tail) {
+        Graph_Node *it = &graph->nodes[queue[head++]];
+
+        for (size_t i = 0; i < cl_arr_len(it->dependents); i++) {
+            if (--degrees[it->dependents[i]] == 0) queue[tail++] = it->dependents[i];
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) graph->nodes[i].in_cycle = degrees[i] > 0;
+
+    head = tail = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        Graph_Node *it = &graph->nodes[i];
+
+        if (!it->in_cycle) continue;
+
+        degrees[i] = 0;
+
+        for (size_t j = 0; j < cl_arr_len(it->dependents); j++) {
+            if (graph->nodes[it->dependents[j]].in_cycle) degrees[i]++;
+        }
+
+        if (degrees[i] == 0) queue[tail++] = i;
+    }
+
+    while (head < tail) {
+        Graph_Node *it = &graph->nodes[queue[head++]];
+
+        it->in_cycle = false;
+
+        for (size_t i = 0; i < cl_arr_len(it->dependencies); i++) {
+            uint32_t dependency = it->dependencies[i];
+
+            if (graph->nodes[dependency].in_cycle && --degrees[dependency] == 0) queue[tail++] = dependency;
+        }
+    }
+
+    free(degrees);
+    free(queue);
+}
+
+static char *index_path(void) {
+    return join_paths("%s/%s", database_folder(), index_file_name);
+}
+
+static uint64_t database_files_hash(void) {
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        const Database_File *it = global_database.files[i];
+
+        // with the terminators, so "ab" "c" and "a" "bc" are different
+        hash = fnv1a(hash, it->name, strlen(it->name) + 1);
+        hash = fnv1a(hash, it->relative_filepath, strlen(it->relative_filepath) + 1);
+    }
+
+    return hash;
+}
+
+// reads the graph and the state of the files it was built from. A missing,
+// broken or outdated index leaves both empty, so every file is parsed
+static void read_index(Graph *graph, Graph_File *files, uint64_t files_hash) {
+    TRACE_SCOPE("read_index");
+
+    size_t files_count = cl_arr_len(global_database.files);
+    char *path = index_path();
+    char *content;
+    size_t length;
+
+    if (!read_from_file_no_quit(path, &content, &length)) {
+        free(path);
+
+        return;
+    }
+
+    free(path);
+
+    Graph_Header header;
+    bool valid = length >= sizeof(header);
+
+    if (valid) {
+        memcpy(&header, content, sizeof(header));
+
+        valid = memcmp(header.magic, index_magic, sizeof(index_magic)) == 0
+            && header.version == DEPENDS_INDEX_VERSION
+            && header.files_hash == files_hash
+            && header.files_count == files_count
+            && length == sizeof(header) + header.files_count * sizeof(Graph_File) + (uint64_t)header.nodes_count * sizeof(Graph_Record)
+                + (uint64_t)header.edges_count * sizeof(uint32_t) + header.strings_size;
+    }
+
+    if (!valid) {
+        free(content);
+
+        return;
+    }
+
+    const char *files_at = content + sizeof(header);
+    const char *records_at = files_at + header.files_count * sizeof(Graph_File);
+    const char *edges_at = records_at + (size_t)header.nodes_count * sizeof(Graph_Record);
+    const char *strings_at = edges_at + (size_t)header.edges_count * sizeof(uint32_t);
+    size_t edge = 0;
+
+    for (uint32_t i = 0; i < header.nodes_count && valid; i++) {
+        Graph_Record record;
+
+        memcpy(&record, records_at + i * sizeof(Graph_Record), sizeof(record));
+
+        Graph_Node it = {
+            .file = record.file,
+            .pending = record.pending,
+            .title_start = record.title_start,
+            .title_length = record.title_length,
+            .line = record.line,
+            .state = record.state,
+            .alive = record.alive,
+            .in_cycle = record.in_cycle,
+        };
+
+        memcpy(it.id, record.id, TASK_ID_MAX_SIZE);
+        it.id[TASK_ID_MAX_SIZE - 1] = '\0';
+
+        valid = it.file < files_count && it.state <= Wodo_Task_State_Done
+            && (uint64_t)it.title_start + it.title_length <= header.strings_size
+            && edge + (uint64_t)record.dependencies_count + record.dependents_count <= header.edges_count;
+
+        for (uint32_t j = 0; valid && j < record.dependencies_count + record.dependents_count; j++) {
+            uint32_t node;
+
+            memcpy(&node, edges_at + (edge++) * sizeof(uint32_t), sizeof(node));
+
+            valid = node < header.nodes_count;
+
+            if (j < record.dependencies_count) {
+                cl_arr_push(it.dependencies, node);
+            } else {
+                cl_arr_push(it.dependents, node);
+            }
+        }
+
+        cl_arr_push(graph->nodes, it);
+    }
+
+    if (valid) {
+        memcpy(files, files_at, files_count * sizeof(Graph_File));
+
+        graph->strings_size = graph->strings_capacity = header.strings_size;
+        graph->strings = malloc(header.strings_size + 1);
+
+        memcpy(graph->strings, strings_at, header.strings_size);
+    } else {
+        free_graph(graph);
+    }
+
+    free(content);
+}
+
+// the missing tasks that nothing depends on anymore are dropped and the
+// titles are packed again
+static bool write_index(const Graph *graph, const Graph_File *files, uint64_t files_hash) {
+    TRACE_SCOPE("write_index");
+
+    size_t files_count = cl_arr_len(global_database.files);
+    size_t count = cl_arr_len(graph->nodes);
+    uint32_t *remap = malloc((count + 1) * sizeof(uint32_t));
+    Graph_Header header = {
+        .version = DEPENDS_INDEX_VERSION,
+        .files_count = files_count,
+        .files_hash = files_hash,
+    };
+
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+
+    for (size_t i = 0; i < count; i++) {
+        const Graph_Node *it = &graph->nodes[i];
+
+        if (!it->alive && cl_arr_len(it->dependents) == 0) {
+            remap[i] = NO_NODE;
+
+            continue;
+        }
+
+        remap[i] = header.nodes_count++;
+        header.edges_count += cl_arr_len(it->dependencies) + cl_arr_len(it->dependents);
+        header.strings_size += it->title_length;
+    }
+
+    size_t length = sizeof(header) + files_count * sizeof(Graph_File) + (size_t)header.nodes_count * sizeof(Graph_Record)
+        + (size_t)header.edges_count * sizeof(uint32_t) + header.strings_size;
+    char *content = malloc(length);
+    char *files_at = content + sizeof(header);
+    char *records_at = files_at + files_count * sizeof(Graph_File);
+    char *edges_at = records_at + (size_t)header.nodes_count * sizeof(Graph_Record);
+    char *strings_at = edges_at + (size_t)header.edges_count * sizeof(uint32_t);
+    uint32_t title_start = 0;
+
+    memcpy(content, &header, sizeof(header));
+    if (files_count > 0) memcpy(files_at, files, files_count * sizeof(Graph_File));
+
+    for (size_t i = 0; i < count; i++) {
+        const Graph_Node *it = &graph->nodes[i];
+
+        if (remap[i] == NO_NODE) continue;
+
+        Graph_Record record = {
+            .file = it->file,
+            .pending = it->pending,
+            .dependencies_count = cl_arr_len(it->dependencies),
+            .dependents_count = cl_arr_len(it->dependents),
+            .title_start = title_start,
+            .title_length = it->title_length,
+            .line = it->line,
+            .state = it->state,
+            .alive = it->alive,
+            .in_cycle = it->in_cycle,
+        };
+
+        memcpy(record.id, it->id, TASK_ID_MAX_SIZE);
+        memcpy(records_at, &record, sizeof(record));
+        records_at += sizeof(record);
+
+        // a dropped node has no dependencies, so every edge is kept
+        for (size_t j = 0; j < cl_arr_len(it->dependencies); j++) {
+            memcpy(edges_at, &remap[it->dependencies[j]], sizeof(uint32_t));
+            edges_at += sizeof(uint32_t);
+        }
+
+        for (size_t j = 0; j < cl_arr_len(it->dependents); j++) {
+            memcpy(edges_at, &remap[it->dependents[j]], sizeof(uint32_t));
+            edges_at += sizeof(uint32_t);
+        }
+
+        if (it->title_length > 0) memcpy(strings_at + title_start, graph->strings + it->title_start, it->title_length);
+
+        title_start += it->title_length;
+    }
+
+    char *path = index_path();
+    bool ok = write_file_atomically(path, content, length);
+
+    free(path);
+    free(content);
+    free(remap);
+
+    return ok;
+}
+
+static inline bool same_file(const Graph_File *file, const struct stat *st) {
+    return file->size == (uint64_t)st->st_size && file->mtime_sec == st->st_mtim.tv_sec && file->mtime_nsec == st->st_mtim.tv_nsec;
+}
+
+static const char *state_name(wodo_task_state_t state) {
+    switch (state) {
+        case Wodo_Task_State_Todo: return "todo";
+        case Wodo_Task_State_Doing: return "doing";
+        case Wodo_Task_State_Blocked: return "blocked";
+        case Wodo_Task_State_Done: return "done";
+        default: assert(0 && "unhandled task state");
+    }
+
+    return NULL;
+}
+
+static void print_node(const Graph *graph, const Graph_Node *node) {
+    const Database_File *file = global_database.files[node->file];
+
+    printf("{\"name\":");
+    print_scaped_string_to_fd((wodo_string_t){ .value = file->name, .length = strlen(file->name) }, stdout);
+    printf(",\"path\":");
+    print_scaped_string_to_fd((wodo_string_t){ .value = file->view_absolute_filepath, .length = strlen(file->view_absolute_filepath) }, stdout);
+    printf(",\"id\":\"%s\"", node->id);
+
+    if (node->alive) {
+        printf(",\"title\":");
+        print_scaped_string_to_fd((wodo_string_t){ .value = graph->strings + node->title_start, .length = node->title_length }, stdout);
+        printf(",\"state\":\"%s\",\"line\":%d", state_name(node->state), node->line);
+    }
+
+    printf("}");
+}
+
+// database order
+static int compare_nodes(const void *a, const void *b) {
+    const Graph_Node *x = *(const Graph_Node *const *)a;
+    const Graph_Node *y = *(const Graph_Node *const *)b;
+
+    if (x->file != y->file) return x->file < y->file ? -1 : 1;
+    if (x->line != y->line) return x->line < y->line ? -1 : 1;
+
+    return strncmp(x->id, y->id, TASK_ID_MAX_SIZE);
+}
+
+static void sort_nodes(const Graph_Node **nodes) {
+    if (cl_arr_len(nodes) > 0) qsort(nodes, cl_arr_len(nodes), sizeof(Graph_Node *), compare_nodes);
+}
+
+// the first `count` nodes
+static void print_nodes(const Graph *graph, const Graph_Node **nodes, size_t count) {
+    printf("[");
+
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) printf(",");
+
+        print_node(graph, nodes[i]);
+    }
+
+    printf("]");
+}
+
+int next_action(Flags flags) {
+    TRACE_SCOPE("next");
+
+    size_t files_count = cl_arr_len(global_database.files);
+    uint64_t files_hash = database_files_hash();
+    Graph graph = {0};
+    Graph_File *files = calloc(files_count + 1, sizeof(Graph_File));
+    bool *changed = calloc(files_count + 1, sizeof(bool));
+    bool index_changed = false;
+
+    read_index(&graph, files, files_hash);
+
+    TRACE_BEGIN("stat");
+
+    for (size_t i = 0; i < files_count; i++) {
+        struct stat st;
+
+        changed[i] = stat(global_database.files[i]->view_absolute_filepath, &st) != 0 || !same_file(&files[i], &st);
+        index_changed |= changed[i];
+    }
+
+    TRACE_END();
+
+    // the old tasks of the changed files, in one pass over the nodes
+    uint32_t **old_nodes = calloc(files_count + 1, sizeof(uint32_t *));
+
+    for (size_t i = 0; index_changed && i < cl_arr_len(graph.nodes); i++) {
+        if (graph.nodes[i].alive && changed[graph.nodes[i].file]) cl_arr_push(old_nodes[graph.nodes[i].file], i);
+    }
+
+    // the lookups are only needed to apply the changes
+    if (index_changed) rebuild_slots(&graph);
+
+    File_Names names = index_file_names();
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+    // only the titles and the dependencies are needed
+    set_parser_options((wodo_parser_options_t){ .skip_tags = true, .skip_description = true });
+
+    for (size_t i = 0; i < files_count; i++) {
+        if (!changed[i]) continue;
+
+        Database_File *it = global_database.files[i];
+
+        TRACE_BEGIN_ARG("file", it->view_absolute_filepath);
+
+        struct stat st = {0};
+        char *content = NULL;
+        size_t length = 0;
+        wodo_task_t *tasks = CL_ARRAY_INIT;
+        size_t diagnostics_count = cl_arr_len(diagnostics);
+
+        // a file that can't be read has no tasks until it can
+        if (stat(it->view_absolute_filepath, &st) != 0 || !read_from_file_no_quit(it->view_absolute_filepath, &content, &length)) {
+            push_diagnostic(&diagnostics, it->view_absolute_filepath, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+        } else {
+            reset_parser_state();
+
+            tasks = parse_tasks_recovering(it->view_absolute_filepath, content, length, &diagnostics);
+        }
+
+        update_file(&graph, i, old_nodes[i], tasks, &names, &diagnostics);
+
+        files[i] = (Graph_File){
+            .mtime_sec = st.st_mtim.tv_sec,
+            .mtime_nsec = st.st_mtim.tv_nsec,
+            .size = cl_arr_len(diagnostics) == diagnostics_count ? (uint64_t)st.st_size : FILE_NOT_CACHED,
+        };
+
+        free_tasks(tasks);
+        cl_arr_free(old_nodes[i]);
+        free(content);
+
+        TRACE_END();
+    }
+
+    // a state change can't make or break a cycle
+    if (graph.edges_changed) find_cycles(&graph);
+
+    if (index_changed && !write_index(&graph, files, files_hash)) {
+        fprintf(stderr, "warning: could not write the dependency index: %s\n", strerror(errno));
+    }
+
+    TRACE_BEGIN("query");
+
+    const Graph_Node **actionable = CL_ARRAY_INIT;
+    const Graph_Node **cycles = CL_ARRAY_INIT;
+    const Graph_Node **missing = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(graph.nodes); i++) {
+        const Graph_Node *it = &graph.nodes[i];
+
+        if (!it->alive) {
+            if (cl_arr_len(it->dependents) > 0) cl_arr_push(missing, it);
+        } else if (it->in_cycle) {
+            cl_arr_push(cycles, it);
+        } else if (!is_done(it->state) && it->pending == 0) {
+            cl_arr_push(actionable, it);
+        }
+    }
+
+    sort_nodes(actionable);
+    sort_nodes(cycles);
+    sort_nodes(missing);
+
+    TRACE_END();
+
+    size_t actionable_count = cl_arr_len(actionable);
+
+    if (flags.limit > 0 && actionable_count > (size_t)flags.limit) actionable_count = flags.limit;
+
+    printf("{\"tasks\":");
+    print_nodes(&graph, actionable, actionable_count);
+    printf(",\"cycles\":");
+    print_nodes(&graph, cycles, cl_arr_len(cycles));
+    printf(",\"missing\":[");
+
+    for (size_t i = 0; i < cl_arr_len(missing); i++) {
+        const Graph_Node **dependents = CL_ARRAY_INIT;
+
+        for (size_t j = 0; j < cl_arr_len(missing[i]->dependents); j++) cl_arr_push(dependents, &graph.nodes[missing[i]->dependents[j]]);
+
+        sort_nodes(dependents);
+
+        if (i > 0) printf(",");
+
+        printf("{\"task\":");
+        print_node(&graph, missing[i]);
+        printf(",\"dependents\":");
+        print_nodes(&graph, dependents, cl_arr_len(dependents));
+        printf("}");
+
+        cl_arr_free(dependents);
+    }
+
+    printf("],\"diagnostics\":");
+    print_diagnostics_to_stdout_as_json(diagnostics);
+    printf("}\n");
+
+    cl_arr_free(actionable);
+    cl_arr_free(cycles);
+    cl_arr_free(missing);
+    free_diagnostics(&diagnostics);
+    free(names.slots);
+    free(old_nodes);
+    free(changed);
+    free(files);
+    free_graph(&graph);
+
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef _WODO_DEPENDS_H_
+#define _WODO_DEPENDS_H_
+
+#include "argparser.h"
+
+// `wodo next [--limit <n>]`
+//
+// outputs the tasks that are not done and whose `.depends` tasks are all done:
+// {"tasks":[...],"cycles":[...],"missing":[...],"diagnostics":[]}
+//
+// a dependency is the id of a task of the same file ("a1b2c3d") or of the
+// file with that name ("backend:a1b2c3d"). The graph of the repository is kept
+// in .wodo/.depends-index with a counter of the unfinished dependencies of
+// every task, only the files that changed since the last run are parsed again
+// and only the counters of the tasks depending on what changed are updated.
+// "cycles" are the tasks that depend on themselves through other tasks and
+// "missing" are the ids that no task has, with the tasks depending on them.
+int next_action(Flags flags);
+
+#endif // !_WODO_DEPENDS_H_
@@ -0,0 +1,488 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "diff.h"
+#include "arr.h"
+#include "date.h"
+#include "io.h"
+#include "parser.h"
+#include "properties.h"
+#include "utils.h"
+#include "visualizer.h"
+#include "trace.h"
+
+typedef struct {
+    const char *filepath;
+    char *content;
+    wodo_task_t *tasks;
+    wodo_diagnostic_t *diagnostics;
+    uint64_t *title_hashes;
+    uint64_t *hashes;           // of every canonical field
+    // the task of the other version it was matched with, -1 when there is none
+    long *matches;
+} Diff_Side;
+
+typedef enum {
+    DE_ADD,
+    DE_REMOVE,
+    DE_MODIFY,
+    DE_MOVE,
+} Diff_Event_Kind;
+
+static const char *event_names[] = { "add", "remove", "modify", "move" };
+static const char *state_names[] = { "todo", "doing", "blocked", "done" };
+
+static wodo_string_t trim(wodo_string_t string) {
+    while (string.length > 0 && (*string.value == ' ' || *string.value == '\t' || *string.value == '\n')) {
+        string.value++;
+        string.length--;
+    }
+
+    while (string.length > 0) {
+        char c = string.value[string.length - 1];
+
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+
+        string.length--;
+    }
+
+    return string;
+}
+
+static uint64_t hash_string(uint64_t hash, wodo_string_t string) {
+    string = trim(string);
+
+    // the size keeps "ab" + "c" apart from "a" + "bc"
+    hash = fnv1a(hash, &string.length, sizeof(string.length));
+
+    return string.length == 0 ? hash : fnv1a(hash, string.value, string.length);
+}
+
+// same hash when the formatter would write the same task, dates are
+// compared as instants so a different offset for the same time is no change
+static uint64_t hash_task(wodo_task_t task) {
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+    time_t date = datetime_to_timestamp(task.date_property.datetime);
+    uint32_t state = task.state_property.state;
+    uint8_t remind = task.remind_property.boolean;
+
+    hash = hash_string(hash, task.title.string);
+    hash = fnv1a(hash, &state, sizeof(state));
+    hash = fnv1a(hash, &date, sizeof(date));
+    hash = fnv1a(hash, &remind, sizeof(remind));
+
+    for (size_t i = 0; i < cl_arr_len(task.tags_property.node_array); i++) {
+        hash = hash_string(hash, task.tags_property.node_array[i].string);
+    }
+
+    // the count keeps a tag moved to the ids apart
+    size_t depends_count = cl_arr_len(task.depends_property.node_array);
+
+    hash = fnv1a(hash, &depends_count, sizeof(depends_count));
+
+    for (size_t i = 0; i < cl_arr_len(task.depends_property.node_array); i++) {
+        hash = hash_string(hash, task.depends_property.node_array[i].string);
+    }
+
+    // the values are sorted by property, so the same ones hash the same
+    for (size_t i = 0; i < task.properties_count; i++) {
+        hash = fnv1a(hash, &task.properties[i].property, sizeof(task.properties[i].property));
+        hash = fnv1a(hash, &task.properties[i].value, sizeof(task.properties[i].value));
+    }
+
+    return hash_string(hash, task.description.string);
+}
+
+static bool read_side(Diff_Side *side, const char *filepath) {
+    size_t length;
+
+    side->filepath = filepath;
+
+    if (strcmp(filepath, "-") == 0) {
+        length = read_from_stdin(&side->content);
+    } else if (!read_from_file_no_quit(filepath, &side->content, &length)) {
+        fprintf(stderr, "error: could not read %s: %s\n", filepath, strerror(errno));
+
+        return false;
+    }
+
+    side->diagnostics = CL_ARRAY_INIT;
+    side->title_hashes = CL_ARRAY_INIT;
+    side->hashes = CL_ARRAY_INIT;
+    side->matches = CL_ARRAY_INIT;
+
+    reset_parser_state();
+
+    side->tasks = parse_tasks_recovering(filepath, side->content, length, &side->diagnostics);
+
+    for (size_t i = 0; i < cl_arr_len(side->tasks); i++) {
+        cl_arr_push(side->title_hashes, hash_string(FNV1A_OFFSET_BASIS, side->tasks[i].title.string));
+        cl_arr_push(side->hashes, hash_task(side->tasks[i]));
+        cl_arr_push(side->matches, -1);
+    }
+
+    return true;
+}
+
+static void free_side(Diff_Side *side) {
+    free_tasks(side->tasks);
+    free_diagnostics(&side->diagnostics);
+    cl_arr_free(side->title_hashes);
+    cl_arr_free(side->hashes);
+    cl_arr_free(side->matches);
+    free(side->content);
+}
+
+static bool same_title(const wodo_task_t *a, const wodo_task_t *b) {
+    wodo_string_t x = trim(a->title.string);
+    wodo_string_t y = trim(b->title.string);
+
+    return x.length == y.length && memcmp(x.value, y.value, x.length) == 0;
+}
+
+// pairs the n-th task with a title in the old version with the n-th task
+// with the same title in the new one. The open addressing table maps every
+// title to its first old task and to the next one that is not matched yet
+static void match_titles(Diff_Side *old, Diff_Side *new) {
+    size_t old_count = cl_arr_len(old->tasks);
+    size_t capacity = 16;
+
+    while (capacity < old_count * 2) capacity *= 2;
+
+    long *keys = malloc(sizeof(long) * capacity);
+    long *heads = malloc(sizeof(long) * capacity);
+    long *tails = malloc(sizeof(long) * capacity);
+    // next old task with the same title
+    long *next = malloc(sizeof(long) * (old_count + 1));
+
+    for (size_t i = 0; i < capacity; i++) keys[i] = -1;
+
+    for (size_t i = 0; i < old_count; i++) {
+        size_t slot = old->title_hashes[i] & (capacity - 1);
+
+        while (keys[slot] >= 0 && !(old->title_hashes[keys[slot]] == old->title_hashes[i] && same_title(&old->tasks[keys[slot]], &old->tasks[i]))) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+
+        next[i] = -1;
+
+        if (keys[slot] < 0) {
+            keys[slot] = heads[slot] = (long)i;
+        } else {
+            next[tails[slot]] = (long)i;
+        }
+
+        tails[slot] = (long)i;
+    }
+
+    for (size_t i = 0; i < cl_arr_len(new->tasks); i++) {
+        size_t slot = new->title_hashes[i] & (capacity - 1);
+
+        while (keys[slot] >= 0) {
+            long key = keys[slot];
+
+            if (old->title_hashes[key] == new->title_hashes[i] && same_title(&old->tasks[key], &new->tasks[i])) {
+                long head = heads[slot];
+
+                if (head >= 0) {
+                    old->matches[head] = (long)i;
+                    new->matches[i] = head;
+                    heads[slot] = next[head];
+                }
+
+                break;
+            }
+
+            slot = (slot + 1) & (capacity - 1);
+        }
+    }
+
+    free(keys);
+    free(heads);
+    free(tails);
+    free(next);
+}
+
+// the matched tasks that keep their relative order are the longest increasing
+// subsequence of the old indexes in the new order, the other ones moved.
+// O(n log n) with patience sorting
+static bool *stable_tasks(const Diff_Side *new) {
+    size_t count = cl_arr_len(new->tasks);
+    bool *stable = calloc(count + 1, sizeof(bool));
+    // new index of the smallest tail of every subsequence length
+    size_t *tails = malloc(sizeof(size_t) * (count + 1));
+    long *previous = malloc(sizeof(long) * (count + 1));
+    size_t length = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        long value = new->matches[i];
+
+        if (value < 0) continue;
+
+        size_t low = 0, high = length;
+
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+
+            if (new->matches[tails[middle]] < value) low = middle + 1;
+            else high = middle;
+        }
+
+        previous[i] = low > 0 ? (long)tails[low - 1] : -1;
+        tails[low] = i;
+
+        if (low == length) length++;
+    }
+
+    if (length > 0) {
+        for (long i = (long)tails[length - 1]; i >= 0; i = previous[i]) stable[i] = true;
+    }
+
+    free(tails);
+    free(previous);
+
+    return stable;
+}
+
+static void print_location(const char *name, wodo_location_t location) {
+    printf(",\"%s\":{\"line\":%d,\"col\":%d}", name, location.line, location.col);
+}
+
+// the strings of `nodes` that are not in `other`
+static void print_strings_not_in(wodo_node_t *nodes, wodo_node_t *other) {
+    bool first = true;
+
+    printf("[");
+
+    for (size_t i = 0; i < cl_arr_len(nodes); i++) {
+        bool found = false;
+
+        for (size_t j = 0; j < cl_arr_len(other) && !found; j++) {
+            found = cmp_sized_strings(nodes[i].string.value, other[j].string.value, nodes[i].string.length, other[j].string.length);
+        }
+
+        if (found) continue;
+
+        if (!first) printf(",");
+
+        print_scaped_string_to_fd(nodes[i].string, stdout);
+        first = false;
+    }
+
+    printf("]");
+}
+
+static bool same_strings(wodo_node_t *a, wodo_node_t *b) {
+    if (cl_arr_len(a) != cl_arr_len(b)) return false;
+
+    for (size_t i = 0; i < cl_arr_len(a); i++) {
+        if (!cmp_sized_strings(a[i].string.value, b[i].string.value, a[i].string.length, b[i].string.length)) return false;
+    }
+
+    return true;
+}
+
+static void print_string_change(const char *property, wodo_string_t old, wodo_string_t new, bool *first) {
+    old = trim(old);
+    new = trim(new);
+
+    if (cmp_sized_strings(old.value, new.value, old.length, new.length)) return;
+
+    printf("%s{\"property\":\"%s\",\"old\":", *first ? "" : ",", property);
+    print_scaped_string_to_fd(old, stdout);
+    printf(",\"new\":");
+    print_scaped_string_to_fd(new, stdout);
+    printf("}");
+
+    *first = false;
+}
+
+// null when the task doesn't set it
+static void print_property_value(const wodo_property_t *property, const wodo_property_value_t *value) {
+    char text[WODO_PROPERTY_VALUE_MAX_SIZE];
+
+    if (value == NULL) {
+        printf("null");
+    } else {
+        printf("\"%.*s\"", (int)format_property_value(text, property, value->value), text);
+    }
+}
+
+// both lists are sorted by property, so they're merged in one pass
+static void print_property_changes(const wodo_task_t *old, const wodo_task_t *new, bool *first) {
+    size_t i = 0, j = 0;
+
+    while (i < old->properties_count || j < new->properties_count) {
+        const wodo_property_value_t *a = i < old->properties_count ? &old->properties[i] : NULL;
+        const wodo_property_value_t *b = j < new->properties_count ? &new->properties[j] : NULL;
+
+        if (a != NULL && b != NULL && a->property != b->property) {
+            if (a->property < b->property) b = NULL;
+            else a = NULL;
+        }
+
+        if (a != NULL) i++;
+        if (b != NULL) j++;
+
+        if (a != NULL && b != NULL && a->value == b->value) continue;
+
+        const wodo_property_t *property = property_at(a != NULL ? a->property : b->property);
+
+        printf("%s{\"property\":\"%s\",\"old\":", *first ? "" : ",", property->name);
+        print_property_value(property, a);
+        printf(",\"new\":");
+        print_property_value(property, b);
+        printf("}");
+
+        *first = false;
+    }
+}
+
+static void print_changes(const wodo_task_t *old, const wodo_task_t *new) {
+    bool first = true;
+
+    printf(",\"changes\":[");
+
+    if (old->state_property.state != new->state_property.state) {
+        printf("%s{\"property\":\"state\",\"old\":\"%s\",\"new\":\"%s\"}", first ? "" : ",", state_names[old->state_property.state], state_names[new->state_property.state]);
+        first = false;
+    }
+
+    if (datetime_to_timestamp(old->date_property.datetime) != datetime_to_timestamp(new->date_property.datetime)) {
+        printf("%s{\"property\":\"date\",\"old\":\"", first ? "" : ",");
+        print_wodo_datetime(old->date_property.datetime, false);
+        printf("\",\"new\":\"");
+        print_wodo_datetime(new->date_property.datetime, false);
+        printf("\"}");
+        first = false;
+    }
+
+    if (!same_strings(old->tags_property.node_array, new->tags_property.node_array)) {
+        printf("%s{\"property\":\"tags\",\"added\":", first ? "" : ",");
+        print_strings_not_in(new->tags_property.node_array, old->tags_property.node_array);
+        printf(",\"removed\":");
+        print_strings_not_in(old->tags_property.node_array, new->tags_property.node_array);
+        printf("}");
+        first = false;
+    }
+
+    if (!same_strings(old->depends_property.node_array, new->depends_property.node_array)) {
+        printf("%s{\"property\":\"depends\",\"added\":", first ? "" : ",");
+        print_strings_not_in(new->depends_property.node_array, old->depends_property.node_array);
+        printf(",\"removed\":");
+        print_strings_not_in(old->depends_property.node_array, new->depends_property.node_array);
+        printf("}");
+        first = false;
+    }
+
+    if (old->remind_property.boolean != new->remind_property.boolean) {
+        printf("%s{\"property\":\"remind\",\"old\":%s,\"new\":%s}", first ? "" : ",", old->remind_property.boolean ? "true" : "false", new->remind_property.boolean ? "true" : "false");
+        first = false;
+    }
+
+    print_property_changes(old, new, &first);
+
+    print_string_change("description", old->description.string, new->description.string, &first);
+
+    printf("]");
+}
+
+static void print_event(Diff_Event_Kind kind, const wodo_task_t *old, const wodo_task_t *new, bool changed, Flags flags, bool *first) {
+    const wodo_task_t *task = new != NULL ? new : old;
+
+    if (!flags.ndjson && !*first) printf(",");
+
+    printf("{\"event\":\"%s\",\"title\":", event_names[kind]);
+    print_scaped_string_to_fd(trim(task->title.string), stdout);
+
+    if (!flags.no_locations) {
+        if (old != NULL) print_location("old", old->title.location);
+        if (new != NULL) print_location("new", new->title.location);
+    }
+
+    if (changed) print_changes(old, new);
+
+    printf("}");
+
+    if (flags.ndjson) printf("\n");
+
+    *first = false;
+}
+
+static void print_diagnostics(const Diff_Side *side) {
+    for (size_t i = 0; i < cl_arr_len(side->diagnostics); i++) {
+        wodo_diagnostic_t diagnostic = side->diagnostics[i];
+
+        fprintf(stderr, "%s:%d:%d %s: %s\n", side->filepath, diagnostic.location.line, diagnostic.location.col,
+            diagnostic.severity == Wodo_Diagnostic_Error ? "error" : "warning", diagnostic.message);
+    }
+}
+
+int diff_action(const char *old_filepath, const char *new_filepath, Flags flags) {
+    TRACE_SCOPE("diff");
+
+    if (strcmp(old_filepath, "-") == 0 && strcmp(new_filepath, "-") == 0) {
+        fprintf(stderr, "error: only one of the versions can be read from stdin\n");
+
+        return 1;
+    }
+
+    Diff_Side old = {0}, new = {0};
+
+    if (!read_side(&old, old_filepath)) return 1;
+
+    if (!read_side(&new, new_filepath)) {
+        free_side(&old);
+
+        return 1;
+    }
+
+    print_diagnostics(&old);
+    print_diagnostics(&new);
+
+    match_titles(&old, &new);
+
+    bool *stable = stable_tasks(&new);
+    bool first = true;
+
+    if (!flags.ndjson) printf("[");
+
+    // removals in the old order, then everything else in the new order
+    for (size_t i = 0; i < cl_arr_len(old.tasks); i++) {
+        if (old.matches[i] < 0) print_event(DE_REMOVE, &old.tasks[i], NULL, false, flags, &first);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(new.tasks); i++) {
+        long match = new.matches[i];
+
+        if (match < 0) {
+            print_event(DE_ADD, NULL, &new.tasks[i], false, flags, &first);
+
+            continue;
+        }
+
+        bool changed = old.hashes[match] != new.hashes[i];
+
+        if (!stable[i]) {
+            print_event(DE_MOVE, &old.tasks[match], &new.tasks[i], changed, flags, &first);
+        } else if (changed) {
+            print_event(DE_MODIFY, &old.tasks[match], &new.tasks[i], true, flags, &first);
+        }
+    }
+
+    if (!flags.ndjson) printf("]\n");
+
+    bool has_errors = false;
+
+    for (size_t i = 0; i < cl_arr_len(old.diagnostics); i++) has_errors |= old.diagnostics[i].severity == Wodo_Diagnostic_Error;
+    for (size_t i = 0; i < cl_arr_len(new.diagnostics); i++) has_errors |= new.diagnostics[i].severity == Wodo_Diagnostic_Error;
+
+    free(stable);
+    free_side(&old);
+    free_side(&new);
+
+    return has_errors;
+}
@@ -0,0 +1,15 @@
+#ifndef _WODO_DIFF_H_
+#define _WODO_DIFF_H_
+
+#include "argparser.h"
+
+// `wodo diff <old> <new>`, any of them can be "-" to read it from stdin
+//
+// tasks are matched by title (the n-th task with a title in <old> with the
+// n-th one in <new>) and compared through a hash of their canonical fields.
+// Prints remove events in the old order, then add, modify and move events in
+// the new order. A matched task is moved when it's not part of the longest
+// sequence of matched tasks that kept their order.
+int diff_action(const char *old_filepath, const char *new_filepath, Flags flags);
+
+#endif // !_WODO_DIFF_H_
@@ -0,0 +1,295 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "gc.h"
+#include "arr.h"
+#include "database.h"
+#include "json.h"
+#include "utils.h"
+#include "trace.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+static const char *file_extension = ".wodo";
+static const char *ids_folder_name = ".task-ids";
+
+#define SCAN_BUFFER_SIZE (256 * 1024)
+
+// open addressing set of names, the names are not owned
+typedef struct {
+    const char **slots;
+    size_t capacity;
+} Name_Set;
+
+typedef struct {
+    const char *name;
+    const char *path;
+    bool adopted;
+} Gc_Entry;
+
+static uint64_t name_hash(const char *name) {
+    return fnv1a(FNV1A_OFFSET_BASIS, name, strlen(name));
+}
+
+static void name_set_init(Name_Set *set, size_t count) {
+    set->capacity = 64;
+
+    while (set->capacity < count * 2) set->capacity *= 2;
+
+    set->slots = calloc(set->capacity, sizeof(const char *));
+}
+
+static void name_set_add(Name_Set *set, const char *name) {
+    size_t slot = name_hash(name) & (set->capacity - 1);
+
+    while (set->slots[slot] != NULL) {
+        if (strcmp(set->slots[slot], name) == 0) return;
+
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+
+    set->slots[slot] = name;
+}
+
+static bool name_set_contains(const Name_Set *set, const char *name) {
+    size_t slot = name_hash(name) & (set->capacity - 1);
+
+    for (; set->slots[slot] != NULL; slot = (slot + 1) & (set->capacity - 1)) {
+        if (strcmp(set->slots[slot], name) == 0) return true;
+    }
+
+    return false;
+}
+
+static bool has_suffix(const char *name, const char *suffix) {
+    size_t name_size = strlen(name);
+    size_t suffix_size = strlen(suffix);
+
+    return name_size > suffix_size && strcmp(name + name_size - suffix_size, suffix) == 0;
+}
+
+static void push_entry(char ***names, const char *name, unsigned char type, const char *suffix) {
+    if (name[0] == '.') return;
+    if (type != DT_REG && type != DT_UNKNOWN) return;
+    if (suffix != NULL && !has_suffix(name, suffix)) return;
+
+    cl_arr_push(*names, strdup(name));
+}
+
+#if defined(__linux__) && defined(SYS_getdents64)
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// the regular files of `path` (ending with `suffix` when it's not NULL), read
+// with a few getdents64 calls instead of one readdir call per file
+static bool scan_directory(const char *path, const char *suffix, char ***names) {
+    TRACE_SCOPE_ARG("scan_directory", path);
+
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (fd < 0) return false;
+
+    char *buffer = malloc(SCAN_BUFFER_SIZE);
+    long size;
+
+    while ((size = syscall(SYS_getdents64, fd, buffer, SCAN_BUFFER_SIZE)) > 0) {
+        for (long offset = 0; offset < size;) {
+            struct linux_dirent64 *entry = (struct linux_dirent64 *)(buffer + offset);
+
+            push_entry(names, entry->d_name, entry->d_type, suffix);
+
+            offset += entry->d_reclen;
+        }
+    }
+
+    int saved_errno = errno;
+
+    free(buffer);
+    close(fd);
+    errno = saved_errno;
+
+    return size == 0;
+}
+
+#else
+
+static bool scan_directory(const char *path, const char *suffix, char ***names) {
+    TRACE_SCOPE_ARG("scan_directory", path);
+
+    DIR *dir = opendir(path);
+
+    if (dir == NULL) return false;
+
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) push_entry(names, entry->d_name, entry->d_type, suffix);
+
+    closedir(dir);
+
+    return true;
+}
+
+#endif
+
+static void free_names(char ***names) {
+    for (size_t i = 0; i < cl_arr_len(*names); i++) free((*names)[i]);
+
+    cl_arr_free(*names);
+}
+
+// "a1b2-1700000000.wodo" -> "a1b2-1700000000", owned by the caller
+static char *name_from_filename(const char *filename) {
+    return strndup(filename, strlen(filename) - strlen(file_extension));
+}
+
+static void print_entries_as_json(Gc_Entry *entries, bool with_adopted) {
+    printf("[");
+
+    for (size_t i = 0; i < cl_arr_len(entries); i++) {
+        if (i > 0) printf(",");
+
+        printf("{\"name\":");
+        print_scaped_string_to_fd((wodo_string_t){ .value = entries[i].name, .length = strlen(entries[i].name) }, stdout);
+        printf(",\"path\":");
+        print_scaped_string_to_fd((wodo_string_t){ .value = entries[i].path, .length = strlen(entries[i].path) }, stdout);
+
+        if (with_adopted) printf(",\"adopted\":%s", entries[i].adopted ? "true" : "false");
+
+        printf("}");
+    }
+
+    printf("]");
+}
+
+// removes the task id indexes whose .wodo file is not in `files`
+static size_t remove_stale_indexes(const Name_Set *files, bool dry_run) {
+    char *folder = join_paths("%s/%s", database_folder(), ids_folder_name);
+    char **indexes = CL_ARRAY_INIT;
+    size_t removed = 0;
+
+    // no folder means no index was built yet
+    if (scan_directory(folder, NULL, &indexes)) {
+        for (size_t i = 0; i < cl_arr_len(indexes); i++) {
+            if (name_set_contains(files, indexes[i])) continue;
+
+            char *path = join_paths("%s/%s", folder, indexes[i]);
+
+            if (dry_run || unlink(path) == 0) removed++;
+
+            free(path);
+        }
+    }
+
+    free_names(&indexes);
+    free(folder);
+
+    return removed;
+}
+
+int gc_action(Flags flags) {
+    TRACE_SCOPE("gc");
+
+    char **filenames = CL_ARRAY_INIT;
+
+    if (!scan_directory(database_folder(), file_extension, &filenames)) {
+        fprintf(stderr, "error: could not read %s: %s\n", database_folder(), strerror(errno));
+        free_names(&filenames);
+
+        return 1;
+    }
+
+    size_t files_count = cl_arr_len(global_database.files);
+    Name_Set on_disk, in_database;
+
+    name_set_init(&on_disk, cl_arr_len(filenames));
+    name_set_init(&in_database, files_count);
+
+    for (size_t i = 0; i < cl_arr_len(filenames); i++) name_set_add(&on_disk, filenames[i]);
+
+    Gc_Entry *pruned = CL_ARRAY_INIT;
+    Gc_Entry *orphans = CL_ARRAY_INIT;
+    size_t database_count = 0;
+
+    for (size_t i = 0; i < files_count; i++) {
+        Database_File *it = global_database.files[i];
+
+        if (it->view_deleted) continue;
+
+        database_count++;
+
+        // files outside of the .wodo folder can't be in the scan
+        bool exists = strchr(it->relative_filepath, '/') == NULL
+            ? name_set_contains(&on_disk, it->relative_filepath)
+            : access(it->view_absolute_filepath, F_OK) == 0;
+
+        name_set_add(&in_database, it->relative_filepath);
+
+        if (!exists) cl_arr_push(pruned, ((Gc_Entry){ .name = it->name, .path = it->view_absolute_filepath }));
+    }
+
+    for (size_t i = 0; i < cl_arr_len(filenames); i++) {
+        if (name_set_contains(&in_database, filenames[i])) continue;
+
+        cl_arr_push(orphans, ((Gc_Entry){ .name = name_from_filename(filenames[i]), .path = join_paths("%s/%s", database_folder(), filenames[i]) }));
+    }
+
+    int return_code = 0;
+
+    if (!flags.dry_run && (cl_arr_len(pruned) > 0 || (flags.adopt && cl_arr_len(orphans) > 0))) {
+        database_begin_batch();
+
+        // the files are already gone, so the commit only drops the entries
+        for (size_t i = 0; i < cl_arr_len(pruned); i++) database_delete_file(pruned[i].path);
+
+        for (size_t i = 0; flags.adopt && i < cl_arr_len(orphans); i++) {
+            const char *filename = orphans[i].path + strlen(database_folder()) + 1;
+
+            orphans[i].adopted = database_adopt_file(strdup(orphans[i].name), filename) == DATABASE_OK_STATUS_CODE;
+        }
+
+        if (database_commit() != DATABASE_OK_STATUS_CODE) {
+            fprintf(stderr, "error: could not save database file: %s\n", strerror(errno));
+
+            return_code = 1;
+        }
+    }
+
+    if (return_code == 0) {
+        size_t removed_indexes = remove_stale_indexes(&on_disk, flags.dry_run);
+
+        printf("{\"dry_run\":%s", flags.dry_run ? "true" : "false");
+        printf(",\"scanned\":{\"database\":%zu,\"directory\":%zu}", database_count, cl_arr_len(filenames));
+        printf(",\"pruned\":");
+        print_entries_as_json(pruned, false);
+        printf(",\"orphans\":");
+        print_entries_as_json(orphans, true);
+        printf(",\"indexes\":{\"removed\":%zu}}\n", removed_indexes);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(orphans); i++) {
+        free((char *)orphans[i].name);
+        free((char *)orphans[i].path);
+    }
+
+    cl_arr_free(pruned);
+    cl_arr_free(orphans);
+    free(on_disk.slots);
+    free(in_database.slots);
+    free_names(&filenames);
+
+    return return_code;
+}
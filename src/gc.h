@@ -0,0 +1,15 @@
+#ifndef _WODO_GC_H_
+#define _WODO_GC_H_
+
+#include "argparser.h"
+
+// `wodo gc [--adopt] [--dry-run]`
+//
+// reconciles the database with the .wodo folder, read in a single directory
+// scan: entries whose file is gone are pruned, .wodo files that the database
+// doesn't know about are reported as orphans (and added with --adopt), and
+// the task id indexes of files that are gone are removed. Prints a summary,
+// with --dry-run nothing is changed.
+int gc_action(Flags flags);
+
+#endif // !_WODO_GC_H_
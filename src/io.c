@@ -1,11 +1,17 @@
 #include "io.h"
+#include "trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 size_t read_from_file(const char *filename, char **content) {
+    TRACE_SCOPE_ARG("read_from_file", filename);
+
     FILE *fptr = fopen(filename, "r");
 
     if (fptr == NULL) {
@@ -13,8 +19,15 @@ size_t read_from_file(const char *filename, char **content) {
         exit(1);
     }
 
-    fseek(fptr, 0, SEEK_END);
-    const size_t stream_size = ftell(fptr);
+    long end = fseek(fptr, 0, SEEK_END) == 0 ? ftell(fptr) : -1;
+
+    if (end < 0) {
+        fprintf(stderr, "could not read file %s due to: %s\n", filename, strerror(errno));
+        fclose(fptr);
+        exit(1);
+    }
+
+    const size_t stream_size = end;
     rewind(fptr);
 
     if (content != NULL) {
@@ -43,7 +56,71 @@ size_t read_from_file(const char *filename, char **content) {
     return stream_size;
 }
 
+bool read_from_file_no_quit(const char *filename, char **content, size_t *length) {
+    TRACE_SCOPE_ARG("read_from_file", filename);
+
+    FILE *fptr = fopen(filename, "r");
+
+    if (fptr == NULL) return false;
+
+    struct stat st;
+
+    // directories can be opened and "seeked" to a huge end
+    if (fstat(fileno(fptr), &st) == 0 && S_ISDIR(st.st_mode)) {
+        fclose(fptr);
+        errno = EISDIR;
+
+        return false;
+    }
+
+    long end = fseek(fptr, 0, SEEK_END) == 0 ? ftell(fptr) : -1;
+
+    // not seekable (a pipe, a directory), its size is unknown
+    if (end < 0) {
+        int seek_errno = errno;
+
+        fclose(fptr);
+        errno = seek_errno;
+
+        return false;
+    }
+
+    const size_t stream_size = end;
+    rewind(fptr);
+
+    *content = malloc((stream_size + 1) * sizeof(char));
+
+    if (*content == NULL) {
+        fclose(fptr);
+
+        return false;
+    }
+
+    const size_t read_size = fread(*content, 1, stream_size, fptr);
+
+    if (read_size != stream_size) {
+        int read_errno = errno;
+
+        free(*content);
+        *content = NULL;
+        fclose(fptr);
+        errno = read_errno;
+
+        return false;
+    }
+
+    (*content)[stream_size] = '\0';
+
+    fclose(fptr);
+
+    *length = stream_size;
+
+    return true;
+}
+
 size_t read_from_stdin(char **content) {
+    TRACE_SCOPE("read_from_stdin");
+
     char *line = NULL;
     size_t len;
     size_t read_size = 0;
@@ -64,3 +141,60 @@ size_t read_from_stdin(char **content) {
 
     return content_length;
 }
+
+bool write_file_atomically(const char *path, const char *content, size_t length) {
+    TRACE_SCOPE_ARG("write_file_atomically", path);
+
+    struct stat st;
+    mode_t mode;
+
+    // new files get the usual permissions, existing ones keep theirs
+    if (stat(path, &st) == 0) {
+        mode = st.st_mode & 07777;
+    } else {
+        mode_t mask = umask(0);
+
+        umask(mask);
+        mode = 0666 & ~mask;
+    }
+
+    // unique per process, readers that refresh an index may write it at the same time
+    size_t temp_path_size = strlen(path) + sizeof(".XXXXXX");
+    char *temp_path = malloc(temp_path_size);
+
+    snprintf(temp_path, temp_path_size, "%s.XXXXXX", path);
+
+    int fd = mkstemp(temp_path);
+
+    if (fd < 0) {
+        free(temp_path);
+
+        return false;
+    }
+
+    bool ok = fcntl(fd, F_SETFD, FD_CLOEXEC) == 0 && fchmod(fd, mode) == 0;
+    size_t written = 0;
+
+    while (ok && written < length) {
+        ssize_t size = write(fd, content + written, length - written);
+
+        if (size < 0 && errno == EINTR) continue;
+
+        ok = size > 0;
+
+        if (ok) written += size;
+    }
+
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(temp_path, path) == 0;
+
+    int saved_errno = errno;
+
+    if (!ok) unlink(temp_path);
+
+    free(temp_path);
+    errno = saved_errno;
+
+    return ok;
+}
@@ -1,10 +1,18 @@
 #ifndef _WODO_IO_H_
 #define _WODO_IO_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 
 size_t read_from_file(const char *filename, char **content);
+// same as `read_from_file` but does not quit on errors.
+// returns false and keeps errno when the file could not be read.
+bool read_from_file_no_quit(const char *filename, char **content, size_t *length);
 size_t read_from_stdin(char **content);
+// writes a synced temporary file next to `path` and renames it over `path`,
+// so after a crash the file is either the old or the new version.
+// returns false and keeps errno on errors
+bool write_file_atomically(const char *path, const char *content, size_t length);
 
 #endif // !_WODO_IO_H_
 
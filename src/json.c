@@ -1,5 +1,6 @@
 #define CL_ARRAY_IMPLEMENTATION
 #include <string.h>
+#include <errno.h>
 #include <stdio.h>
 #include "json.h"
 #include "arr.h"
@@ -8,159 +9,208 @@
 #include "utils.h"
 #include "io.h"
 #include "parser.h"
+#include "trace.h"
+#include "taskid.h"
+#include "archive.h"
+#include "properties.h"
+
+static void print_location_to_stdout_as_json(wodo_location_t location) {
+    printf("\"location\":{");
+    printf("\"line\":%d,", location.line);
+    printf("\"col\":%d", location.col);
+    printf("}");
+}
 
-void print_tasks_to_stdout_as_json(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags) {
-    int comma_index = 0;
+void print_task_to_stdout_as_json(wodo_task_t task, const char *id, Flags flags) {
+    bool locations = !flags.no_locations;
+    bool first_field = true;
 
-    printf("[");
-    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
-        wodo_task_t task = tasks[i];
+    printf("{");
+    // id
+    if (id != NULL && (flags.fields & WODO_FIELD_ID)) {
+        first_field = false;
 
-        if (!predicate(task, flags)) continue;
+        printf("\"id\":\"%s\"", id);
+    }
 
-        // separate objects
-        if (comma_index > 0) printf(",");
-        comma_index++;
+    // title
+    if (flags.fields & WODO_FIELD_TITLE) {
+        if (!first_field) printf(",");
+        first_field = false;
 
-        printf("{");
-        // title
-        {
-            printf("\"title\":{");
-            printf("\"content\":");
-            print_scaped_string_to_fd(task.title.string, stdout);
+        printf("\"title\":{");
+        printf("\"content\":");
+        print_scaped_string_to_fd(task.title.string, stdout);
+        // location
+        if (locations) {
             printf(",");
-            // location
-            {
-                printf("\"location\":{");
-                printf("\"line\":%d,", task.title.location.line);
-                printf("\"col\":%d", task.title.location.col);
-                printf("}");
-            }
-            printf("}");
+            print_location_to_stdout_as_json(task.title.location);
         }
+        printf("}");
+    }
 
-        printf(",");
+    // state
+    if (flags.fields & WODO_FIELD_STATE) {
+        if (!first_field) printf(",");
+        first_field = false;
+
+        printf("\"state\":{");
+        printf("\"content\":");
+        switch (task.state_property.state) {
+            case Wodo_Task_State_Todo: printf("\"todo\""); break;
+            case Wodo_Task_State_Doing: printf("\"doing\""); break;
+            case Wodo_Task_State_Blocked: printf("\"blocked\""); break;
+            case Wodo_Task_State_Done: printf("\"done\""); break;
+            default: assert(0 && "unimplemented json parsing state");
+        }
+        // location
+        if (locations && task.state_property.location.col != 0) {
+            printf(",");
+            print_location_to_stdout_as_json(task.state_property.location);
+        }
 
-        // state
-        {
-            printf("\"state\":{");
-            printf("\"content\":");
-            switch (task.state_property.state) {
-                case Wodo_Task_State_Todo: printf("\"todo\""); break;
-                case Wodo_Task_State_Doing: printf("\"doing\""); break;
-                case Wodo_Task_State_Blocked: printf("\"blocked\""); break;
-                case Wodo_Task_State_Done: printf("\"done\""); break;
-                default: assert(0 && "unimplemented json parsing state");
-            }
-            // location
-            if (task.state_property.location.col != 0) {
-                printf(",");
-                printf("\"location\":{");
-                printf("\"line\":%d,", task.state_property.location.line);
-                printf("\"col\":%d", task.state_property.location.col);
-                printf("}");
-            }
+        printf("}");
+    }
 
-            printf("}");
+    // date
+    if (flags.fields & WODO_FIELD_DATE) {
+        if (!first_field) printf(",");
+        first_field = false;
+
+        printf("\"date\":{");
+        printf("\"content\":\"");
+        print_wodo_datetime(task.date_property.datetime, false);
+        printf("\"");
+
+        // location
+        if (locations) {
+            printf(",");
+            print_location_to_stdout_as_json(task.date_property.location);
         }
 
-        printf(",");
+        printf("}");
+    }
 
-        // date
+    // tags
+    if (flags.fields & WODO_FIELD_TAGS) {
+        if (!first_field) printf(",");
+        first_field = false;
+
+        wodo_node_t *tags = task.tags_property.node_array;
+
+        printf("\"tags\":{");
+        // content
         {
-            printf("\"date\":{");
-            printf("\"content\":\"");
-            print_wodo_datetime(task.date_property.datetime, false);
-            printf("\",");
+            printf("\"content\":[");
 
-            // location
-            {
-                printf("\"location\":{");
-                printf("\"line\":%d,", task.date_property.location.line);
-                printf("\"col\":%d", task.date_property.location.col);
+            for (size_t i = 0; i < cl_arr_len(tags); i++) {
+                if (i > 0) printf(",");
+
+                wodo_node_t tag = tags[i];
+
+                printf("{");
+                printf("\"content\":\"%.*s\"", (int)tag.string.length, tag.string.value);
+                // location
+                if (locations) {
+                    printf(",");
+                    print_location_to_stdout_as_json(tag.location);
+                }
                 printf("}");
             }
+            printf("]");
+        }
 
-            printf("}");
+        // location
+        if (locations && task.tags_property.location.col != 0) {
+            printf(",");
+            print_location_to_stdout_as_json(task.tags_property.location);
         }
 
-        printf(",");
+        printf("}");
+    }
 
-        // tags
-        {
-            wodo_node_t *tags = task.tags_property.node_array;
-
-            printf("\"tags\":{");
-            // content
-            {
-                printf("\"content\":[");
-
-                for (size_t i = 0; i < cl_arr_len(tags); i++) {
-                    if (i > 0) printf(",");
-
-                    wodo_node_t tag = tags[i];
-
-                    printf("{");
-                    printf("\"content\":\"%.*s\",", (int)tag.string.length, tag.string.value);
-                    // location
-                    {
-                        printf("\"location\":{");
-                        printf("\"line\":%d,", tag.location.line);
-                        printf("\"col\":%d", tag.location.col);
-                        printf("}");
-                    }
-                    printf("}");
-                }
-                printf("]");
-            }
+    // remind
+    if (flags.fields & WODO_FIELD_REMIND) {
+        if (!first_field) printf(",");
+        first_field = false;
 
-            // location
-            if (task.tags_property.location.col != 0) {
-                printf(",");
-                printf("\"location\":{");
-                printf("\"line\":%d,", task.tags_property.location.line);
-                printf("\"col\":%d", task.tags_property.location.col);
-                printf("}");
-            }
+        printf("\"remind\":{");
+        printf("\"content\":%s", task.remind_property.boolean ? "true" : "false");
 
-            printf("}");
+        // location
+        if (locations) {
+            printf(",");
+            print_location_to_stdout_as_json(task.date_property.location);
         }
 
-        printf(",");
+        printf("}");
+    }
 
-        // remind
-        {
-            printf("\"remind\":{");
-            printf("\"content\":%s,", task.remind_property.boolean ? "true" : "false");
+    // depends
+    if (flags.fields & WODO_FIELD_DEPENDS) {
+        if (!first_field) printf(",");
+        first_field = false;
 
-            // location
-            {
-                printf("\"location\":{");
-                printf("\"line\":%d,", task.date_property.location.line);
-                printf("\"col\":%d", task.date_property.location.col);
-                printf("}");
+        wodo_node_t *depends = task.depends_property.node_array;
+
+        printf("\"depends\":{");
+        printf("\"content\":[");
+
+        for (size_t i = 0; i < cl_arr_len(depends); i++) {
+            if (i > 0) printf(",");
+
+            printf("{");
+            printf("\"content\":");
+            print_scaped_string_to_fd(depends[i].string, stdout);
+
+            if (locations) {
+                printf(",");
+                print_location_to_stdout_as_json(depends[i].location);
             }
 
             printf("}");
         }
 
-        printf(",");
+        printf("]");
 
-        // description
-        {
-            printf("\"description\":{");
+        // location
+        if (locations && task.depends_property.location.col != 0) {
+            printf(",");
+            print_location_to_stdout_as_json(task.depends_property.location);
+        }
 
+        printf("}");
+    }
+
+    // properties
+    if (flags.fields & WODO_FIELD_PROPERTIES) {
+        if (!first_field) printf(",");
+        first_field = false;
+
+        printf("\"properties\":{");
+
+        for (size_t i = 0; i < task.properties_count; i++) {
+            wodo_property_value_t it = task.properties[i];
+            const wodo_property_t *property = property_at(it.property);
+
+            if (i > 0) printf(",");
+
+            printf("\"%s\":{", property->name);
             printf("\"content\":");
 
-            print_scaped_string_to_fd(task.description.string, stdout);
+            // durations are in seconds
+            if (property->type == Wodo_Property_Int || property->type == Wodo_Property_Duration) {
+                printf("%lld", (long long)it.value);
+            } else {
+                char value[WODO_PROPERTY_VALUE_MAX_SIZE];
+
+                printf("\"%.*s\"", (int)format_property_value(value, property, it.value), value);
+            }
 
             // location
-            if (task.description.location.col != 0) {
+            if (locations) {
                 printf(",");
-                printf("\"location\":{");
-                printf("\"line\":%d,", task.description.location.line);
-                printf("\"col\":%d", task.description.location.col);
-                printf("}");
+                print_location_to_stdout_as_json(it.location);
             }
 
             printf("}");
@@ -168,94 +218,284 @@ void print_tasks_to_stdout_as_json(wodo_task_t *tasks, bool (*predicate)(wodo_ta
 
         printf("}");
     }
+
+    // description
+    if (flags.fields & WODO_FIELD_DESCRIPTION) {
+        if (!first_field) printf(",");
+        first_field = false;
+
+        printf("\"description\":{");
+
+        printf("\"content\":");
+
+        wodo_string_t description = task.description.string;
+
+        if (flags.description_preview >= 0) {
+            description.length = utf8_prefix_size(description, flags.description_preview);
+        }
+
+        print_scaped_string_to_fd(description, stdout);
+
+        // location
+        if (locations && task.description.location.col != 0) {
+            printf(",");
+            print_location_to_stdout_as_json(task.description.location);
+        }
+
+        printf("}");
+    }
+
+    printf("}");
+}
+
+void print_tasks_to_stdout_as_json(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags) {
+    TRACE_SCOPE("serialize");
+
+    int comma_index = 0;
+    Task_Id *ids = (flags.fields & WODO_FIELD_ID) ? compute_task_ids(tasks) : NULL;
+
+    printf("[");
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        wodo_task_t task = tasks[i];
+
+        if (!predicate(task, flags)) continue;
+
+        // separate objects
+        if (comma_index > 0) printf(",");
+        comma_index++;
+
+        print_task_to_stdout_as_json(task, ids == NULL ? NULL : ids[i].value, flags);
+    }
+    printf("]");
+
+    cl_arr_free(ids);
+}
+
+void print_tasks_to_stdout_as_ndjson(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags) {
+    TRACE_SCOPE("serialize");
+
+    Task_Id *ids = (flags.fields & WODO_FIELD_ID) ? compute_task_ids(tasks) : NULL;
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        wodo_task_t task = tasks[i];
+
+        if (!predicate(task, flags)) continue;
+
+        print_task_to_stdout_as_json(task, ids == NULL ? NULL : ids[i].value, flags);
+        printf("\n");
+        fflush(stdout);
+    }
+
+    cl_arr_free(ids);
+}
+
+static void print_diagnostic_to_stdout_as_json(wodo_diagnostic_t diagnostic) {
+    printf("{");
+        printf("\"file\":");
+        print_scaped_string_to_fd((wodo_string_t){
+            .length = strlen(diagnostic.filename),
+            .value = diagnostic.filename
+        }, stdout);
+        printf(",");
+        printf("\"line\":%d,", diagnostic.location.line);
+        printf("\"col\":%d,", diagnostic.location.col);
+        printf("\"severity\":\"%s\",", diagnostic.severity == Wodo_Diagnostic_Error ? "error" : "warning");
+        printf("\"message\":");
+        print_scaped_string_to_fd((wodo_string_t){
+            .length = strlen(diagnostic.message),
+            .value = diagnostic.message
+        }, stdout);
+        printf("}");
+}
+
+void print_diagnostics_to_stdout_as_json(wodo_diagnostic_t *diagnostics) {
+    printf("[");
+    for (size_t i = 0; i < cl_arr_len(diagnostics); i++) {
+        if (i > 0) printf(",");
+
+        print_diagnostic_to_stdout_as_json(diagnostics[i]);
+    }
     printf("]");
 }
 
-void print_database_files_to_stdout_as_json(bool (*predicate)(wodo_task_t task, Flags), Flags flags) {
+void print_diagnostics_to_stdout_as_ndjson(wodo_diagnostic_t *diagnostics, size_t from) {
+    for (size_t i = from; i < cl_arr_len(diagnostics); i++) {
+        printf("{\"diagnostic\":");
+        print_diagnostic_to_stdout_as_json(diagnostics[i]);
+        printf("}\n");
+    }
+}
+
+// prints the file when any of its tasks matches or it has no tasks at all,
+// returns whether it was printed
+static bool print_file_to_stdout_as_json(const char *name, const char *path, bool archived, wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags, int *comma_index) {
     int total_count = 0;
     int todo_count = 0;
     int doing_count = 0;
     int blocked_count = 0;
     int done_count = 0;
-    int comma_index = 0;
 
-    printf("[");
-    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
-        Database_File *it = global_database.files[i];
+    bool matched_any_tasks = cl_arr_len(tasks) == 0;
 
-        char *content;
+    TRACE_BEGIN("filter");
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        wodo_task_t task = tasks[i];
 
-        size_t length = read_from_file(it->view_absolute_filepath, &content);
+        if (!predicate(task, flags)) continue;
 
-        reset_parser_state();
+        matched_any_tasks = true;
+
+        switch (task.state_property.state) {
+            case Wodo_Task_State_Todo:
+                todo_count++;
+                break;
+            case Wodo_Task_State_Doing:
+                doing_count++;
+                break;
+            case Wodo_Task_State_Blocked:
+                blocked_count++;
+                break;
+            case Wodo_Task_State_Done:
+                done_count++;
+                break;
+            default: assert(0 && "unhandled wodo state during files listing");
+        }
+        total_count++;
+    }
+
+    TRACE_END();
+
+    if (!matched_any_tasks) return false;
+
+    if (*comma_index > 0 && !flags.ndjson) printf(",");
+
+    (*comma_index)++;
+
+    printf("{");
+    printf("\"name\":");
+    print_scaped_string_to_fd((wodo_string_t){
+        .length = strlen(name),
+        .value = name
+    }, stdout);
+    printf(",");
+    printf("\"path\":\"%s\"", path);
+    if (archived) printf(",\"archived\":true");
+    printf(",");
+    {
+        printf("\"states\": {");
+        printf("\"total\":%d,", total_count);
+        printf("\"todo\":%d,", todo_count);
+        printf("\"doing\":%d,", doing_count);
+        printf("\"blocked\":%d,", blocked_count);
+        printf("\"done\":%d", done_count);
+        printf("}");
+    }
+    printf(",");
+    {
+        printf("\"tasks\":");
+        print_tasks_to_stdout_as_json(tasks, predicate, flags);
+    }
+    printf("}");
+
+    return true;
+}
+
+typedef struct {
+    bool (*predicate)(wodo_task_t, Flags);
+    Flags flags;
+    int *comma_index;
+    wodo_diagnostic_t **diagnostics;
+    size_t printed_diagnostics;
+} Archived_Files_Printer;
 
-        wodo_task_t *tasks = parse_tasks(it->view_absolute_filepath, content, length);
+static void print_archived_file_to_stdout_as_json(const char *name, const char *path, wodo_task_t *tasks, void *data) {
+    Archived_Files_Printer *printer = data;
+    Flags flags = printer->flags;
 
-        bool matched_any_tasks = cl_arr_len(tasks) == 0;
+    // the locations would be the ones inside the archive segment
+    flags.no_locations = true;
 
-        for (size_t i = 0; i < cl_arr_len(tasks); i++) {
-            wodo_task_t task = tasks[i];
+    bool printed = print_file_to_stdout_as_json(name, path, true, tasks, printer->predicate, flags, printer->comma_index);
 
-            if (!predicate(task, flags)) continue;
+    if (flags.ndjson) {
+        if (printed) printf("\n");
 
-            matched_any_tasks = true;
+        print_diagnostics_to_stdout_as_ndjson(*printer->diagnostics, printer->printed_diagnostics);
+        printer->printed_diagnostics = cl_arr_len(*printer->diagnostics);
+        fflush(stdout);
+    }
+}
+
+void print_database_files_to_stdout_as_json(bool (*predicate)(wodo_task_t task, Flags), Flags flags) {
+    int comma_index = 0;
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+    set_parser_options(parser_options_from_flags(flags));
+
+    if (!flags.ndjson) printf("{\"files\":[");
 
-            switch (task.state_property.state) {
-                case Wodo_Task_State_Todo:
-                    todo_count++;
-                    break;
-                case Wodo_Task_State_Doing:
-                    doing_count++;
-                    break;
-                case Wodo_Task_State_Blocked:
-                    blocked_count++;
-                    break;
-                case Wodo_Task_State_Done:
-                    done_count++;
-                    break;
-                default: assert(0 && "unhandled wodo state during files listing");
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        Database_File *it = global_database.files[i];
+
+        TRACE_BEGIN_ARG("file", it->view_absolute_filepath);
+
+        size_t diagnostics_count = cl_arr_len(diagnostics);
+
+        char *content;
+        size_t length;
+
+        if (!read_from_file_no_quit(it->view_absolute_filepath, &content, &length)) {
+            push_diagnostic(&diagnostics, it->view_absolute_filepath, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+
+            if (flags.ndjson) {
+                print_diagnostics_to_stdout_as_ndjson(diagnostics, diagnostics_count);
+                fflush(stdout);
             }
-            total_count++;
-        }
 
-        if (!matched_any_tasks) {
-            free(content);
-            cl_arr_free(tasks);
+            TRACE_END();
 
             continue;
         }
 
-        if (comma_index > 0) printf(",");
+        reset_parser_state();
 
-        comma_index++;
+        wodo_task_t *tasks = parse_tasks_recovering(it->view_absolute_filepath, content, length, &diagnostics);
 
-        printf("{");
-        printf("\"name\":");
-        print_scaped_string_to_fd((wodo_string_t){
-            .length = strlen(it->name),
-            .value = it->name
-        }, stdout);
-        printf(",");
-        printf("\"path\":\"%s\"", it->view_absolute_filepath);
-        printf(",");
-        {
-            printf("\"states\": {");
-            printf("\"total\":%d,", total_count);
-            printf("\"todo\":%d,", todo_count);
-            printf("\"doing\":%d,", doing_count);
-            printf("\"blocked\":%d,", blocked_count);
-            printf("\"done\":%d", done_count);
-            printf("}");
-        }
-        printf(",");
-        {
-            printf("\"tasks\":");
-            print_tasks_to_stdout_as_json(tasks, predicate, flags);
+        bool printed = print_file_to_stdout_as_json(it->name, it->view_absolute_filepath, false, tasks, predicate, flags, &comma_index);
+
+        // one line per file, flushed so readers can show it right away
+        if (flags.ndjson) {
+            if (printed) printf("\n");
+
+            print_diagnostics_to_stdout_as_ndjson(diagnostics, diagnostics_count);
+            fflush(stdout);
         }
-        printf("}");
 
         free(content);
-        cl_arr_free(tasks);
+        free_tasks(tasks);
+
+        TRACE_END();
     };
-    printf("]\n");
+
+    if (flags.include_archive) {
+        Archived_Files_Printer printer = {
+            .predicate = predicate,
+            .flags = flags,
+            .comma_index = &comma_index,
+            .diagnostics = &diagnostics,
+            .printed_diagnostics = cl_arr_len(diagnostics),
+        };
+
+        for_each_archived_file(flags, &diagnostics, print_archived_file_to_stdout_as_json, &printer);
+    }
+
+    if (!flags.ndjson) {
+        printf("],");
+        printf("\"diagnostics\":");
+        print_diagnostics_to_stdout_as_json(diagnostics);
+        printf("}\n");
+    }
+
+    free_diagnostics(&diagnostics);
 }
@@ -5,7 +5,22 @@
 #include "systemtypes.h"
 #include "argparser.h"
 
+// `id` is only printed when it's not NULL
+void print_task_to_stdout_as_json(wodo_task_t task, const char *id, Flags flags);
 void print_tasks_to_stdout_as_json(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags);
+// one task object per line
+void print_tasks_to_stdout_as_ndjson(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags);
+void print_diagnostics_to_stdout_as_json(wodo_diagnostic_t *diagnostics);
+// {"diagnostic":{...}} lines for every diagnostic after `from`
+void print_diagnostics_to_stdout_as_ndjson(wodo_diagnostic_t *diagnostics, size_t from);
+// files that could not be read and tasks that could not be parsed are skipped
+// and reported in the "diagnostics" array: {"files":[...],"diagnostics":[...]}
+//
+// with `flags.ndjson` every file is written in its own line as soon as it's
+// parsed, followed by one {"diagnostic":{...}} line per diagnostic of that file
+//
+// with `flags.include_archive` the archived files follow the database files,
+// with "archived":true and without locations
 void print_database_files_to_stdout_as_json(bool (*predicate)(wodo_task_t, Flags), Flags flags);
 
 #endif // !_WODO_JSON_H_
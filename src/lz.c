@@ -0,0 +1,167 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_MAX_OFFSET 65535
+// like LZ4, the last bytes of a block are always literals
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+static inline uint32_t read32(const char *data) {
+    uint32_t value;
+
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+static inline uint32_t hash32(uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// 15 in the token, then 255 until the rest fits in a byte
+static char *write_length(char *out, size_t length) {
+    while (length >= 255) {
+        *out++ = (char)255;
+        length -= 255;
+    }
+
+    *out++ = (char)length;
+
+    return out;
+}
+
+static char *write_literals(char *out, const char *literals, size_t count, size_t match_length) {
+    char *token = out++;
+
+    *token = (char)(((count >= 15 ? 15 : count) << 4) | (match_length >= 15 ? 15 : match_length));
+
+    if (count >= 15) out = write_length(out, count - 15);
+
+    memcpy(out, literals, count);
+
+    return out + count;
+}
+
+size_t lz_compress_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lz_compress(const char *in, size_t size, char *out) {
+    assert(size < UINT32_MAX && "block too big to compress");
+
+    // position + 1 of the last 4 bytes with that hash, 0 is empty
+    uint32_t *table = calloc(1 << LZ_HASH_BITS, sizeof(uint32_t));
+    const char *end = in + size;
+    const char *match_limit = size > LZ_MATCH_LIMIT ? end - LZ_MATCH_LIMIT : in;
+    const char *cursor = in;
+    const char *anchor = in;
+    char *out_cursor = out;
+
+    while (cursor < match_limit) {
+        uint32_t sequence = read32(cursor);
+        uint32_t hash = hash32(sequence);
+        size_t candidate = table[hash];
+
+        table[hash] = (uint32_t)(cursor - in) + 1;
+
+        if (candidate == 0 || (size_t)(cursor - in) - (candidate - 1) > LZ_MAX_OFFSET || read32(in + candidate - 1) != sequence) {
+            cursor++;
+
+            continue;
+        }
+
+        const char *match = in + candidate - 1;
+        const char *match_end = cursor + LZ_MIN_MATCH;
+        const char *reference = match + LZ_MIN_MATCH;
+
+        while (match_end < end - LZ_LAST_LITERALS && *match_end == *reference) {
+            match_end++;
+            reference++;
+        }
+
+        size_t match_length = match_end - cursor - LZ_MIN_MATCH;
+        uint16_t offset = (uint16_t)(cursor - match);
+
+        out_cursor = write_literals(out_cursor, anchor, cursor - anchor, match_length);
+
+        *out_cursor++ = (char)(offset & 0xff);
+        *out_cursor++ = (char)(offset >> 8);
+
+        if (match_length >= 15) out_cursor = write_length(out_cursor, match_length - 15);
+
+        cursor = match_end;
+        anchor = cursor;
+    }
+
+    // the last sequence has no match
+    out_cursor = write_literals(out_cursor, anchor, end - anchor, 0);
+
+    free(table);
+
+    return out_cursor - out;
+}
+
+static bool read_length(const unsigned char **cursor, const unsigned char *end, size_t *length) {
+    unsigned char byte;
+
+    do {
+        if (*cursor >= end) return false;
+
+        byte = *(*cursor)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+bool lz_decompress(const char *in, size_t size, char *out, size_t out_size) {
+    const unsigned char *cursor = (const unsigned char *)in;
+    const unsigned char *end = cursor + size;
+    char *out_cursor = out;
+    char *out_end = out + out_size;
+
+    while (cursor < end) {
+        unsigned token = *cursor++;
+        size_t literals = token >> 4;
+
+        if (literals == 15 && !read_length(&cursor, end, &literals)) return false;
+
+        if (literals > (size_t)(end - cursor) || literals > (size_t)(out_end - out_cursor)) return false;
+
+        memcpy(out_cursor, cursor, literals);
+        out_cursor += literals;
+        cursor += literals;
+
+        if (cursor == end) break;
+
+        if (end - cursor < 2) return false;
+
+        size_t offset = cursor[0] | (cursor[1] << 8);
+
+        cursor += 2;
+
+        if (offset == 0 || offset > (size_t)(out_cursor - out)) return false;
+
+        size_t length = token & 15;
+
+        if (length == 15 && !read_length(&cursor, end, &length)) return false;
+
+        length += LZ_MIN_MATCH;
+
+        if (length > (size_t)(out_end - out_cursor)) return false;
+
+        // the match can overlap the bytes it writes
+        const char *match = out_cursor - offset;
+
+        for (size_t i = 0; i < length; i++) out_cursor[i] = match[i];
+
+        out_cursor += length;
+    }
+
+    return out_cursor == out_end;
+}
@@ -0,0 +1,18 @@
+#ifndef _WODO_LZ_H_
+#define _WODO_LZ_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// LZ77 block compression in the LZ4 block format: every sequence is a token
+// (literals count << 4 | match length - 4), the literals and a 2 bytes offset
+// into the last 64KiB. Fast on both sides and good enough for task text.
+
+// the most `lz_compress` can write for `size` bytes
+size_t lz_compress_bound(size_t size);
+// returns the compressed size, `out` needs `lz_compress_bound(size)` bytes
+size_t lz_compress(const char *in, size_t size, char *out);
+// returns false when `in` is not a valid block of exactly `out_size` bytes
+bool lz_decompress(const char *in, size_t size, char *out, size_t out_size);
+
+#endif // !_WODO_LZ_H_
@@ -0,0 +1,451 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "msgpack.h"
+#include "arr.h"
+#include "visualizer.h"
+#include "database.h"
+#include "utils.h"
+#include "io.h"
+#include "parser.h"
+#include "trace.h"
+#include "taskid.h"
+#include "properties.h"
+
+// the output is built in memory because MessagePack needs the size of maps
+// and arrays before their items, and the amount of files is only known at the end
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Msgpack_Buffer;
+
+static void buffer_reserve(Msgpack_Buffer *buffer, size_t size) {
+    if (buffer->length + size <= buffer->capacity) return;
+
+    size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+
+    while (buffer->length + size > capacity) capacity *= 2;
+
+    buffer->data = realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+
+    assert(buffer->data != NULL && "buy more ram lol");
+}
+
+static void buffer_write(Msgpack_Buffer *buffer, const void *data, size_t size) {
+    buffer_reserve(buffer, size);
+
+    memcpy(buffer->data + buffer->length, data, size);
+    buffer->length += size;
+}
+
+static void buffer_flush(Msgpack_Buffer *buffer) {
+    fwrite(buffer->data, sizeof(char), buffer->length, stdout);
+
+    buffer->length = 0;
+}
+
+static void buffer_free(Msgpack_Buffer *buffer) {
+    free(buffer->data);
+
+    *buffer = (Msgpack_Buffer){0};
+}
+
+// type byte followed by `size` big endian bytes of `value`
+static void write_header(Msgpack_Buffer *buffer, uint8_t type, uint64_t value, int size) {
+    uint8_t bytes[9] = { type };
+
+    for (int i = 0; i < size; i++) {
+        bytes[size - i] = (uint8_t)(value >> (i * 8));
+    }
+
+    buffer_write(buffer, bytes, size + 1);
+}
+
+static void write_map(Msgpack_Buffer *buffer, uint32_t count) {
+    if (count < 16) write_header(buffer, 0x80 | count, 0, 0);
+    else if (count <= UINT16_MAX) write_header(buffer, 0xde, count, 2);
+    else write_header(buffer, 0xdf, count, 4);
+}
+
+static void write_array(Msgpack_Buffer *buffer, uint32_t count) {
+    if (count < 16) write_header(buffer, 0x90 | count, 0, 0);
+    else if (count <= UINT16_MAX) write_header(buffer, 0xdc, count, 2);
+    else write_header(buffer, 0xdd, count, 4);
+}
+
+static void write_string(Msgpack_Buffer *buffer, const char *value, size_t length) {
+    if (length < 32) write_header(buffer, 0xa0 | length, 0, 0);
+    else if (length <= UINT8_MAX) write_header(buffer, 0xd9, length, 1);
+    else if (length <= UINT16_MAX) write_header(buffer, 0xda, length, 2);
+    else write_header(buffer, 0xdb, length, 4);
+
+    buffer_write(buffer, value, length);
+}
+
+#define write_cstring(buffer, value) write_string((buffer), (value), strlen(value))
+
+static void write_int(Msgpack_Buffer *buffer, int64_t value) {
+    if (value >= 0 && value < 128) write_header(buffer, (uint8_t)value, 0, 0);
+    else if (value >= -32 && value < 0) write_header(buffer, (uint8_t)value, 0, 0);
+    else if (value >= INT32_MIN && value <= INT32_MAX) write_header(buffer, 0xd2, (uint32_t)value, 4);
+    else write_header(buffer, 0xd3, (uint64_t)value, 8);
+}
+
+static void write_bool(Msgpack_Buffer *buffer, bool value) {
+    write_header(buffer, value ? 0xc3 : 0xc2, 0, 0);
+}
+
+static void write_location(Msgpack_Buffer *buffer, wodo_location_t location) {
+    write_cstring(buffer, "location");
+    write_map(buffer, 2);
+    write_cstring(buffer, "line");
+    write_int(buffer, location.line);
+    write_cstring(buffer, "col");
+    write_int(buffer, location.col);
+}
+
+// {"content": <written by the caller>, "location": {...}}
+static void write_content_map(Msgpack_Buffer *buffer, bool has_location) {
+    write_map(buffer, has_location ? 2 : 1);
+    write_cstring(buffer, "content");
+}
+
+static void write_content_key(Msgpack_Buffer *buffer, const char *key, bool has_location) {
+    write_cstring(buffer, key);
+    write_content_map(buffer, has_location);
+}
+
+static const char *state_name(wodo_task_state_t state) {
+    switch (state) {
+        case Wodo_Task_State_Todo: return "todo";
+        case Wodo_Task_State_Doing: return "doing";
+        case Wodo_Task_State_Blocked: return "blocked";
+        case Wodo_Task_State_Done: return "done";
+        default: assert(0 && "unimplemented msgpack parsing state");
+    }
+
+    return NULL;
+}
+
+static void write_task(Msgpack_Buffer *buffer, wodo_task_t task, const char *id, Flags flags) {
+    bool locations = !flags.no_locations;
+    bool has_id = id != NULL && (flags.fields & WODO_FIELD_ID);
+
+    write_map(buffer, __builtin_popcount(flags.fields & ~WODO_FIELD_ID) + has_id);
+
+    if (has_id) {
+        write_cstring(buffer, "id");
+        write_cstring(buffer, id);
+    }
+
+    if (flags.fields & WODO_FIELD_TITLE) {
+        write_content_key(buffer, "title", locations);
+        write_string(buffer, task.title.string.value, task.title.string.length);
+
+        if (locations) write_location(buffer, task.title.location);
+    }
+
+    if (flags.fields & WODO_FIELD_STATE) {
+        bool has_location = locations && task.state_property.location.col != 0;
+
+        write_content_key(buffer, "state", has_location);
+        write_cstring(buffer, state_name(task.state_property.state));
+
+        if (has_location) write_location(buffer, task.state_property.location);
+    }
+
+    if (flags.fields & WODO_FIELD_DATE) {
+        char date[WODO_DATETIME_MAX_SIZE];
+        size_t date_size = format_wodo_datetime(date, task.date_property.datetime, false);
+
+        write_content_key(buffer, "date", locations);
+        write_string(buffer, date, date_size);
+
+        if (locations) write_location(buffer, task.date_property.location);
+    }
+
+    if (flags.fields & WODO_FIELD_TAGS) {
+        wodo_node_t *tags = task.tags_property.node_array;
+        bool has_location = locations && task.tags_property.location.col != 0;
+
+        write_content_key(buffer, "tags", has_location);
+        write_array(buffer, cl_arr_len(tags));
+
+        for (size_t i = 0; i < cl_arr_len(tags); i++) {
+            write_content_map(buffer, locations);
+            write_string(buffer, tags[i].string.value, tags[i].string.length);
+
+            if (locations) write_location(buffer, tags[i].location);
+        }
+
+        if (has_location) write_location(buffer, task.tags_property.location);
+    }
+
+    if (flags.fields & WODO_FIELD_REMIND) {
+        write_content_key(buffer, "remind", locations);
+        write_bool(buffer, task.remind_property.boolean);
+
+        // the JSON output uses the date location here as well
+        if (locations) write_location(buffer, task.date_property.location);
+    }
+
+    if (flags.fields & WODO_FIELD_DEPENDS) {
+        wodo_node_t *depends = task.depends_property.node_array;
+        bool has_location = locations && task.depends_property.location.col != 0;
+
+        write_content_key(buffer, "depends", has_location);
+        write_array(buffer, cl_arr_len(depends));
+
+        for (size_t i = 0; i < cl_arr_len(depends); i++) {
+            write_content_map(buffer, locations);
+            write_string(buffer, depends[i].string.value, depends[i].string.length);
+
+            if (locations) write_location(buffer, depends[i].location);
+        }
+
+        if (has_location) write_location(buffer, task.depends_property.location);
+    }
+
+    if (flags.fields & WODO_FIELD_PROPERTIES) {
+        write_cstring(buffer, "properties");
+        write_map(buffer, task.properties_count);
+
+        for (size_t i = 0; i < task.properties_count; i++) {
+            wodo_property_value_t it = task.properties[i];
+            const wodo_property_t *property = property_at(it.property);
+
+            write_content_key(buffer, property->name, locations);
+
+            // durations are in seconds, like the JSON output
+            if (property->type == Wodo_Property_Int || property->type == Wodo_Property_Duration) {
+                write_int(buffer, it.value);
+            } else {
+                char value[WODO_PROPERTY_VALUE_MAX_SIZE];
+                size_t size = format_property_value(value, property, it.value);
+
+                write_string(buffer, value, size);
+            }
+
+            if (locations) write_location(buffer, it.location);
+        }
+    }
+
+    if (flags.fields & WODO_FIELD_DESCRIPTION) {
+        wodo_string_t description = task.description.string;
+        bool has_location = locations && task.description.location.col != 0;
+
+        if (flags.description_preview >= 0) {
+            description.length = utf8_prefix_size(description, flags.description_preview);
+        }
+
+        write_content_key(buffer, "description", has_location);
+        write_string(buffer, description.value, description.length);
+
+        if (has_location) write_location(buffer, task.description.location);
+    }
+}
+
+static size_t count_tasks(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        if (predicate(tasks[i], flags)) count++;
+    }
+
+    return count;
+}
+
+static void write_tasks(Msgpack_Buffer *buffer, wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags, size_t count) {
+    Task_Id *ids = (flags.fields & WODO_FIELD_ID) ? compute_task_ids(tasks) : NULL;
+
+    write_array(buffer, count);
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        if (!predicate(tasks[i], flags)) continue;
+
+        write_task(buffer, tasks[i], ids == NULL ? NULL : ids[i].value, flags);
+    }
+
+    cl_arr_free(ids);
+}
+
+void print_tasks_to_stdout_as_msgpack(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags) {
+    TRACE_SCOPE("serialize");
+
+    Msgpack_Buffer buffer = {0};
+
+    write_tasks(&buffer, tasks, predicate, flags, count_tasks(tasks, predicate, flags));
+
+    buffer_flush(&buffer);
+    buffer_free(&buffer);
+}
+
+void print_tasks_to_stdout_as_msgpack_stream(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags) {
+    TRACE_SCOPE("serialize");
+
+    Msgpack_Buffer buffer = {0};
+    Task_Id *ids = (flags.fields & WODO_FIELD_ID) ? compute_task_ids(tasks) : NULL;
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        if (!predicate(tasks[i], flags)) continue;
+
+        write_task(&buffer, tasks[i], ids == NULL ? NULL : ids[i].value, flags);
+        buffer_flush(&buffer);
+        fflush(stdout);
+    }
+
+    cl_arr_free(ids);
+    buffer_free(&buffer);
+}
+
+void print_task_to_stdout_as_msgpack(wodo_task_t task, const char *id, Flags flags) {
+    Msgpack_Buffer buffer = {0};
+
+    write_task(&buffer, task, id, flags);
+    buffer_flush(&buffer);
+    buffer_free(&buffer);
+}
+
+static void write_diagnostic(Msgpack_Buffer *buffer, wodo_diagnostic_t diagnostic) {
+    write_map(buffer, 5);
+    write_cstring(buffer, "file");
+    write_cstring(buffer, diagnostic.filename);
+    write_cstring(buffer, "line");
+    write_int(buffer, diagnostic.location.line);
+    write_cstring(buffer, "col");
+    write_int(buffer, diagnostic.location.col);
+    write_cstring(buffer, "severity");
+    write_cstring(buffer, diagnostic.severity == Wodo_Diagnostic_Error ? "error" : "warning");
+    write_cstring(buffer, "message");
+    write_cstring(buffer, diagnostic.message);
+}
+
+// {"diagnostic":{...}} objects for every diagnostic after `from`
+static void write_diagnostics_stream(Msgpack_Buffer *buffer, wodo_diagnostic_t *diagnostics, size_t from) {
+    for (size_t i = from; i < cl_arr_len(diagnostics); i++) {
+        write_map(buffer, 1);
+        write_cstring(buffer, "diagnostic");
+        write_diagnostic(buffer, diagnostics[i]);
+    }
+}
+
+void print_database_files_to_stdout_as_msgpack(bool (*predicate)(wodo_task_t task, Flags), Flags flags) {
+    Msgpack_Buffer buffer = {0};
+    size_t files_count = 0;
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+    set_parser_options(parser_options_from_flags(flags));
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        Database_File *it = global_database.files[i];
+
+        TRACE_BEGIN_ARG("file", it->view_absolute_filepath);
+
+        int counts[4] = {0};
+        int total_count = 0;
+
+        size_t diagnostics_count = cl_arr_len(diagnostics);
+
+        char *content;
+        size_t length;
+
+        if (!read_from_file_no_quit(it->view_absolute_filepath, &content, &length)) {
+            push_diagnostic(&diagnostics, it->view_absolute_filepath, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+
+            if (flags.ndjson) {
+                write_diagnostics_stream(&buffer, diagnostics, diagnostics_count);
+                buffer_flush(&buffer);
+                fflush(stdout);
+            }
+
+            TRACE_END();
+
+            continue;
+        }
+
+        reset_parser_state();
+
+        wodo_task_t *tasks = parse_tasks_recovering(it->view_absolute_filepath, content, length, &diagnostics);
+
+        TRACE_BEGIN("filter");
+
+        for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+            wodo_task_t task = tasks[i];
+
+            if (!predicate(task, flags)) continue;
+
+            assert(task.state_property.state <= Wodo_Task_State_Done && "unhandled wodo state during files listing");
+
+            counts[task.state_property.state]++;
+            total_count++;
+        }
+
+        TRACE_END();
+
+        // files with tasks but none matching the filters are not listed
+        if (total_count > 0 || cl_arr_len(tasks) == 0) {
+            write_map(&buffer, 4);
+            write_cstring(&buffer, "name");
+            write_cstring(&buffer, it->name);
+            write_cstring(&buffer, "path");
+            write_cstring(&buffer, it->view_absolute_filepath);
+            write_cstring(&buffer, "states");
+            write_map(&buffer, 5);
+            write_cstring(&buffer, "total");
+            write_int(&buffer, total_count);
+            write_cstring(&buffer, "todo");
+            write_int(&buffer, counts[Wodo_Task_State_Todo]);
+            write_cstring(&buffer, "doing");
+            write_int(&buffer, counts[Wodo_Task_State_Doing]);
+            write_cstring(&buffer, "blocked");
+            write_int(&buffer, counts[Wodo_Task_State_Blocked]);
+            write_cstring(&buffer, "done");
+            write_int(&buffer, counts[Wodo_Task_State_Done]);
+            write_cstring(&buffer, "tasks");
+
+            TRACE_BEGIN("serialize");
+            write_tasks(&buffer, tasks, predicate, flags, total_count);
+            TRACE_END();
+
+            files_count++;
+        }
+
+        if (flags.ndjson) {
+            write_diagnostics_stream(&buffer, diagnostics, diagnostics_count);
+            buffer_flush(&buffer);
+            fflush(stdout);
+        }
+
+        free(content);
+        free_tasks(tasks);
+
+        TRACE_END();
+    }
+
+    if (!flags.ndjson) {
+        Msgpack_Buffer header = {0};
+
+        write_map(&header, 2);
+        write_cstring(&header, "files");
+        write_array(&header, files_count);
+        buffer_flush(&header);
+        buffer_free(&header);
+
+        // the files were kept in `buffer` until their count was known
+        write_cstring(&buffer, "diagnostics");
+        write_array(&buffer, cl_arr_len(diagnostics));
+
+        for (size_t i = 0; i < cl_arr_len(diagnostics); i++) {
+            write_diagnostic(&buffer, diagnostics[i]);
+        }
+
+        buffer_flush(&buffer);
+    }
+
+    buffer_free(&buffer);
+    free_diagnostics(&diagnostics);
+}
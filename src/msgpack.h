@@ -0,0 +1,21 @@
+#ifndef _WODO_MSGPACK_H_
+#define _WODO_MSGPACK_H_
+
+#include <stdbool.h>
+#include "systemtypes.h"
+#include "argparser.h"
+
+// MessagePack counterparts of json.h (--format msgpack). The structure is the
+// same as the JSON output, strings are written as is, without escaping.
+// `id` is only written when it's not NULL
+void print_task_to_stdout_as_msgpack(wodo_task_t task, const char *id, Flags flags);
+void print_tasks_to_stdout_as_msgpack(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags);
+// with `flags.ndjson` every task is written as its own MessagePack object
+void print_tasks_to_stdout_as_msgpack_stream(wodo_task_t *tasks, bool (*predicate)(wodo_task_t, Flags), Flags flags);
+// {"files":[...],"diagnostics":[...]}
+//
+// with `flags.ndjson` every file is written as its own object as soon as it's
+// parsed, followed by one {"diagnostic":{...}} object per diagnostic of that file
+void print_database_files_to_stdout_as_msgpack(bool (*predicate)(wodo_task_t, Flags), Flags flags);
+
+#endif // !_WODO_MSGPACK_H_
@@ -6,23 +6,54 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
 #include "parser.h"
 #include "arr.h"
 #include "date.h"
+#include "properties.h"
+#include "trace.h"
 
 #define task_beginning_character_descriptor '%'
 #define property_beginning_character_descriptor '.'
 
-static size_t       cursor = 0;
-static size_t       bot = 0;
-static int          line = 1;
-static int          col = 1;
-static char         *content = NULL;
-static size_t       content_length = 0;
-static wodo_task_t  *tasks = CL_ARRAY_INIT;
-static const char   *filename;
-
-static struct {
+// inputs from this size on are split in chunks parsed by several threads
+#define PARALLEL_PARSE_THRESHOLD (1 << 20)
+#define PARALLEL_PARSE_MAX_THREADS 16
+// the streaming parser reads its input in blocks of this size
+#define STREAM_READ_SIZE (64 * 1024)
+
+// the parser state is per thread, so big inputs can be parsed in chunks at
+// the same time. `content_length` is the end of the chunk being parsed and
+// `buffer_length` the end of the whole content
+static _Thread_local size_t       cursor = 0;
+static _Thread_local size_t       bot = 0;
+static _Thread_local int          line = 1;
+static _Thread_local int          col = 1;
+static _Thread_local char         *content = NULL;
+static _Thread_local size_t       content_length = 0;
+static _Thread_local size_t       buffer_length = 0;
+static _Thread_local wodo_task_t  *tasks = CL_ARRAY_INIT;
+static _Thread_local const char   *filename;
+
+static wodo_parser_options_t options = {0};
+
+// when it's not NULL the parser is in recovery mode: errors are recorded
+// here instead of quitting and the broken task is discarded
+static _Thread_local wodo_diagnostic_t **diagnostics = NULL;
+static _Thread_local jmp_buf      recover_point;
+// tags of the task being parsed, so they can be freed if the task is discarded
+static _Thread_local wodo_node_t  *pending_tags = CL_ARRAY_INIT;
+// same for the ids of `.depends`
+static _Thread_local wodo_node_t  *pending_depends = CL_ARRAY_INIT;
+// custom properties of the task being parsed, copied to the task once it's complete
+static _Thread_local wodo_property_value_t pending_properties[WODO_MAX_PROPERTIES];
+static _Thread_local size_t       pending_properties_count = 0;
+
+static _Thread_local struct {
     int length;
     int capacity;
     wodo_location_t stack[8];
@@ -47,13 +78,71 @@ static inline wodo_location_t pop_location_snapshot() {
     return location_snapshots.stack[--location_snapshots.length];
 }
 
+static void vpush_diagnostic(wodo_diagnostic_t **out, const char *diagnostic_filename, wodo_location_t location, wodo_diagnostic_severity_t severity, const char *fmt, va_list args) {
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    int size = vsnprintf(NULL, 0, fmt, args_copy);
+
+    va_end(args_copy);
+
+    char *message = malloc(size + 1);
+
+    if (message == NULL) {
+        fprintf(stderr, "fatal: could not allocate memory to diagnostic message\n");
+        exit(1);
+    }
+
+    vsnprintf(message, size + 1, fmt, args);
+
+    wodo_diagnostic_t diagnostic = {
+        .filename = diagnostic_filename,
+        .location = location,
+        .severity = severity,
+        .message = message
+    };
+
+    cl_arr_push(*out, diagnostic);
+}
+
+void push_diagnostic(wodo_diagnostic_t **out, const char *diagnostic_filename, wodo_location_t location, wodo_diagnostic_severity_t severity, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    vpush_diagnostic(out, diagnostic_filename, location, severity, fmt, args);
+
+    va_end(args);
+}
+
+void free_tasks(wodo_task_t *parsed) {
+    for (size_t i = 0; i < cl_arr_len(parsed); i++) {
+        cl_arr_free(parsed[i].tags_property.node_array);
+        cl_arr_free(parsed[i].depends_property.node_array);
+        free(parsed[i].properties);
+    }
+
+    cl_arr_free(parsed);
+}
+
+void free_diagnostics(wodo_diagnostic_t **out) {
+    for (size_t i = 0; i < cl_arr_len(*out); i++) {
+        free((*out)[i].message);
+    }
+
+    cl_arr_free(*out);
+}
+
 static inline void parser_error_no_quit(const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
 
-    fprintf(stderr, "%s:%d:%d error: ", filename, line, col);
-    vfprintf(stderr, fmt, args);
-    fprintf(stderr, "\n");
+    if (diagnostics != NULL) {
+        vpush_diagnostic(diagnostics, filename, (wodo_location_t){ .line = line, .col = col }, Wodo_Diagnostic_Warning, fmt, args);
+    } else {
+        fprintf(stderr, "%s:%d:%d error: ", filename, line, col);
+        vfprintf(stderr, fmt, args);
+        fprintf(stderr, "\n");
+    }
 
     va_end(args);
 }
@@ -62,6 +151,14 @@ static inline void parser_error(const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
 
+    if (diagnostics != NULL) {
+        vpush_diagnostic(diagnostics, filename, (wodo_location_t){ .line = line, .col = col }, Wodo_Diagnostic_Error, fmt, args);
+
+        va_end(args);
+
+        longjmp(recover_point, 1);
+    }
+
     printf("%s:%d:%d error: ", filename, line, col);
     vprintf(fmt, args);
     printf("\n");
@@ -165,6 +262,12 @@ static wodo_node_t *parse_task_tags_property(void) {
 
     if (is_empty()) return tags;
 
+    if (options.skip_tags) {
+        while (!is_empty() && chr() != '\n') advance_cursor();
+
+        return tags;
+    }
+
     // consume all tags
     while (!is_empty() && chr() != '\n') {
         bot = cursor;
@@ -174,6 +277,13 @@ static wodo_node_t *parse_task_tags_property(void) {
         // consume one tag
         while (!is_empty() && is_valid_tag(chr())) advance_cursor();
 
+        // nothing was consumed, the cursor would never move
+        if (cursor == bot) {
+            cl_arr_free(tags);
+
+            parser_error("invalid tag character '%c'", chr());
+        }
+
         wodo_node_t tag = {
             .location = pop_location_snapshot(),
             .string.value = &content[bot],
@@ -189,6 +299,30 @@ static wodo_node_t *parse_task_tags_property(void) {
     return tags;
 }
 
+// every word of the line is an id, repeated `.depends` lines add to the list.
+// The ids are only checked when the dependency graph is built
+static void parse_task_depends_property(void) {
+    while (!is_empty() && is_whitespace(chr())) advance_cursor();
+
+    while (!is_empty() && !is_linebreak(chr())) {
+        bot = cursor;
+
+        push_location_snapshot();
+
+        while (!is_empty() && !is_linebreak(chr()) && !is_whitespace(chr())) advance_cursor();
+
+        wodo_node_t id = {
+            .location = pop_location_snapshot(),
+            .string.value = &content[bot],
+            .string.length = cursor - bot
+        };
+
+        cl_arr_push(pending_depends, id);
+
+        while (!is_empty() && is_whitespace(chr())) advance_cursor();
+    }
+}
+
 static int parse_fixed_size_number_and_convert_to_int(int size) {
     bot = cursor;
 
@@ -211,6 +345,104 @@ static int parse_fixed_size_number_and_convert_to_int(int size) {
     return n;
 }
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SWAR_DATE 1
+#else
+#define SWAR_DATE 0
+#endif
+
+// byte `i` of a little endian 8 bytes block
+#define LANE(i) (0xFFULL << ((i) * 8))
+#define LANE_CHAR(c, i) ((uint64_t)(unsigned char)(c) << ((i) * 8))
+#define REPEAT_BYTE(b) (0x0101010101010101ULL * (b))
+
+static inline uint64_t load_block(const char *p) {
+    uint64_t block;
+
+    memcpy(&block, p, sizeof(block));
+
+    return block;
+}
+
+// every lane selected by `mask` is in '0'..'9'
+static inline bool block_has_digits(uint64_t block, uint64_t mask) {
+    // high nibble must be 3 and the low nibble must not overflow when adding 6
+    uint64_t high = (block & REPEAT_BYTE(0xF0)) ^ REPEAT_BYTE(0x30);
+    uint64_t low = ((block + REPEAT_BYTE(0x06)) & REPEAT_BYTE(0xF0)) ^ REPEAT_BYTE(0x30);
+
+    return ((high | low) & mask) == 0;
+}
+
+// two digits starting at lane `i` of a block already masked with 0x0F
+static inline int block_pair(uint64_t digits, int i) {
+    return (int)((digits >> (i * 8)) & 0xFF) * 10 + (int)((digits >> (i * 8 + 8)) & 0xFF);
+}
+
+// the canonical "YYYY-MM-DD HH:MM:SS+HH:MM" (or "...SSZ") form, 8 bytes at a time.
+// returns false without moving the cursor when the text is anything else, so
+// the byte by byte parser can produce the same diagnostics as always
+static bool parse_canonical_datetime(wodo_datetime_t *out) {
+    if (!SWAR_DATE || content_length - cursor < 24) return false;
+
+    const char *p = &content[cursor];
+
+    uint64_t date = load_block(p);       // YYYY-MM-
+    uint64_t time = load_block(p + 8);   // DD HH:MM
+    uint64_t tail = load_block(p + 16);  // :SS+HH:M or :SSZ
+
+    const uint64_t date_digits = LANE(0) | LANE(1) | LANE(2) | LANE(3) | LANE(5) | LANE(6);
+    const uint64_t time_digits = LANE(0) | LANE(1) | LANE(3) | LANE(4) | LANE(6) | LANE(7);
+
+    if ((date & (LANE(4) | LANE(7))) != (LANE_CHAR('-', 4) | LANE_CHAR('-', 7))) return false;
+    if ((time & (LANE(2) | LANE(5))) != (LANE_CHAR(' ', 2) | LANE_CHAR(':', 5))) return false;
+    if (!block_has_digits(date, date_digits) || !block_has_digits(time, time_digits)) return false;
+
+    char sign = p[19];
+    size_t size;
+
+    if (sign == 'Z') {
+        if ((tail & LANE(0)) != LANE_CHAR(':', 0) || !block_has_digits(tail, LANE(1) | LANE(2))) return false;
+
+        size = 20;
+    } else if (sign == '+' || sign == '-') {
+        if ((tail & (LANE(0) | LANE(6))) != (LANE_CHAR(':', 0) | LANE_CHAR(':', 6))) return false;
+        if (!block_has_digits(tail, LANE(1) | LANE(2) | LANE(4) | LANE(5) | LANE(7))) return false;
+
+        size = 25;
+
+        // the last digit is outside of the block and it must not be followed by another digit
+        if (content_length - cursor < size || !is_number(p[24])) return false;
+        if (content_length - cursor > size && is_number(p[25])) return false;
+    } else {
+        return false;
+    }
+
+    date &= REPEAT_BYTE(0x0F);
+    time &= REPEAT_BYTE(0x0F);
+    tail &= REPEAT_BYTE(0x0F);
+
+    *out = (wodo_datetime_t){
+        .year = block_pair(date, 0) * 100 + block_pair(date, 2),
+        .month = block_pair(date, 5),
+        .day = block_pair(time, 0),
+        .hour = block_pair(time, 3),
+        .minute = block_pair(time, 6),
+        .second = block_pair(tail, 1),
+    };
+
+    if (sign != 'Z') {
+        int offset = block_pair(tail, 4) * 60 + (int)(tail >> 56) * 10 + (p[24] - '0');
+
+        out->tz_offset = sign == '-' ? -offset : offset;
+    }
+
+    // there are no line breaks in the date
+    cursor += size;
+    col += size;
+
+    return true;
+}
+
 static wodo_datetime_t parse_task_date_property(void) {
     // skip whitespaces
     while (!is_empty() && is_whitespace(chr())) advance_cursor();
@@ -219,6 +451,15 @@ static wodo_datetime_t parse_task_date_property(void) {
         parser_error("reached EOF before defining 'date' property");
     }
 
+    wodo_datetime_t canonical;
+
+    if (parse_canonical_datetime(&canonical)) {
+        if (!validate_datetime(canonical))
+            parser_error("couldn't parse 'date' property correctly because the datetime informed is invalid");
+
+        return canonical;
+    }
+
     // start parsing date
     int year = parse_fixed_size_number_and_convert_to_int(4);
     if (year == -1) parser_error("couldn't parse 'date' property correctly");
@@ -286,6 +527,79 @@ static wodo_datetime_t parse_task_date_property(void) {
     return datetime;
 }
 
+typedef enum {
+    Builtin_Property_None = 0,
+    Builtin_Property_State,
+    Builtin_Property_Tags,
+    Builtin_Property_Date,
+    Builtin_Property_Remind,
+    Builtin_Property_Depends,
+} Builtin_Property;
+
+// perfect hash of the built-in property names, they all land on different
+// slots, so a name is looked up with one load and one memcmp. A new built-in
+// that collides shows up as an "initialized field overwritten" warning
+#define BUILTIN_PROPERTY_SLOT(length, first, last) (((length) * 3 + (first) + (last)) & 15)
+
+static const struct {
+    const char *name;
+    size_t length;
+    Builtin_Property kind;
+} builtin_properties[16] = {
+    [BUILTIN_PROPERTY_SLOT(5, 's', 'e')] = { "state", 5, Builtin_Property_State },
+    [BUILTIN_PROPERTY_SLOT(4, 't', 's')] = { "tags", 4, Builtin_Property_Tags },
+    [BUILTIN_PROPERTY_SLOT(4, 'd', 'e')] = { "date", 4, Builtin_Property_Date },
+    [BUILTIN_PROPERTY_SLOT(6, 'r', 'd')] = { "remind", 6, Builtin_Property_Remind },
+    [BUILTIN_PROPERTY_SLOT(7, 'd', 's')] = { "depends", 7, Builtin_Property_Depends },
+};
+
+static inline Builtin_Property find_builtin_property(const char *name, size_t length) {
+    if (length == 0) return Builtin_Property_None;
+
+    size_t slot = BUILTIN_PROPERTY_SLOT(length, (unsigned char)name[0], (unsigned char)name[length - 1]);
+
+    if (builtin_properties[slot].length != length || memcmp(builtin_properties[slot].name, name, length) != 0) return Builtin_Property_None;
+
+    return builtin_properties[slot].kind;
+}
+
+// the value is the rest of the line, a repeated property keeps the last value
+static void parse_task_custom_property(uint32_t property, wodo_location_t location) {
+    const wodo_property_t *declared = property_at(property);
+
+    while (!is_empty() && is_whitespace(chr())) advance_cursor();
+
+    bot = cursor;
+
+    while (!is_empty() && !is_linebreak(chr())) advance_cursor();
+
+    size_t length = cursor - bot;
+
+    while (length > 0 && is_whitespace(content[bot + length - 1])) length--;
+
+    int64_t value;
+
+    if (!parse_property_value(declared, &content[bot], length, &value)) {
+        parser_error("invalid %s value '%.*s' for property '%s'", property_type_name(declared->type), (int)length, &content[bot], declared->name);
+    }
+
+    // insertion keeps them sorted by property
+    size_t i = 0;
+
+    while (i < pending_properties_count && pending_properties[i].property < property) i++;
+
+    if (i == pending_properties_count || pending_properties[i].property != property) {
+        memmove(&pending_properties[i + 1], &pending_properties[i], (pending_properties_count - i) * sizeof(wodo_property_value_t));
+        pending_properties_count++;
+    }
+
+    pending_properties[i] = (wodo_property_value_t){
+        .location = location,
+        .value = value,
+        .property = property,
+    };
+}
+
 static wodo_task_t parse_task() {
     wodo_task_t task = {0};
 
@@ -304,7 +618,7 @@ static wodo_task_t parse_task() {
     push_location_snapshot();
 
     // consume task title
-    while (!is_linebreak(chr())) advance_cursor();
+    while (!is_empty() && !is_linebreak(chr())) advance_cursor();
 
     task.title = (wodo_node_t){
         .location = pop_location_snapshot(),
@@ -315,9 +629,12 @@ static wodo_task_t parse_task() {
     // advance until next instruction
     while (!is_empty() && (is_whitespace(chr()) || is_linebreak(chr()))) advance_cursor();
 
-    if (is_empty()) parser_error("reached EOF before defining required property 'date'");
+    // the end of a chunk is always followed by the next task
+    bool at_chunk_end = is_empty() && content_length < buffer_length;
 
-    if (chr() == task_beginning_character_descriptor && is_bol()) {
+    if (is_empty() && !at_chunk_end) parser_error("reached EOF before defining required property 'date'");
+
+    if (at_chunk_end || (chr() == task_beginning_character_descriptor && is_bol())) {
         parser_error("starting another task without defining required property 'date'");
     } else if (chr() != property_beginning_character_descriptor || !is_bol()) {
         parser_error("starting task description before defining required property 'date'");
@@ -338,37 +655,58 @@ static wodo_task_t parse_task() {
         const char *s_property_name = &content[bot];
         size_t s_property_size = cursor - bot;
 
-        if (str_slice_eq(s_property_name, s_property_size, "state")) {
-            wodo_task_state_t state = parse_task_state_property();
-
-            parsed_state_property = true;
-            task.state_property = (wodo_node_t){
-                .location = pop_location_snapshot(),
-                .state = state
-            };
-        } else if (str_slice_eq(s_property_name, s_property_size, "tags")) {
-            wodo_node_t *tags = parse_task_tags_property();
-
-            parsed_tags_property = true;
-            task.tags_property = (wodo_node_t){
-                .location = pop_location_snapshot(),
-                .node_array = tags
-            };
-        } else if (str_slice_eq(s_property_name, s_property_size, "date")) {
-            wodo_datetime_t date = parse_task_date_property();
-
-            parsed_date_property = true;
-            task.date_property = (wodo_node_t){
-                .location = pop_location_snapshot(),
-                .datetime = date,
-            };
-        } else if (str_slice_eq(s_property_name, s_property_size, "remind")) {
-            task.remind_property = (wodo_node_t){
-                .location = pop_location_snapshot(),
-                .boolean = true
-            };
-        } else {
-            parser_error_no_quit("invalid property name '%.*s'", (int)s_property_size, s_property_name);
+        switch (find_builtin_property(s_property_name, s_property_size)) {
+            case Builtin_Property_State: {
+                wodo_task_state_t state = parse_task_state_property();
+
+                parsed_state_property = true;
+                task.state_property = (wodo_node_t){
+                    .location = pop_location_snapshot(),
+                    .state = state
+                };
+            } break;
+            case Builtin_Property_Tags: {
+                wodo_node_t *tags = parse_task_tags_property();
+
+                pending_tags = tags;
+                parsed_tags_property = true;
+                task.tags_property = (wodo_node_t){
+                    .location = pop_location_snapshot(),
+                    .node_array = tags
+                };
+            } break;
+            case Builtin_Property_Date: {
+                wodo_datetime_t date = parse_task_date_property();
+
+                parsed_date_property = true;
+                task.date_property = (wodo_node_t){
+                    .location = pop_location_snapshot(),
+                    .datetime = date,
+                };
+            } break;
+            case Builtin_Property_Remind: {
+                task.remind_property = (wodo_node_t){
+                    .location = pop_location_snapshot(),
+                    .boolean = true
+                };
+            } break;
+            case Builtin_Property_Depends: {
+                wodo_location_t location = pop_location_snapshot();
+
+                // the first line is the location of the property
+                if (task.depends_property.location.line == 0) task.depends_property.location = location;
+
+                parse_task_depends_property();
+            } break;
+            case Builtin_Property_None: {
+                int property = find_property(s_property_name, s_property_size);
+
+                if (property < 0) {
+                    parser_error_no_quit("invalid property name '%.*s'", (int)s_property_size, s_property_name);
+                } else {
+                    parse_task_custom_property(property, pop_location_snapshot());
+                }
+            } break;
         }
 
         // skip empty lines and white spaces
@@ -387,8 +725,49 @@ static wodo_task_t parse_task() {
             .node_array = CL_ARRAY_INIT
         };
 
+    // only the complete tasks get their own copy, sized to fit
+    if (pending_properties_count > 0) {
+        task.properties = malloc(pending_properties_count * sizeof(wodo_property_value_t));
+        task.properties_count = pending_properties_count;
+
+        memcpy(task.properties, pending_properties, pending_properties_count * sizeof(wodo_property_value_t));
+
+        pending_properties_count = 0;
+    }
+
+    task.depends_property.node_array = pending_depends;
+
     bot = cursor;
 
+    if (options.skip_description) {
+        // jump to the next task line by line, without looking at the description
+        while (!is_empty() && !(is_bol() && chr() == task_beginning_character_descriptor)) {
+            const char *linebreak = memchr(&content[cursor], '\n', content_length - cursor);
+
+            if (linebreak == NULL) {
+                col += content_length - cursor;
+                cursor = content_length;
+
+                break;
+            }
+
+            cursor = linebreak - content + 1;
+            line++;
+            col = 1;
+        }
+
+        task.description = (wodo_node_t){
+            .location = {0},
+            .string.value = NULL,
+            .string.length = 0
+        };
+
+        pending_tags = CL_ARRAY_INIT;
+        pending_depends = CL_ARRAY_INIT;
+
+        return task;
+    }
+
     // parse task description
     
     bool has_description_text = false;
@@ -427,17 +806,17 @@ static wodo_task_t parse_task() {
     // discard empty line description location
     if (has_description_text) pop_location_snapshot();
 
+    pending_tags = CL_ARRAY_INIT;
+    pending_depends = CL_ARRAY_INIT;
+
     return task;
 }
 
-/*
- * returns a CL_ARRAY
- */
-wodo_task_t *parse_tasks(const char *content_filename, const char *file_content, size_t length) {
-    filename = content_filename;
-    content = (char*)file_content;
-    content_length = length;
+void set_parser_options(wodo_parser_options_t parser_options) {
+    options = parser_options;
+}
 
+static void parse_tasks_until_eof(void) {
     while (!is_empty()) {
         switch (chr()) {
             case task_beginning_character_descriptor: {
@@ -454,10 +833,336 @@ wodo_task_t *parse_tasks(const char *content_filename, const char *file_content,
                 break;
         }
     }
+}
+
+// parses content[cursor..content_length), recording errors in `diagnostics`
+static void parse_tasks_until_eof_recovering(void) {
+    // `parser_error` jumps back here after recording the diagnostic
+    if (setjmp(recover_point) != 0) {
+        cl_arr_free(pending_tags);
+        cl_arr_free(pending_depends);
+        pending_properties_count = 0;
+        location_snapshots.length = 0;
+
+        // resynchronize at the next task
+        while (!is_empty() && !(is_bol() && chr() == task_beginning_character_descriptor)) advance_cursor();
+    }
+
+    parse_tasks_until_eof();
+}
+
+typedef struct {
+    const char *filename;
+    const char *content;
+    size_t length;
+    // the chunk, it starts at the beginning of a task (or of the content)
+    size_t start, end;
+    int line;
+    wodo_task_t *tasks;
+    wodo_diagnostic_t *diagnostics;
+} Parse_Chunk;
+
+static void *parse_chunk(void *arg) {
+    Parse_Chunk *chunk = arg;
+
+    TRACE_SCOPE("parse_chunk");
+
+    reset_parser_state();
+
+    filename = chunk->filename;
+    content = (char*)chunk->content;
+    buffer_length = chunk->length;
+    cursor = chunk->start;
+    content_length = chunk->end;
+    line = chunk->line;
+    diagnostics = &chunk->diagnostics;
+
+    parse_tasks_until_eof_recovering();
+
+    chunk->tasks = tasks;
+
+    reset_parser_state();
+
+    return NULL;
+}
+
+// 1 when the content should be parsed on the calling thread only
+static size_t parse_threads_count(size_t length) {
+    if (length < PARALLEL_PARSE_THRESHOLD) return 1;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t count = cpus > 1 ? (size_t)cpus : 1;
+
+    // chunks smaller than a quarter of the threshold are not worth a thread
+    size_t by_size = length / (PARALLEL_PARSE_THRESHOLD / 4);
+
+    if (count > by_size) count = by_size;
+    if (count > PARALLEL_PARSE_MAX_THREADS) count = PARALLEL_PARSE_MAX_THREADS;
+
+    return count;
+}
+
+static size_t count_lines(const char *text, size_t length) {
+    size_t count = 0;
+    const char *end = text + length;
+
+    while ((text = memchr(text, '\n', end - text)) != NULL) {
+        count++;
+        text++;
+    }
+
+    return count;
+}
+
+// the first '%' at the beginning of a line after `text`, NULL when there is none
+static const char *find_task_boundary(const char *text, const char *end) {
+    while ((text = memchr(text, '\n', end - text)) != NULL) {
+        text++;
+
+        if (text < end && *text == task_beginning_character_descriptor) return text;
+    }
+
+    return NULL;
+}
+
+void task_byte_range(const char *file_content, size_t length, wodo_task_t task, size_t *start, size_t *end) {
+    size_t at = task.title.string.value - file_content;
+
+    while (at > 0 && file_content[at - 1] != '\n') at--;
+
+    const char *next = find_task_boundary(file_content + at, file_content + length);
+
+    *start = at;
+    *end = next == NULL ? length : (size_t)(next - file_content);
+}
+
+// splits the content at "\n%" in about `count` chunks and parses them at the
+// same time. The tasks are appended to `tasks` and the diagnostics to
+// `out_diagnostics`, both in the order of the content
+static void parse_tasks_parallel(const char *content_filename, const char *file_content, size_t length, size_t count, wodo_diagnostic_t **out_diagnostics) {
+    TRACE_SCOPE_ARG("parse_tasks_parallel", content_filename);
+
+    Parse_Chunk *chunks = calloc(count, sizeof(Parse_Chunk));
+    pthread_t *threads = calloc(count, sizeof(pthread_t));
+    bool *started = calloc(count, sizeof(bool));
+    size_t chunks_count = 0;
+    size_t start = 0;
+    int start_line = 1;
+
+    while (start < length) {
+        size_t end = length;
+
+        if (chunks_count + 1 < count) {
+            size_t target = start + (length - start) / (count - chunks_count);
+            const char *boundary = find_task_boundary(file_content + target, file_content + length);
+
+            if (boundary != NULL) end = boundary - file_content;
+        }
+
+        chunks[chunks_count++] = (Parse_Chunk){
+            .filename = content_filename,
+            .content = file_content,
+            .length = length,
+            .start = start,
+            .end = end,
+            .line = start_line,
+            .tasks = CL_ARRAY_INIT,
+            .diagnostics = CL_ARRAY_INIT,
+        };
+
+        start_line += (int)count_lines(file_content + start, end - start);
+        start = end;
+    }
+
+    // the first chunk is parsed by this thread
+    for (size_t i = 1; i < chunks_count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, parse_chunk, &chunks[i]) == 0;
+    }
+
+    wodo_task_t *previous_tasks = tasks;
+
+    for (size_t i = 0; i < chunks_count; i++) {
+        if (i == 0 || !started[i]) {
+            parse_chunk(&chunks[i]);
+        } else {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    tasks = previous_tasks;
+
+    for (size_t i = 0; i < chunks_count; i++) {
+        for (size_t j = 0; j < cl_arr_len(chunks[i].tasks); j++) cl_arr_push(tasks, chunks[i].tasks[j]);
+        for (size_t j = 0; j < cl_arr_len(chunks[i].diagnostics); j++) cl_arr_push(*out_diagnostics, chunks[i].diagnostics[j]);
+
+        cl_arr_free(chunks[i].tasks);
+        cl_arr_free(chunks[i].diagnostics);
+    }
+
+    free(chunks);
+    free(threads);
+    free(started);
+}
+
+/*
+ * returns a CL_ARRAY
+ */
+wodo_task_t *parse_tasks(const char *content_filename, const char *file_content, size_t length) {
+    TRACE_SCOPE_ARG("parse_tasks", content_filename);
+
+    size_t threads_count = parse_threads_count(length);
+
+    if (threads_count > 1) {
+        wodo_diagnostic_t *chunk_diagnostics = CL_ARRAY_INIT;
+
+        parse_tasks_parallel(content_filename, file_content, length, threads_count, &chunk_diagnostics);
+
+        // report like the sequential parser would: the warnings until the
+        // first error, then the error
+        for (size_t i = 0; i < cl_arr_len(chunk_diagnostics); i++) {
+            wodo_diagnostic_t diagnostic = chunk_diagnostics[i];
+
+            if (diagnostic.severity == Wodo_Diagnostic_Error) {
+                printf("%s:%d:%d error: %s\n", content_filename, diagnostic.location.line, diagnostic.location.col, diagnostic.message);
+
+                exit(1);
+            }
+
+            fprintf(stderr, "%s:%d:%d error: %s\n", content_filename, diagnostic.location.line, diagnostic.location.col, diagnostic.message);
+        }
+
+        free_diagnostics(&chunk_diagnostics);
+
+        return tasks;
+    }
+
+    filename = content_filename;
+    content = (char*)file_content;
+    content_length = length;
+    buffer_length = length;
+
+    parse_tasks_until_eof();
+
+    return tasks;
+}
+
+/*
+ * returns a CL_ARRAY
+ */
+wodo_task_t *parse_tasks_recovering(const char *content_filename, const char *file_content, size_t length, wodo_diagnostic_t **out_diagnostics) {
+    TRACE_SCOPE_ARG("parse_tasks", content_filename);
+
+    size_t threads_count = parse_threads_count(length);
+
+    if (threads_count > 1) {
+        parse_tasks_parallel(content_filename, file_content, length, threads_count, out_diagnostics);
+
+        return tasks;
+    }
+
+    filename = content_filename;
+    content = (char*)file_content;
+    content_length = length;
+    buffer_length = length;
+    diagnostics = out_diagnostics;
+
+    parse_tasks_until_eof_recovering();
+
+    diagnostics = NULL;
 
     return tasks;
 }
 
+// parses window[start..end), the tasks of one span, and passes them to `emit`
+static void parse_stream_span(char *window, size_t start, size_t end, size_t length, int start_line, void (*emit)(wodo_task_t task, void *data), void *data) {
+    content = window;
+    cursor = start;
+    content_length = end;
+    buffer_length = length;
+    line = start_line;
+    col = 1;
+
+    parse_tasks_until_eof();
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) emit(tasks[i], data);
+
+    free_tasks(tasks);
+    tasks = CL_ARRAY_INIT;
+}
+
+bool parse_tasks_stream(const char *content_filename, int fd, void (*emit)(wodo_task_t task, void *data), void *data) {
+    TRACE_SCOPE_ARG("parse_tasks_stream", content_filename);
+
+    // window[start..length) are the bytes not parsed yet, they begin at a
+    // task (or at the beginning of the input)
+    char *window = NULL;
+    size_t capacity = 0;
+    size_t start = 0;
+    size_t length = 0;
+    // window[start..scanned) has no "\n%"
+    size_t scanned = 0;
+    int start_line = 1;
+
+    filename = content_filename;
+
+    while (true) {
+        // the '\n' right before `scanned` may be followed by the '%' just read
+        size_t from = scanned > start ? scanned - 1 : start;
+        const char *boundary = window == NULL ? NULL : find_task_boundary(window + from, window + length);
+
+        if (boundary != NULL) {
+            size_t end = boundary - window;
+
+            parse_stream_span(window, start, end, length, start_line, emit, data);
+
+            start_line += (int)count_lines(window + start, end - start);
+            start = end;
+            scanned = end;
+
+            continue;
+        }
+
+        scanned = length;
+
+        // the unparsed bytes move to the beginning, so the window only grows
+        // for a task bigger than it
+        if (start > 0) {
+            memmove(window, window + start, length - start);
+
+            length -= start;
+            scanned -= start;
+            start = 0;
+        }
+
+        if (capacity - length < STREAM_READ_SIZE) {
+            capacity = capacity == 0 ? 2 * STREAM_READ_SIZE : capacity * 2;
+            window = realloc(window, capacity);
+        }
+
+        ssize_t size = read(fd, window + length, capacity - length);
+
+        if (size < 0 && errno == EINTR) continue;
+
+        if (size < 0) {
+            free(window);
+            reset_parser_state();
+
+            return false;
+        }
+
+        if (size == 0) break;
+
+        length += size;
+    }
+
+    if (start < length) parse_stream_span(window, start, length, length, start_line, emit, data);
+
+    free(window);
+    reset_parser_state();
+
+    return true;
+}
+
 void reset_parser_state(void) {
     cursor = 0;
     bot = 0;
@@ -465,7 +1170,12 @@ void reset_parser_state(void) {
     col = 1;
     content = NULL;
     content_length = 0;
+    buffer_length = 0;
     filename = NULL;
     tasks = CL_ARRAY_INIT;
+    diagnostics = NULL;
+    pending_tags = CL_ARRAY_INIT;
+    pending_depends = CL_ARRAY_INIT;
+    pending_properties_count = 0;
     location_snapshots.length = 0;
 }
@@ -1,9 +1,34 @@
 #ifndef _WODO_PARSER_H_
 #define _WODO_PARSER_H_
 #include <stddef.h>
+#include <stdbool.h>
 #include "systemtypes.h"
 
+typedef struct {
+    // leaves `tags_property.node_array` empty
+    bool skip_tags;
+    // leaves `description` empty and does not track its location
+    bool skip_description;
+} wodo_parser_options_t;
+
+// the options are kept until they are changed, `reset_parser_state` does not reset them
+void set_parser_options(wodo_parser_options_t options);
 wodo_task_t *parse_tasks(const char *filename, const char *content, size_t length);
+// does not quit on errors, every error is pushed to `diagnostics` (CL_ARRAY)
+// and the broken task is skipped until the next '%' at the beginning of a line
+wodo_task_t *parse_tasks_recovering(const char *filename, const char *content, size_t length, wodo_diagnostic_t **diagnostics);
 void reset_parser_state(void);
+// parses `fd` through a window that only keeps the task being parsed: every
+// task is passed to `emit` once the next one starts (or the input ends) and is
+// freed right after, so the memory is bounded by the biggest task instead of
+// the input. Errors quit like `parse_tasks`, returns false when `fd` can't be read
+bool parse_tasks_stream(const char *filename, int fd, void (*emit)(wodo_task_t task, void *data), void *data);
+// bytes of `task` in the content it was parsed from: from the beginning of its
+// '%' line to the next '%' at the beginning of a line, or the end of the content
+void task_byte_range(const char *content, size_t length, wodo_task_t task, size_t *start, size_t *end);
+void push_diagnostic(wodo_diagnostic_t **diagnostics, const char *filename, wodo_location_t location, wodo_diagnostic_severity_t severity, const char *fmt, ...);
+void free_diagnostics(wodo_diagnostic_t **diagnostics);
+// frees the tasks returned by the parser with what every task owns
+void free_tasks(wodo_task_t *tasks);
 
 #endif // !_WODO_PARSER_H_
@@ -0,0 +1,563 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "pick.h"
+#include "arr.h"
+#include "database.h"
+#include "search.h"
+#include "utils.h"
+#include "trace.h"
+
+/*
+ * Scoring follows fzf's v2 algorithm: a match is worth SCORE_MATCH plus a
+ * bonus that depends on the character before it (start of a word, camel
+ * case, after a delimiter...), gaps between matched characters cost
+ * something and consecutive matches keep the bonus of the first one.
+ */
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+#define BONUS_BOUNDARY (SCORE_MATCH / 2)
+#define BONUS_NON_WORD (SCORE_MATCH / 2)
+#define BONUS_CAMEL_123 (BONUS_BOUNDARY + SCORE_GAP_EXTENSION)
+#define BONUS_CONSECUTIVE (-(SCORE_GAP_START + SCORE_GAP_EXTENSION))
+#define BONUS_BOUNDARY_WHITE (BONUS_BOUNDARY + 2)
+#define BONUS_BOUNDARY_DELIMITER (BONUS_BOUNDARY + 1)
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+
+// longer terms are cut, nobody types that much in a picker
+#define MAX_TERM_SIZE 64
+
+typedef enum {
+    CC_WHITE,
+    CC_NON_WORD,
+    CC_DELIMITER,
+    CC_LOWER,
+    CC_UPPER,
+    CC_NUMBER,
+} Char_Class;
+
+typedef struct {
+    char pattern[MAX_TERM_SIZE];
+    size_t length;
+    // smart case, a term with an upper case letter is matched as it is
+    bool case_sensitive;
+} Pick_Term;
+
+typedef struct {
+    wodo_string_t text;
+    size_t item;                // index in the picked list
+    int score;
+} Pick_Candidate;
+
+// matrices of the dynamic programming, reused between candidates
+typedef struct {
+    int *scores;
+    int *consecutive;
+    int *bonuses;
+    size_t capacity;
+} Pick_Scratch;
+
+static Char_Class char_class(unsigned char c) {
+    if (c >= 'a' && c <= 'z') return CC_LOWER;
+    if (c >= 'A' && c <= 'Z') return CC_UPPER;
+    if (c >= '0' && c <= '9') return CC_NUMBER;
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') return CC_WHITE;
+    if (c == '/' || c == ',' || c == ':' || c == ';' || c == '|' || c == '-' || c == '_') return CC_DELIMITER;
+    // UTF-8 sequences are treated as letters
+    if (c >= 0x80) return CC_LOWER;
+
+    return CC_NON_WORD;
+}
+
+static int bonus_for(Char_Class previous, Char_Class current) {
+    if (current >= CC_LOWER) {
+        switch (previous) {
+            case CC_WHITE: return BONUS_BOUNDARY_WHITE;
+            case CC_DELIMITER: return BONUS_BOUNDARY_DELIMITER;
+            case CC_NON_WORD: return BONUS_BOUNDARY;
+            default: break;
+        }
+    }
+
+    if ((previous == CC_LOWER && current == CC_UPPER) || (previous != CC_NUMBER && current == CC_NUMBER)) {
+        return BONUS_CAMEL_123;
+    }
+
+    if (current == CC_WHITE) return BONUS_BOUNDARY_WHITE;
+    if (current == CC_NON_WORD || current == CC_DELIMITER) return BONUS_NON_WORD;
+
+    return 0;
+}
+
+static inline unsigned char fold_ascii(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static inline unsigned char term_char(const Pick_Term *term, unsigned char c) {
+    return term->case_sensitive ? c : fold_ascii(c);
+}
+
+// index of the first `c` (in either case, when `upper` differs) at or after
+// `from`, `length` when there is none
+static size_t find_char(const char *text, size_t from, size_t length, unsigned char lower, unsigned char upper) {
+    size_t i = from;
+
+#ifdef __SSE2__
+    const __m128i lower_vector = _mm_set1_epi8((char)lower);
+    const __m128i upper_vector = _mm_set1_epi8((char)upper);
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i equal = _mm_or_si128(_mm_cmpeq_epi8(block, lower_vector), _mm_cmpeq_epi8(block, upper_vector));
+        int mask = _mm_movemask_epi8(equal);
+
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; i < length; i++) {
+        unsigned char c = text[i];
+
+        if (c == lower || c == upper) return i;
+    }
+
+    return length;
+}
+
+// the term must be a subsequence of the text. On success `first` is where its
+// first character can start and `last` is the last position its final
+// character can be at, the scoring only looks at that window
+static bool prefilter(const Pick_Term *term, wodo_string_t text, size_t *first, size_t *last, size_t *starts) {
+    size_t at = 0;
+
+    for (size_t i = 0; i < term->length; i++) {
+        unsigned char lower = term->pattern[i];
+        unsigned char upper = term->case_sensitive ? lower : (lower >= 'a' && lower <= 'z' ? lower - ('a' - 'A') : lower);
+
+        at = find_char(text.value, at, text.length, lower, upper);
+
+        if (at == text.length) return false;
+
+        starts[i] = at;
+        at++;
+    }
+
+    *first = starts[0];
+
+    unsigned char final = term->pattern[term->length - 1];
+
+    for (size_t i = text.length; i-- > 0;) {
+        if (term_char(term, text.value[i]) == final) {
+            *last = i;
+
+            break;
+        }
+    }
+
+    return true;
+}
+
+static void scratch_reserve(Pick_Scratch *scratch, size_t cells, size_t width) {
+    size_t needed = cells > width ? cells : width;
+
+    if (needed <= scratch->capacity) return;
+
+    scratch->capacity = needed * 2;
+    scratch->scores = realloc(scratch->scores, sizeof(int) * scratch->capacity);
+    scratch->consecutive = realloc(scratch->consecutive, sizeof(int) * scratch->capacity);
+    scratch->bonuses = realloc(scratch->bonuses, sizeof(int) * scratch->capacity);
+
+    assert(scratch->scores != NULL && scratch->consecutive != NULL && scratch->bonuses != NULL && "buy more ram lol");
+}
+
+// score of the best alignment of the term in the text, -1 when it does not
+// match. The matched byte offsets are pushed to `positions` when it's not NULL
+static int score_term(const Pick_Term *term, wodo_string_t text, Pick_Scratch *scratch, size_t **positions) {
+    size_t starts[MAX_TERM_SIZE];
+    size_t first = 0, last = 0;
+
+    if (!prefilter(term, text, &first, &last, starts)) return -1;
+
+    size_t width = last - first + 1;
+    size_t rows = term->length;
+
+    scratch_reserve(scratch, rows * width, width);
+
+    int *H = scratch->scores;
+    int *C = scratch->consecutive;
+    int *B = scratch->bonuses;
+
+    Char_Class previous = first == 0 ? CC_WHITE : char_class(text.value[first - 1]);
+
+    for (size_t j = 0; j < width; j++) {
+        Char_Class current = char_class(text.value[first + j]);
+
+        B[j] = bonus_for(previous, current);
+        previous = current;
+    }
+
+    // first row, where every occurrence of the first character starts a match
+    bool in_gap = false;
+    int previous_score = 0;
+
+    for (size_t j = 0; j < width; j++) {
+        if (term_char(term, text.value[first + j]) == (unsigned char)term->pattern[0]) {
+            H[j] = SCORE_MATCH + B[j] * BONUS_FIRST_CHAR_MULTIPLIER;
+            C[j] = 1;
+            in_gap = false;
+        } else {
+            int score = previous_score + (in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START);
+
+            H[j] = score > 0 ? score : 0;
+            C[j] = 0;
+            in_gap = true;
+        }
+
+        previous_score = H[j];
+    }
+
+    for (size_t i = 1; i < rows; i++) {
+        int *row = H + i * width;
+        int *row_consecutive = C + i * width;
+        const int *above = H + (i - 1) * width;
+        const int *above_consecutive = C + (i - 1) * width;
+        size_t start = starts[i] - first;
+
+        // cells before the first possible position of this character can't be used
+        for (size_t j = 0; j < start; j++) {
+            row[j] = 0;
+            row_consecutive[j] = 0;
+        }
+
+        in_gap = false;
+
+        for (size_t j = start; j < width; j++) {
+            int left = j > start ? row[j - 1] : 0;
+            int gap_score = left + (in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START);
+            int match_score = 0;
+            int consecutive = 0;
+
+            if (term_char(term, text.value[first + j]) == (unsigned char)term->pattern[i]) {
+                int bonus = B[j];
+
+                match_score = above[j - 1] + SCORE_MATCH;
+                consecutive = above_consecutive[j - 1] + 1;
+
+                if (consecutive > 1) {
+                    int first_bonus = B[j - consecutive + 1];
+
+                    // a new word boundary breaks the chain
+                    if (bonus >= BONUS_BOUNDARY && bonus > first_bonus) {
+                        consecutive = 1;
+                    } else {
+                        int chain = first_bonus > BONUS_CONSECUTIVE ? first_bonus : BONUS_CONSECUTIVE;
+
+                        if (chain > bonus) bonus = chain;
+                    }
+                }
+
+                if (match_score + bonus < gap_score) {
+                    match_score += B[j];
+                    consecutive = 0;
+                } else {
+                    match_score += bonus;
+                }
+            }
+
+            in_gap = match_score < gap_score;
+
+            int score = match_score > gap_score ? match_score : gap_score;
+
+            row[j] = score > 0 ? score : 0;
+            row_consecutive[j] = consecutive;
+        }
+    }
+
+    const int *last_row = H + (rows - 1) * width;
+    size_t best = starts[rows - 1] - first;
+
+    for (size_t j = best + 1; j < width; j++) {
+        if (last_row[j] > last_row[best]) best = j;
+    }
+
+    int best_score = last_row[best];
+
+    if (positions == NULL) return best_score;
+
+    // walk back through the matrix, preferring consecutive matches on ties
+    size_t i = rows - 1;
+    size_t j = best;
+    bool prefer_match = true;
+
+    for (;;) {
+        size_t start = starts[i] - first;
+        int score = H[i * width + j];
+        int diagonal = i > 0 && j >= start ? H[(i - 1) * width + j - 1] : 0;
+        int left = j > start ? H[i * width + j - 1] : 0;
+        size_t row = i;
+
+        if (score > diagonal && (score > left || (score == left && prefer_match))) {
+            cl_arr_push(*positions, first + j);
+
+            if (i == 0) break;
+
+            i--;
+        }
+
+        prefer_match = C[row * width + j] > 1 || (row + 1 < rows && j + 1 < width && C[(row + 1) * width + j + 1] > 0);
+
+        if (j == 0) break;
+
+        j--;
+    }
+
+    return best_score;
+}
+
+// every term must match, the scores are added up
+static int score_text(const Pick_Term *terms, size_t terms_count, wodo_string_t text, Pick_Scratch *scratch, size_t **positions) {
+    int total = 0;
+
+    for (size_t i = 0; i < terms_count; i++) {
+        int score = score_term(&terms[i], text, scratch, positions);
+
+        if (score < 0) return -1;
+
+        total += score;
+    }
+
+    return total;
+}
+
+// a is ranked worse than b: lower score, then longer text, then later item
+static bool is_worse(const Pick_Candidate *a, const Pick_Candidate *b) {
+    if (a->score != b->score) return a->score < b->score;
+    if (a->text.length != b->text.length) return a->text.length > b->text.length;
+
+    return a->item > b->item;
+}
+
+static int compare_candidates(const void *a, const void *b) {
+    const Pick_Candidate *x = a;
+    const Pick_Candidate *y = b;
+
+    if (is_worse(y, x)) return -1;
+    if (is_worse(x, y)) return 1;
+
+    return 0;
+}
+
+static void heap_sift_down(Pick_Candidate *heap, size_t count, size_t i) {
+    for (;;) {
+        size_t worst = i;
+        size_t left = i * 2 + 1;
+        size_t right = left + 1;
+
+        if (left < count && is_worse(&heap[left], &heap[worst])) worst = left;
+        if (right < count && is_worse(&heap[right], &heap[worst])) worst = right;
+
+        if (worst == i) return;
+
+        Pick_Candidate swap = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = swap;
+        i = worst;
+    }
+}
+
+static void heap_sift_up(Pick_Candidate *heap, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+
+        if (!is_worse(&heap[i], &heap[parent])) return;
+
+        Pick_Candidate swap = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = swap;
+        i = parent;
+    }
+}
+
+// keeps the best `limit` candidates in a heap with the worst one on top, so
+// memory and the final sort only depend on `limit`. 0 keeps all of them
+static void keep_candidate(Pick_Candidate **heap, size_t limit, Pick_Candidate candidate) {
+    size_t count = cl_arr_len(*heap);
+
+    if (limit == 0 || count < limit) {
+        cl_arr_push(*heap, candidate);
+
+        if (limit != 0) heap_sift_up(*heap, count);
+    } else if (is_worse(&(*heap)[0], &candidate)) {
+        (*heap)[0] = candidate;
+        heap_sift_down(*heap, count, 0);
+    }
+}
+
+static size_t parse_terms(const char *query, Pick_Term *terms, size_t capacity) {
+    size_t count = 0;
+
+    while (*query != '\0' && count < capacity) {
+        query += strspn(query, " \t\n");
+
+        size_t length = strcspn(query, " \t\n");
+
+        if (length == 0) break;
+
+        Pick_Term *term = &terms[count++];
+
+        term->length = length < MAX_TERM_SIZE ? length : MAX_TERM_SIZE;
+        term->case_sensitive = false;
+
+        for (size_t i = 0; i < term->length; i++) {
+            if (query[i] >= 'A' && query[i] <= 'Z') term->case_sensitive = true;
+        }
+
+        for (size_t i = 0; i < term->length; i++) {
+            term->pattern[i] = term->case_sensitive ? query[i] : (char)fold_ascii(query[i]);
+        }
+
+        query += length;
+    }
+
+    return count;
+}
+
+static int compare_positions(const void *a, const void *b) {
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void print_positions(const Pick_Term *terms, size_t terms_count, wodo_string_t text, Pick_Scratch *scratch) {
+    size_t *positions = CL_ARRAY_INIT;
+
+    score_text(terms, terms_count, text, scratch, &positions);
+
+    if (cl_arr_len(positions) > 0) qsort(positions, cl_arr_len(positions), sizeof(size_t), compare_positions);
+
+    printf(",\"positions\":[");
+
+    for (size_t i = 0; i < cl_arr_len(positions); i++) {
+        if (i > 0 && positions[i] == positions[i - 1]) continue;
+
+        printf(i > 0 ? ",%zu" : "%zu", positions[i]);
+    }
+
+    printf("]");
+
+    cl_arr_free(positions);
+}
+
+static void print_string(const char *value) {
+    print_scaped_string_to_fd((wodo_string_t){ .length = strlen(value), .value = value }, stdout);
+}
+
+static const char *state_names[] = { "todo", "doing", "blocked", "done" };
+
+int pick_action(Flags flags) {
+    TRACE_SCOPE("pick");
+
+    Pick_Term terms[16];
+    size_t terms_count = parse_terms(flags.query == NULL ? "" : flags.query, terms, sizeof(terms) / sizeof(terms[0]));
+
+    Task_Titles titles = { .titles = CL_ARRAY_INIT, .index = NULL };
+    size_t items_count;
+
+    if (flags.files) {
+        items_count = cl_arr_len(global_database.files);
+    } else {
+        titles = load_task_titles();
+        items_count = cl_arr_len(titles.titles);
+    }
+
+    Pick_Scratch scratch = {0};
+    Pick_Candidate *heap = CL_ARRAY_INIT;
+    size_t limit = (size_t)flags.limit;
+
+    TRACE_BEGIN("score");
+
+    for (size_t i = 0; i < items_count; i++) {
+        Pick_Candidate candidate = { .item = i };
+
+        if (flags.files) {
+            const char *name = global_database.files[i]->name;
+
+            candidate.text = (wodo_string_t){ .value = name, .length = strlen(name) };
+        } else {
+            candidate.text = titles.titles[i].title;
+        }
+
+        // an empty query keeps the original order
+        if (terms_count == 0) {
+            candidate.text.length = 0;
+
+            if (limit != 0 && i >= limit) break;
+        }
+
+        candidate.score = terms_count == 0 ? 0 : score_text(terms, terms_count, candidate.text, &scratch, NULL);
+
+        if (candidate.score < 0) continue;
+
+        keep_candidate(&heap, limit, candidate);
+    }
+
+    if (cl_arr_len(heap) > 0) qsort(heap, cl_arr_len(heap), sizeof(Pick_Candidate), compare_candidates);
+
+    TRACE_END();
+
+    if (!flags.ndjson) printf("[");
+
+    for (size_t i = 0; i < cl_arr_len(heap); i++) {
+        const Pick_Candidate *candidate = &heap[i];
+        Database_File *file;
+
+        if (i > 0 && !flags.ndjson) printf(",");
+
+        if (flags.files) {
+            file = global_database.files[candidate->item];
+
+            printf("{\"name\":");
+            print_string(file->name);
+            printf(",\"path\":");
+            print_string(file->view_absolute_filepath);
+            printf(",\"score\":%d", candidate->score);
+            print_positions(terms, terms_count, (wodo_string_t){ .value = file->name, .length = strlen(file->name) }, &scratch);
+        } else {
+            const Task_Title *title = &titles.titles[candidate->item];
+
+            file = global_database.files[title->file];
+
+            printf("{\"name\":");
+            print_string(file->name);
+            printf(",\"path\":");
+            print_string(file->view_absolute_filepath);
+            printf(",\"score\":%d", candidate->score);
+            printf(",\"title\":{\"content\":");
+            print_scaped_string_to_fd(title->title, stdout);
+            printf(",\"location\":{\"line\":%d,\"col\":%d}}", title->line, title->col);
+            printf(",\"state\":{\"content\":\"%s\"}", (unsigned)title->state < 4 ? state_names[title->state] : "todo");
+            print_positions(terms, terms_count, title->title, &scratch);
+        }
+
+        printf("}");
+
+        if (flags.ndjson) printf("\n");
+    }
+
+    if (!flags.ndjson) printf("]\n");
+
+    free(scratch.scores);
+    free(scratch.consecutive);
+    free(scratch.bonuses);
+    cl_arr_free(heap);
+    free_task_titles(&titles);
+
+    return 0;
+}
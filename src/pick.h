@@ -0,0 +1,13 @@
+#ifndef _WODO_PICK_H_
+#define _WODO_PICK_H_
+
+#include "argparser.h"
+
+// `wodo pick --query <q> [--limit <k>] [--files]`
+//
+// fzf style fuzzy matching of the query against every task title, or against
+// the file names with --files. Only the best `limit` matches are kept (in a
+// bounded heap) and printed best first, with the byte offsets that matched.
+int pick_action(Flags flags);
+
+#endif // !_WODO_PICK_H_
@@ -0,0 +1,463 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "properties.h"
+#include "arr.h"
+#include "date.h"
+#include "io.h"
+#include "utils.h"
+#include "visualizer.h"
+
+#define SLOTS_COUNT (WODO_MAX_PROPERTIES * 2)
+
+static wodo_property_t *properties = CL_ARRAY_INIT;
+// open addressing table of the names, index + 1 of the property, 0 is a free slot
+static uint32_t slots[SLOTS_COUNT] = {0};
+
+// the parser handles these ones itself
+static const char *builtin_names[] = { "state", "tags", "date", "remind", "depends" };
+
+static const struct {
+    char unit;
+    int64_t seconds;
+} duration_units[] = {
+    { 'w', 7 * 86400 },
+    { 'd', 86400 },
+    { 'h', 3600 },
+    { 'm', 60 },
+    { 's', 1 },
+};
+
+static size_t name_slot(const char *name, size_t length) {
+    return fnv1a(FNV1A_OFFSET_BASIS, name, length) & (SLOTS_COUNT - 1);
+}
+
+int find_property(const char *name, size_t length) {
+    for (size_t slot = name_slot(name, length); slots[slot] != 0; slot = (slot + 1) & (SLOTS_COUNT - 1)) {
+        const char *it = properties[slots[slot] - 1].name;
+
+        if (strlen(it) == length && memcmp(it, name, length) == 0) return slots[slot] - 1;
+    }
+
+    return -1;
+}
+
+size_t properties_count(void) {
+    return cl_arr_len(properties);
+}
+
+const wodo_property_t *property_at(uint32_t index) {
+    return &properties[index];
+}
+
+const char *property_type_name(wodo_property_type_t type) {
+    switch (type) {
+        case Wodo_Property_Int: return "int";
+        case Wodo_Property_Duration: return "duration";
+        case Wodo_Property_Datetime: return "datetime";
+        case Wodo_Property_Enum: return "enum";
+        default: assert(0 && "unimplemented property type");
+    }
+
+    return NULL;
+}
+
+// the same characters as tags
+static bool is_valid_name(const char *name, size_t length) {
+    if (length == 0) return false;
+
+    for (size_t i = 0; i < length; i++) {
+        if (!((name[i] >= 'a' && name[i] <= 'z') || name[i] == '_')) return false;
+    }
+
+    return true;
+}
+
+static bool is_builtin_name(const char *name, size_t length) {
+    for (size_t i = 0; i < sizeof(builtin_names) / sizeof(builtin_names[0]); i++) {
+        if (strlen(builtin_names[i]) == length && memcmp(builtin_names[i], name, length) == 0) return true;
+    }
+
+    return false;
+}
+
+// next word of line[*cursor..length), false when there are no more
+static bool next_word(const char *line, size_t length, size_t *cursor, const char **word, size_t *word_length) {
+    while (*cursor < length && (line[*cursor] == ' ' || line[*cursor] == '\t')) (*cursor)++;
+
+    if (*cursor >= length) return false;
+
+    *word = &line[*cursor];
+
+    while (*cursor < length && line[*cursor] != ' ' && line[*cursor] != '\t') (*cursor)++;
+
+    *word_length = &line[*cursor] - *word;
+
+    return true;
+}
+
+static bool parse_type(const char *text, size_t length, wodo_property_type_t *type) {
+    for (wodo_property_type_t it = Wodo_Property_Int; it <= Wodo_Property_Enum; it++) {
+        const char *name = property_type_name(it);
+
+        if (strlen(name) == length && memcmp(name, text, length) == 0) {
+            *type = it;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#define declaration_error(fmt, ...) fprintf(stderr, "error: %s:%d: " fmt "\n", filepath, line_number, ##__VA_ARGS__)
+
+// "<name> <type> [values...]"
+static bool parse_declaration(const char *filepath, int line_number, const char *line, size_t length) {
+    size_t cursor = 0;
+    const char *name, *type_name;
+    size_t name_length, type_length;
+
+    if (!next_word(line, length, &cursor, &name, &name_length)) return true;
+    if (name[0] == '#') return true;
+
+    if (!is_valid_name(name, name_length)) {
+        declaration_error("invalid property name '%.*s', it can only have lowercase letters and '_'", (int)name_length, name);
+
+        return false;
+    }
+
+    if (is_builtin_name(name, name_length) || find_property(name, name_length) >= 0) {
+        declaration_error("property '%.*s' is already declared", (int)name_length, name);
+
+        return false;
+    }
+
+    if (cl_arr_len(properties) >= WODO_MAX_PROPERTIES) {
+        declaration_error("there can be at most %d properties", WODO_MAX_PROPERTIES);
+
+        return false;
+    }
+
+    wodo_property_t property = { .values = CL_ARRAY_INIT };
+
+    if (!next_word(line, length, &cursor, &type_name, &type_length) || !parse_type(type_name, type_length, &property.type)) {
+        declaration_error("property '%.*s' needs a type: int, duration, datetime or enum", (int)name_length, name);
+
+        return false;
+    }
+
+    const char *value;
+    size_t value_length;
+
+    while (next_word(line, length, &cursor, &value, &value_length)) {
+        if (property.type != Wodo_Property_Enum) {
+            declaration_error("property '%.*s' is not an enum, only enums have values", (int)name_length, name);
+            cl_arr_free(property.values);
+
+            return false;
+        }
+
+        if (!is_valid_name(value, value_length)) {
+            declaration_error("invalid value '%.*s', it can only have lowercase letters and '_'", (int)value_length, value);
+            cl_arr_free(property.values);
+
+            return false;
+        }
+
+        cl_arr_push(property.values, strndup(value, value_length));
+    }
+
+    if (property.type == Wodo_Property_Enum && cl_arr_len(property.values) == 0) {
+        declaration_error("enum property '%.*s' needs at least one value", (int)name_length, name);
+
+        return false;
+    }
+
+    property.name = strndup(name, name_length);
+
+    cl_arr_push(properties, property);
+
+    size_t slot = name_slot(name, name_length);
+
+    while (slots[slot] != 0) slot = (slot + 1) & (SLOTS_COUNT - 1);
+
+    slots[slot] = cl_arr_len(properties);
+
+    return true;
+}
+
+bool load_properties(const char *filepath) {
+    char *content;
+    size_t length;
+
+    if (!read_from_file_no_quit(filepath, &content, &length)) {
+        if (errno == ENOENT) return true;
+
+        fprintf(stderr, "error: could not read %s: %s\n", filepath, strerror(errno));
+
+        return false;
+    }
+
+    bool ok = true;
+    int line_number = 1;
+
+    for (size_t start = 0; ok && start < length; line_number++) {
+        const char *linebreak = memchr(content + start, '\n', length - start);
+        size_t end = linebreak == NULL ? length : (size_t)(linebreak - content);
+
+        ok = parse_declaration(filepath, line_number, content + start, end - start);
+
+        start = end + 1;
+    }
+
+    free(content);
+
+    return ok;
+}
+
+static bool parse_int(const char *text, size_t length, int64_t *value) {
+    bool negative = length > 0 && text[0] == '-';
+    size_t i = negative ? 1 : 0;
+    uint64_t n = 0;
+
+    if (i == length) return false;
+
+    for (; i < length; i++) {
+        if (text[i] < '0' || text[i] > '9' || n > ((uint64_t)INT64_MAX - 9) / 10) return false;
+
+        n = n * 10 + (text[i] - '0');
+    }
+
+    *value = negative ? -(int64_t)n : (int64_t)n;
+
+    return true;
+}
+
+// "1h30m" -> 5400, every number needs a unit
+static bool parse_duration(const char *text, size_t length, int64_t *value) {
+    int64_t total = 0;
+    size_t i = 0;
+
+    if (length == 0) return false;
+
+    while (i < length) {
+        size_t digits = i;
+        int64_t n = 0;
+
+        while (i < length && text[i] >= '0' && text[i] <= '9') {
+            if (n > (INT64_MAX - 9) / 10) return false;
+
+            n = n * 10 + (text[i++] - '0');
+        }
+
+        if (i == digits || i == length) return false;
+
+        int64_t unit = 0;
+
+        for (size_t j = 0; j < sizeof(duration_units) / sizeof(duration_units[0]); j++) {
+            if (duration_units[j].unit == text[i]) unit = duration_units[j].seconds;
+        }
+
+        if (unit == 0 || n > (INT64_MAX - total) / unit) return false;
+
+        total += n * unit;
+        i++;
+    }
+
+    *value = total;
+
+    return true;
+}
+
+static bool parse_digits(const char *text, int count, int *value) {
+    *value = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (text[i] < '0' || text[i] > '9') return false;
+
+        *value = *value * 10 + (text[i] - '0');
+    }
+
+    return true;
+}
+
+// "YYYY-MM-DD HH:MM:SS" followed by 'Z' or "+HH:MM"/"-HH:MM", like .date
+static bool parse_datetime(const char *text, size_t length, int64_t *value) {
+    wodo_datetime_t datetime = {0};
+
+    if (length != 20 && length != 25) return false;
+
+    if (!parse_digits(text, 4, &datetime.year) || text[4] != '-' ||
+        !parse_digits(text + 5, 2, &datetime.month) || text[7] != '-' ||
+        !parse_digits(text + 8, 2, &datetime.day) || text[10] != ' ' ||
+        !parse_digits(text + 11, 2, &datetime.hour) || text[13] != ':' ||
+        !parse_digits(text + 14, 2, &datetime.minute) || text[16] != ':' ||
+        !parse_digits(text + 17, 2, &datetime.second)) return false;
+
+    if (length == 20) {
+        if (text[19] != 'Z') return false;
+    } else {
+        int hours, minutes;
+
+        if ((text[19] != '+' && text[19] != '-') || !parse_digits(text + 20, 2, &hours) || text[22] != ':' || !parse_digits(text + 23, 2, &minutes)) return false;
+
+        datetime.tz_offset = (hours * 60 + minutes) * (text[19] == '-' ? -1 : 1);
+    }
+
+    if (!validate_datetime(datetime)) return false;
+
+    *value = datetime_to_timestamp(datetime);
+
+    return true;
+}
+
+bool parse_property_value(const wodo_property_t *property, const char *text, size_t length, int64_t *value) {
+    switch (property->type) {
+        case Wodo_Property_Int: return parse_int(text, length, value);
+        case Wodo_Property_Duration: return parse_duration(text, length, value);
+        case Wodo_Property_Datetime: return parse_datetime(text, length, value);
+        case Wodo_Property_Enum: {
+            for (size_t i = 0; i < cl_arr_len(property->values); i++) {
+                if (strlen(property->values[i]) == length && memcmp(property->values[i], text, length) == 0) {
+                    *value = i;
+
+                    return true;
+                }
+            }
+
+            return false;
+        }
+        default: assert(0 && "unimplemented property type");
+    }
+
+    return false;
+}
+
+size_t format_property_value(char *buffer, const wodo_property_t *property, int64_t value) {
+    switch (property->type) {
+        case Wodo_Property_Int: return snprintf(buffer, WODO_PROPERTY_VALUE_MAX_SIZE, "%lld", (long long)value);
+        case Wodo_Property_Duration: {
+            if (value == 0) return snprintf(buffer, WODO_PROPERTY_VALUE_MAX_SIZE, "0s");
+
+            size_t size = 0;
+
+            // weeks are left as days, "14d" reads better than "2w" next to "10d"
+            for (size_t i = 1; i < sizeof(duration_units) / sizeof(duration_units[0]); i++) {
+                int64_t n = value / duration_units[i].seconds;
+
+                if (n == 0) continue;
+
+                size += snprintf(buffer + size, WODO_PROPERTY_VALUE_MAX_SIZE - size, "%lld%c", (long long)n, duration_units[i].unit);
+                value -= n * duration_units[i].seconds;
+            }
+
+            return size;
+        }
+        case Wodo_Property_Datetime: {
+            size_t size = format_wodo_datetime(buffer, timestamp_to_utc_datetime(value), false);
+
+            buffer[size] = '\0';
+
+            return size;
+        }
+        case Wodo_Property_Enum: return snprintf(buffer, WODO_PROPERTY_VALUE_MAX_SIZE, "%s", property->values[value]);
+        default: assert(0 && "unimplemented property type");
+    }
+
+    return 0;
+}
+
+const wodo_property_value_t *task_property(wodo_task_t task, uint32_t index) {
+    for (size_t i = 0; i < task.properties_count && task.properties[i].property <= index; i++) {
+        if (task.properties[i].property == index) return &task.properties[i];
+    }
+
+    return NULL;
+}
+
+// "<=" before "<" so the longest operator wins
+static const struct {
+    const char *text;
+    wodo_compare_t compare;
+} compare_operators[] = {
+    { "!=", Wodo_Compare_Not_Equal },
+    { "<=", Wodo_Compare_Less_Equal },
+    { ">=", Wodo_Compare_Greater_Equal },
+    { "=", Wodo_Compare_Equal },
+    { "<", Wodo_Compare_Less },
+    { ">", Wodo_Compare_Greater },
+};
+
+bool compile_property_filters(Flags *flags) {
+    for (size_t i = 0; i < cl_arr_len(flags->property_filter); i++) {
+        const char *filter = flags->property_filter[i];
+        size_t name_length = strcspn(filter, "=!<>");
+        int property = find_property(filter, name_length);
+
+        if (property < 0) {
+            fprintf(stderr, "error: --filter-property \"%s\": property '%.*s' is not declared in .wodo/properties\n", filter, (int)name_length, filter);
+
+            return false;
+        }
+
+        wodo_property_filter_t compiled = { .property = property };
+        const char *value = NULL;
+
+        for (size_t j = 0; j < sizeof(compare_operators) / sizeof(compare_operators[0]); j++) {
+            size_t size = strlen(compare_operators[j].text);
+
+            if (strncmp(filter + name_length, compare_operators[j].text, size) == 0) {
+                compiled.compare = compare_operators[j].compare;
+                value = filter + name_length + size;
+
+                break;
+            }
+        }
+
+        const wodo_property_t *declared = property_at(property);
+
+        if (value == NULL) {
+            fprintf(stderr, "error: --filter-property \"%s\" expects <name><op><value>, <op> is =, !=, <, <=, > or >=\n", filter);
+
+            return false;
+        }
+
+        if (!parse_property_value(declared, value, strlen(value), &compiled.value)) {
+            fprintf(stderr, "error: --filter-property \"%s\": invalid %s value '%s'\n", filter, property_type_name(declared->type), value);
+
+            return false;
+        }
+
+        cl_arr_push(flags->property_filters, compiled);
+    }
+
+    return true;
+}
+
+bool property_filters_match(wodo_task_t task, Flags flags) {
+    for (size_t i = 0; i < cl_arr_len(flags.property_filters); i++) {
+        wodo_property_filter_t filter = flags.property_filters[i];
+        const wodo_property_value_t *it = task_property(task, filter.property);
+
+        if (it == NULL) return false;
+
+        bool matched;
+
+        switch (filter.compare) {
+            case Wodo_Compare_Equal: matched = it->value == filter.value; break;
+            case Wodo_Compare_Not_Equal: matched = it->value != filter.value; break;
+            case Wodo_Compare_Less: matched = it->value < filter.value; break;
+            case Wodo_Compare_Less_Equal: matched = it->value <= filter.value; break;
+            case Wodo_Compare_Greater: matched = it->value > filter.value; break;
+            case Wodo_Compare_Greater_Equal: matched = it->value >= filter.value; break;
+            default: assert(0 && "unimplemented property comparison");
+        }
+
+        if (!matched) return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef _WODO_PROPERTIES_H_
+#define _WODO_PROPERTIES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "argparser.h"
+#include "systemtypes.h"
+
+// custom task properties are declared in .wodo/properties, one per line:
+//
+//   priority enum low medium high
+//   estimate duration
+//   due datetime
+//   points int
+//
+// empty lines and lines starting with '#' are skipped. Tasks set them like
+// the built-in ones (".priority high", ".estimate 1h30m"), the parser keeps
+// the values in `wodo_task_t.properties` by index, so filtering, printing and
+// sorting never look a property up by name.
+#define WODO_MAX_PROPERTIES 64
+
+typedef enum {
+    Wodo_Property_Int,          // -12, 42
+    Wodo_Property_Duration,     // 45m, 1h30m, 2d (w, d, h, m or s)
+    Wodo_Property_Datetime,     // same format as .date
+    Wodo_Property_Enum,         // one of the declared values, ordered as declared
+} wodo_property_type_t;
+
+typedef struct {
+    char *name;
+    wodo_property_type_t type;
+    // enum values, CL_ARRAY
+    char **values;
+} wodo_property_t;
+
+// loads the registry of the repository, a missing file declares nothing.
+// Prints the error and returns false when the file is invalid
+bool load_properties(const char *filepath);
+size_t properties_count(void);
+const wodo_property_t *property_at(uint32_t index);
+// index of the property called `name`, -1 when it's not declared
+int find_property(const char *name, size_t length);
+const char *property_type_name(wodo_property_type_t type);
+
+// parses the text of a value, false when it's not valid for the property
+bool parse_property_value(const wodo_property_t *property, const char *text, size_t length, int64_t *value);
+// text of a value as it's written in a .wodo file, it's null terminated.
+// The buffer needs at least WODO_PROPERTY_VALUE_MAX_SIZE bytes
+#define WODO_PROPERTY_VALUE_MAX_SIZE 64
+size_t format_property_value(char *buffer, const wodo_property_t *property, int64_t value);
+
+// the value of the property at `index` of `task`, NULL when it's not set
+const wodo_property_value_t *task_property(wodo_task_t task, uint32_t index);
+
+// resolves every --filter-property of `flags` (<name><op><value> where <op> is
+// =, !=, <, <=, > or >=), prints the error and returns false on invalid ones
+bool compile_property_filters(Flags *flags);
+// every resolved filter matches, a task without the property never does
+bool property_filters_match(wodo_task_t task, Flags flags);
+
+#endif // !_WODO_PROPERTIES_H_
@@ -0,0 +1,533 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "reminders.h"
+#include "arr.h"
+#include "database.h"
+#include "date.h"
+#include "io.h"
+#include "json.h"
+#include "parser.h"
+#include "utils.h"
+
+#ifdef __linux__
+
+#include <poll.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+
+static const char *notified_filename = ".notified";
+
+// a heap entry, it's stale when the file was scanned again after it was pushed
+typedef struct {
+    time_t due;
+    uint64_t key;
+    size_t file;
+    unsigned generation;
+} Reminder;
+
+// open addressing set of reminder keys, 0 is the empty slot
+typedef struct {
+    uint64_t *slots;
+    size_t capacity;
+    size_t length;
+} Key_Set;
+
+typedef struct {
+    int wd;
+    char *directory;
+} Watch;
+
+static Reminder *heap = CL_ARRAY_INIT;
+// generation of every file in global_database.files
+static unsigned *generations = CL_ARRAY_INIT;
+static Watch *watches = CL_ARRAY_INIT;
+static Key_Set notified = {0};
+static FILE *notified_file = NULL;
+static int inotify_fd = -1;
+static int timer_fd = -1;
+
+static bool reminder_predicate(wodo_task_t task, Flags flags) {
+    (void)flags;
+
+    return task.state_property.state != Wodo_Task_State_Done && task.remind_property.boolean;
+}
+
+// the same task in the same file with the same date is notified only once
+static uint64_t reminder_key(const char *filepath, wodo_task_t task, time_t due) {
+    uint64_t hash = FNV1A_OFFSET_BASIS;
+
+    hash = fnv1a(hash, filepath, strlen(filepath) + 1);
+    hash = fnv1a(hash, task.title.string.value, task.title.string.length);
+    hash = fnv1a(hash, &due, sizeof(due));
+
+    return hash == 0 ? 1 : hash;
+}
+
+static bool key_set_contains(const Key_Set *set, uint64_t key) {
+    if (set->capacity == 0) return false;
+
+    for (size_t i = key & (set->capacity - 1);; i = (i + 1) & (set->capacity - 1)) {
+        if (set->slots[i] == key) return true;
+        if (set->slots[i] == 0) return false;
+    }
+}
+
+static void key_set_add(Key_Set *set, uint64_t key) {
+    if ((set->length + 1) * 2 > set->capacity) {
+        Key_Set grown = {
+            .capacity = set->capacity == 0 ? 64 : set->capacity * 2,
+        };
+
+        grown.slots = calloc(grown.capacity, sizeof(uint64_t));
+
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] != 0) key_set_add(&grown, set->slots[i]);
+        }
+
+        free(set->slots);
+        *set = grown;
+    }
+
+    size_t i = key & (set->capacity - 1);
+
+    while (set->slots[i] != 0) {
+        if (set->slots[i] == key) return;
+
+        i = (i + 1) & (set->capacity - 1);
+    }
+
+    set->slots[i] = key;
+    set->length++;
+}
+
+static void heap_push(Reminder reminder) {
+    cl_arr_push(heap, reminder);
+
+    size_t i = cl_arr_len(heap) - 1;
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+
+        if (heap[parent].due <= heap[i].due) break;
+
+        Reminder tmp = heap[parent];
+        heap[parent] = heap[i];
+        heap[i] = tmp;
+
+        i = parent;
+    }
+}
+
+static Reminder heap_pop(void) {
+    Reminder top = heap[0];
+    size_t length = cl_arr_len(heap) - 1;
+
+    heap[0] = heap[length];
+    (void)cl_arr_pop(heap);
+
+    size_t i = 0;
+
+    while (true) {
+        size_t smallest = i;
+        size_t left = i * 2 + 1;
+        size_t right = i * 2 + 2;
+
+        if (left < length && heap[left].due < heap[smallest].due) smallest = left;
+        if (right < length && heap[right].due < heap[smallest].due) smallest = right;
+
+        if (smallest == i) break;
+
+        Reminder tmp = heap[smallest];
+        heap[smallest] = heap[i];
+        heap[i] = tmp;
+
+        i = smallest;
+    }
+
+    return top;
+}
+
+// parses the file and calls `callback` for every reminder in it
+static void for_each_reminder(size_t file, void (*callback)(size_t, wodo_task_t, time_t, uint64_t, void *), void *data) {
+    Database_File *it = global_database.files[file];
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+    char *content;
+    size_t length;
+
+    if (!read_from_file_no_quit(it->view_absolute_filepath, &content, &length)) {
+        // deleted files are expected here, the database is reloaded right after
+        if (errno != ENOENT) {
+            push_diagnostic(&diagnostics, it->view_absolute_filepath, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+            print_diagnostics_to_stdout_as_ndjson(diagnostics, 0);
+            fflush(stdout);
+        }
+
+        free_diagnostics(&diagnostics);
+
+        return;
+    }
+
+    reset_parser_state();
+
+    wodo_task_t *tasks = parse_tasks_recovering(it->view_absolute_filepath, content, length, &diagnostics);
+
+    if (cl_arr_len(diagnostics) > 0) {
+        print_diagnostics_to_stdout_as_ndjson(diagnostics, 0);
+        fflush(stdout);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        if (!reminder_predicate(tasks[i], (Flags){0})) continue;
+
+        time_t due = datetime_to_timestamp(tasks[i].date_property.datetime);
+
+        callback(file, tasks[i], due, reminder_key(it->view_absolute_filepath, tasks[i], due), data);
+    }
+
+    free(content);
+    free_tasks(tasks);
+    free_diagnostics(&diagnostics);
+}
+
+static void push_reminder(size_t file, wodo_task_t task, time_t due, uint64_t key, void *data) {
+    (void)task;
+
+    Key_Set *live = data;
+
+    if (live != NULL) key_set_add(live, key);
+
+    if (key_set_contains(&notified, key)) return;
+
+    heap_push((Reminder){
+        .due = due,
+        .key = key,
+        .file = file,
+        .generation = generations[file],
+    });
+}
+
+// older entries of the file stay in the heap and are skipped when popped
+static void scan_file(size_t file, Key_Set *live) {
+    generations[file]++;
+
+    for_each_reminder(file, push_reminder, live);
+}
+
+static void mark_notified(uint64_t key) {
+    key_set_add(&notified, key);
+
+    if (notified_file != NULL) {
+        fprintf(notified_file, "%016llx\n", (unsigned long long)key);
+        fflush(notified_file);
+    }
+}
+
+static void fire_reminder(size_t file, wodo_task_t task, time_t due, uint64_t key, void *data) {
+    Flags *flags = data;
+    Database_File *it = global_database.files[file];
+
+    if (due > time(NULL) || key_set_contains(&notified, key)) return;
+
+    printf("{\"event\":\"reminder\",\"name\":");
+    print_scaped_string_to_fd((wodo_string_t){ .length = strlen(it->name), .value = it->name }, stdout);
+    printf(",\"path\":");
+    print_scaped_string_to_fd((wodo_string_t){ .length = strlen(it->view_absolute_filepath), .value = it->view_absolute_filepath }, stdout);
+    printf(",\"task\":");
+    print_task_to_stdout_as_json(task, NULL, *flags);
+    printf("}\n");
+    fflush(stdout);
+
+    mark_notified(key);
+}
+
+static void load_notified(const char *path) {
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) return;
+
+    unsigned long long key;
+
+    while (fscanf(file, "%llx", &key) == 1) {
+        if (key != 0) key_set_add(&notified, key);
+    }
+
+    fclose(file);
+}
+
+// rewrites the notified file without the reminders that don't exist anymore
+static bool compact_notified(const char *path, const Key_Set *live) {
+    char *temp_path = join_paths("%s.tmp", path);
+    FILE *file = fopen(temp_path, "w");
+
+    if (file == NULL) {
+        free(temp_path);
+
+        return false;
+    }
+
+    Key_Set kept = {0};
+
+    for (size_t i = 0; i < notified.capacity; i++) {
+        uint64_t key = notified.slots[i];
+
+        if (key == 0 || !key_set_contains(live, key)) continue;
+
+        key_set_add(&kept, key);
+        fprintf(file, "%016llx\n", (unsigned long long)key);
+    }
+
+    bool ok = fclose(file) == 0 && rename(temp_path, path) == 0;
+
+    free(temp_path);
+    free(notified.slots);
+    notified = kept;
+
+    return ok;
+}
+
+static void watch_directories(void) {
+    for (size_t i = 0; i < cl_arr_len(watches); i++) {
+        inotify_rm_watch(inotify_fd, watches[i].wd);
+        free(watches[i].directory);
+    }
+
+    cl_arr_free(watches);
+
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+
+    // the database file lives in the .wodo folder, usually with every task file
+    for (size_t i = 0; i <= cl_arr_len(global_database.files); i++) {
+        char *copy = strdup(i == 0 ? database_filepath() : global_database.files[i - 1]->view_absolute_filepath);
+        char *directory = dirname(copy);
+
+        bool watched = false;
+
+        for (size_t j = 0; j < cl_arr_len(watches) && !watched; j++) {
+            watched = strcmp(watches[j].directory, directory) == 0;
+        }
+
+        if (!watched) {
+            int wd = inotify_add_watch(inotify_fd, directory, mask);
+
+            if (wd >= 0) {
+                cl_arr_push(watches, ((Watch){ .wd = wd, .directory = strdup(directory) }));
+            } else {
+                fprintf(stderr, "warning: could not watch %s: %s\n", directory, strerror(errno));
+            }
+        }
+
+        free(copy);
+    }
+}
+
+static void rebuild(void) {
+    cl_arr_free(heap);
+    cl_arr_free(generations);
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        cl_arr_push(generations, 0);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        scan_file(i, NULL);
+    }
+
+    watch_directories();
+}
+
+static void arm_timer(void) {
+    struct itimerspec spec = {0};
+
+    // drop the stale entries so the timer doesn't wake up for nothing
+    while (cl_arr_len(heap) > 0 && heap[0].generation != generations[heap[0].file]) {
+        heap_pop();
+    }
+
+    if (cl_arr_len(heap) > 0) {
+        // a zero value disarms the timer, and anything in the past fires right away
+        spec.it_value.tv_sec = heap[0].due > 0 ? heap[0].due : 1;
+    }
+
+    // TFD_TIMER_CANCEL_ON_SET wakes us up when the wall clock jumps
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL) != 0) {
+        fprintf(stderr, "error: could not arm the reminders timer: %s\n", strerror(errno));
+        exit(1);
+    }
+}
+
+static void fire_due_reminders(Flags *flags) {
+    time_t now = time(NULL);
+    bool *fired = calloc(cl_arr_len(global_database.files) + 1, sizeof(bool));
+
+    while (cl_arr_len(heap) > 0 && heap[0].due <= now) {
+        Reminder reminder = heap_pop();
+
+        if (reminder.generation != generations[reminder.file] || fired[reminder.file]) continue;
+
+        // every due reminder of the file is fired by a single scan
+        fired[reminder.file] = true;
+
+        for_each_reminder(reminder.file, fire_reminder, flags);
+    }
+
+    free(fired);
+}
+
+// returns true when the database itself changed
+static bool handle_file_events(void) {
+    // large enough for a burst of events with long names
+    char buffer[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool database_changed = false;
+    bool *dirty = calloc(cl_arr_len(global_database.files) + 1, sizeof(bool));
+
+    ssize_t size;
+
+    while ((size = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + size;) {
+            struct inotify_event *event = (struct inotify_event *)p;
+
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->len == 0) continue;
+
+            const char *directory = NULL;
+
+            for (size_t i = 0; i < cl_arr_len(watches); i++) {
+                if (watches[i].wd == event->wd) directory = watches[i].directory;
+            }
+
+            if (directory == NULL) continue;
+
+            char *path = join_paths("%s/%s", directory, event->name);
+
+            if (strcmp(path, database_filepath()) == 0) database_changed = true;
+
+            for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+                if (strcmp(path, global_database.files[i]->view_absolute_filepath) == 0) dirty[i] = true;
+            }
+
+            free(path);
+        }
+    }
+
+    if (!database_changed) {
+        for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+            if (dirty[i]) scan_file(i, NULL);
+        }
+    }
+
+    free(dirty);
+
+    return database_changed;
+}
+
+int follow_reminders(Flags flags) {
+    if (flags.format != OF_JSON) {
+        fprintf(stderr, "error: --follow only supports the json format\n");
+
+        return 1;
+    }
+
+    char *notified_path = join_paths("%s/%s", database_folder(), notified_filename);
+
+    load_notified(notified_path);
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (inotify_fd < 0 || timer_fd < 0) {
+        fprintf(stderr, "error: could not watch reminders: %s\n", strerror(errno));
+        free(notified_path);
+
+        return 1;
+    }
+
+    // the first scan knows every reminder, so the keys of deleted tasks can be dropped
+    Key_Set live = {0};
+
+    cl_arr_free(heap);
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        cl_arr_push(generations, 0);
+        scan_file(i, &live);
+    }
+
+    if (!compact_notified(notified_path, &live)) {
+        fprintf(stderr, "warning: could not write %s: %s\n", notified_path, strerror(errno));
+    }
+
+    free(live.slots);
+
+    notified_file = fopen(notified_path, "a");
+
+    watch_directories();
+
+    struct pollfd fds[2] = {
+        { .fd = timer_fd, .events = POLLIN },
+        { .fd = inotify_fd, .events = POLLIN },
+    };
+
+    while (true) {
+        arm_timer();
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+
+            fprintf(stderr, "error: could not wait for reminders: %s\n", strerror(errno));
+
+            break;
+        }
+
+        if (fds[1].revents & POLLIN && handle_file_events()) {
+            database_status_code_t status_code = database_reload();
+
+            if (status_code != DATABASE_OK_STATUS_CODE) {
+                fprintf(stderr, "error: %s\n", database_status_code_string(status_code));
+
+                break;
+            }
+
+            rebuild();
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t expirations;
+
+            // ECANCELED means the clock was changed, the timer is armed again anyway
+            if (read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != ECANCELED && errno != EAGAIN) {
+                fprintf(stderr, "error: could not read the reminders timer: %s\n", strerror(errno));
+
+                break;
+            }
+
+            fire_due_reminders(&flags);
+        }
+    }
+
+    if (notified_file != NULL) fclose(notified_file);
+
+    close(inotify_fd);
+    close(timer_fd);
+    free(notified_path);
+
+    return 1;
+}
+
+#else
+
+int follow_reminders(Flags flags) {
+    (void)flags;
+
+    fprintf(stderr, "error: --follow is only supported on linux\n");
+
+    return 1;
+}
+
+#endif // __linux__
@@ -0,0 +1,14 @@
+#ifndef _WODO_REMINDERS_H_
+#define _WODO_REMINDERS_H_
+
+#include "argparser.h"
+
+// `wodo reminders --follow`
+//
+// keeps running and writes one {"event":"reminder",...} line when the date of
+// a not done `.remind` task is reached. Files are watched with inotify, so
+// only changed files are parsed again, and the reminders already notified are
+// kept in .wodo/.notified so they are not repeated in the next run.
+int follow_reminders(Flags flags);
+
+#endif // !_WODO_REMINDERS_H_
@@ -0,0 +1,874 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "arr.h"
+#include "database.h"
+#include "io.h"
+#include "parser.h"
+#include "utils.h"
+#include "trace.h"
+
+/*
+ * .wodo/.search-index layout (native endianness, like the database file):
+ *
+ *   Index_Header
+ *   Segment * segments_count, one for every indexed file:
+ *     Segment_Header
+ *     path, null terminated and padded to 8 bytes
+ *     Search_Task * tasks_count
+ *     Search_Trigram * trigrams_count, sorted by trigram
+ *     uint32_t * postings_count, task indexes of every trigram, sorted
+ *     titles_size bytes, the titles of the tasks one after the other
+ *
+ * A segment is only rebuilt when the mtime or the size of its file changed,
+ * the other ones are copied as they are.
+ */
+static const char *index_filename = ".search-index";
+static const char index_magic[8] = "WODOIDX";
+
+#define INDEX_VERSION 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t padding;
+    uint64_t segments_count;
+} Index_Header;
+
+typedef struct {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t size;
+    uint32_t path_size;         // padded
+    uint32_t tasks_count;
+    uint32_t trigrams_count;
+    uint32_t postings_count;
+    uint32_t titles_size;
+    uint32_t padding;
+} Segment_Header;
+
+typedef struct {
+    // byte ranges in the file
+    uint32_t title_start, title_length;
+    uint32_t description_start, description_length;
+    // location of `title_start`, other locations are counted from there
+    int32_t line, col;
+    uint32_t state;
+    // offset of the title copy in the segment titles
+    uint32_t title_copy;
+} Search_Task;
+
+typedef struct {
+    uint32_t trigram;
+    uint32_t first;             // index in the postings
+    uint32_t count;
+} Search_Trigram;
+
+typedef struct {
+    const Segment_Header *header;
+    const char *path;
+    const Search_Task *tasks;
+    const Search_Trigram *trigrams;
+    const uint32_t *postings;
+    const char *titles;
+    const char *bytes;
+    size_t size;
+} Segment;
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Byte_Buffer;
+
+typedef struct {
+    size_t file;
+    uint32_t task;
+    int score;
+    // first match, in the title when there is one there
+    bool in_title;
+    uint32_t match_offset;
+} Search_Result;
+
+static void buffer_write(Byte_Buffer *buffer, const void *data, size_t size) {
+    if (buffer->length + size > buffer->capacity) {
+        size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+
+        while (buffer->length + size > capacity) capacity *= 2;
+
+        buffer->data = realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+
+        assert(buffer->data != NULL && "buy more ram lol");
+    }
+
+    memcpy(buffer->data + buffer->length, data, size);
+    buffer->length += size;
+}
+
+static size_t align_8(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+// ASCII lower case, other bytes are kept as they are
+static unsigned char fold_table[256];
+
+static void init_fold_table(void) {
+    for (int c = 0; c < 256; c++) {
+        fold_table[c] = c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+    }
+}
+
+static inline unsigned char fold(unsigned char c) {
+    return fold_table[c];
+}
+
+static inline uint32_t trigram_at(const char *text) {
+    return (uint32_t)fold(text[0]) << 16 | (uint32_t)fold(text[1]) << 8 | fold(text[2]);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+// (trigram << 32 | task) pairs of a text
+static void push_trigrams(uint64_t **pairs, const char *text, size_t length, uint32_t task) {
+    for (size_t i = 0; i + 3 <= length; i++) {
+        cl_arr_push(*pairs, (uint64_t)trigram_at(text + i) << 32 | task);
+    }
+}
+
+static void build_segment(Byte_Buffer *out, const char *path, const struct stat *st, const char *content, wodo_task_t *tasks) {
+    Search_Task *search_tasks = CL_ARRAY_INIT;
+    uint64_t *pairs = CL_ARRAY_INIT;
+    Byte_Buffer titles = {0};
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        wodo_string_t title = tasks[i].title.string;
+        wodo_string_t description = tasks[i].description.string;
+
+        Search_Task task = {
+            .title_start = (uint32_t)(title.value - content),
+            .title_length = (uint32_t)title.length,
+            .description_start = description.value == NULL ? 0 : (uint32_t)(description.value - content),
+            .description_length = (uint32_t)description.length,
+            .line = tasks[i].title.location.line,
+            .col = tasks[i].title.location.col,
+            .state = tasks[i].state_property.state,
+            .title_copy = (uint32_t)titles.length,
+        };
+
+        cl_arr_push(search_tasks, task);
+        buffer_write(&titles, title.value, title.length);
+
+        push_trigrams(&pairs, title.value, title.length, (uint32_t)i);
+
+        if (description.length > 0) push_trigrams(&pairs, description.value, description.length, (uint32_t)i);
+    }
+
+    // sorting the pairs groups them by trigram with the tasks in order
+    if (cl_arr_len(pairs) > 0) qsort(pairs, cl_arr_len(pairs), sizeof(uint64_t), compare_u64);
+
+    Search_Trigram *trigrams = CL_ARRAY_INIT;
+    uint32_t *postings = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(pairs); i++) {
+        if (i > 0 && pairs[i] == pairs[i - 1]) continue;
+
+        uint32_t trigram = (uint32_t)(pairs[i] >> 32);
+        size_t last = cl_arr_len(trigrams);
+
+        if (last == 0 || trigrams[last - 1].trigram != trigram) {
+            cl_arr_push(trigrams, ((Search_Trigram){ .trigram = trigram, .first = (uint32_t)cl_arr_len(postings) }));
+            last++;
+        }
+
+        trigrams[last - 1].count++;
+        cl_arr_push(postings, (uint32_t)pairs[i]);
+    }
+
+    size_t path_size = strlen(path) + 1;
+
+    Segment_Header header = {
+        .mtime_sec = st->st_mtim.tv_sec,
+        .mtime_nsec = st->st_mtim.tv_nsec,
+        .size = (uint64_t)st->st_size,
+        .path_size = (uint32_t)align_8(path_size),
+        .tasks_count = (uint32_t)cl_arr_len(search_tasks),
+        .trigrams_count = (uint32_t)cl_arr_len(trigrams),
+        .postings_count = (uint32_t)cl_arr_len(postings),
+        .titles_size = (uint32_t)titles.length,
+    };
+
+    static const char zeros[8] = {0};
+
+    buffer_write(out, &header, sizeof(header));
+    buffer_write(out, path, path_size);
+    buffer_write(out, zeros, header.path_size - path_size);
+    buffer_write(out, search_tasks, sizeof(Search_Task) * header.tasks_count);
+    buffer_write(out, trigrams, sizeof(Search_Trigram) * header.trigrams_count);
+    buffer_write(out, postings, sizeof(uint32_t) * header.postings_count);
+    buffer_write(out, titles.data, titles.length);
+    buffer_write(out, zeros, align_8(out->length) - out->length);
+
+    free(titles.data);
+    cl_arr_free(search_tasks);
+    cl_arr_free(pairs);
+    cl_arr_free(trigrams);
+    cl_arr_free(postings);
+}
+
+// returns false when the bytes are not a valid segment
+static bool read_segment(const char *bytes, size_t available, Segment *out) {
+    if (available < sizeof(Segment_Header)) return false;
+
+    const Segment_Header *header = (const Segment_Header *)bytes;
+
+    size_t size = sizeof(Segment_Header) + (size_t)header->path_size
+        + sizeof(Search_Task) * header->tasks_count
+        + sizeof(Search_Trigram) * header->trigrams_count
+        + sizeof(uint32_t) * header->postings_count
+        + header->titles_size;
+
+    size = align_8(size);
+
+    if (size > available || header->path_size == 0) return false;
+
+    const char *path = bytes + sizeof(Segment_Header);
+
+    if (path[header->path_size - 1] != '\0') return false;
+
+    *out = (Segment){
+        .header = header,
+        .path = path,
+        .tasks = (const Search_Task *)(path + header->path_size),
+        .bytes = bytes,
+        .size = size,
+    };
+
+    out->trigrams = (const Search_Trigram *)(out->tasks + header->tasks_count);
+    out->postings = (const uint32_t *)(out->trigrams + header->trigrams_count);
+    out->titles = (const char *)(out->postings + header->postings_count);
+
+    for (uint32_t i = 0; i < header->tasks_count; i++) {
+        if ((uint64_t)out->tasks[i].title_copy + out->tasks[i].title_length > header->titles_size) return false;
+    }
+
+    for (uint32_t i = 0; i < header->trigrams_count; i++) {
+        if ((uint64_t)out->trigrams[i].first + out->trigrams[i].count > header->postings_count) return false;
+    }
+
+    return true;
+}
+
+static int compare_segments(const void *a, const void *b) {
+    return strcmp(((const Segment *)a)->path, ((const Segment *)b)->path);
+}
+
+// the segments point into `mapped`, an invalid index is just ignored
+static Segment *load_index(const char *path, void **mapped, size_t *mapped_size) {
+    Segment *segments = CL_ARRAY_INIT;
+
+    *mapped = NULL;
+    *mapped_size = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) return segments;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Index_Header)) {
+        close(fd);
+
+        return segments;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED) return segments;
+
+    const Index_Header *header = data;
+
+    if (memcmp(header->magic, index_magic, sizeof(index_magic)) != 0 || header->version != INDEX_VERSION) {
+        munmap(data, st.st_size);
+
+        return segments;
+    }
+
+    size_t offset = sizeof(Index_Header);
+
+    for (uint64_t i = 0; i < header->segments_count; i++) {
+        Segment segment;
+
+        if (!read_segment((const char *)data + offset, st.st_size - offset, &segment)) {
+            cl_arr_free(segments);
+            munmap(data, st.st_size);
+
+            return CL_ARRAY_INIT;
+        }
+
+        cl_arr_push(segments, segment);
+        offset += segment.size;
+    }
+
+    if (cl_arr_len(segments) > 0) qsort(segments, cl_arr_len(segments), sizeof(Segment), compare_segments);
+
+    *mapped = data;
+    *mapped_size = st.st_size;
+
+    return segments;
+}
+
+static const Segment *find_segment(const Segment *segments, const char *path) {
+    Segment key = { .path = path };
+
+    if (cl_arr_len(segments) == 0) return NULL;
+
+    return bsearch(&key, segments, cl_arr_len(segments), sizeof(Segment), compare_segments);
+}
+
+static bool write_index(const char *path, Byte_Buffer *segments, uint64_t segments_count) {
+    Index_Header header = {
+        .version = INDEX_VERSION,
+        .segments_count = segments_count,
+    };
+
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+
+    size_t length = sizeof(header) + segments->length;
+    char *data = malloc(length);
+
+    memcpy(data, &header, sizeof(header));
+
+    if (segments->length > 0) memcpy(data + sizeof(header), segments->data, segments->length);
+
+    bool ok = write_file_atomically(path, data, length);
+
+    free(data);
+
+    return ok;
+}
+
+// read only mapping of the whole file, NULL when it can't be mapped or is empty
+static char *map_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (data == MAP_FAILED) return NULL;
+
+    *size = st.st_size;
+
+    return data;
+}
+
+static inline bool equal_folded(const char *text, const char *needle, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (fold(text[i]) != (unsigned char)needle[i]) return false;
+    }
+
+    return true;
+}
+
+// case insensitive `memmem`, the needle is already folded. The first byte is
+// looked up with memchr for both cases, which is a lot faster than a byte loop
+static const char *find_folded(const char *haystack, size_t haystack_length, const char *needle, size_t needle_length) {
+    if (needle_length == 0 || needle_length > haystack_length) return NULL;
+
+    unsigned char lower = needle[0];
+    unsigned char upper = lower >= 'a' && lower <= 'z' ? lower - ('a' - 'A') : lower;
+    const char *end = haystack + haystack_length - needle_length + 1;
+
+    const char *next_lower = memchr(haystack, lower, end - haystack);
+    const char *next_upper = upper != lower ? memchr(haystack, upper, end - haystack) : NULL;
+
+    while (next_lower != NULL || next_upper != NULL) {
+        bool is_lower = next_upper == NULL || (next_lower != NULL && next_lower < next_upper);
+        const char *candidate = is_lower ? next_lower : next_upper;
+
+        if (equal_folded(candidate + 1, needle + 1, needle_length - 1)) return candidate;
+
+        if (is_lower) {
+            next_lower = memchr(candidate + 1, lower, end - candidate - 1);
+        } else {
+            next_upper = memchr(candidate + 1, upper, end - candidate - 1);
+        }
+    }
+
+    return NULL;
+}
+
+static bool is_word_start(const char *text, const char *match) {
+    if (match == text) return true;
+
+    unsigned char c = match[-1];
+
+    return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80);
+}
+
+// tasks of the segment that have every trigram of the query, NULL means all of them
+static uint32_t *segment_candidates(const Segment *segment, const uint32_t *query_trigrams, bool *none) {
+    *none = false;
+
+    if (cl_arr_len(query_trigrams) == 0) return NULL;
+
+    const Search_Trigram **lists = malloc(sizeof(Search_Trigram *) * cl_arr_len(query_trigrams));
+    size_t lists_count = 0;
+
+    for (size_t i = 0; i < cl_arr_len(query_trigrams); i++) {
+        size_t low = 0, high = segment->header->trigrams_count;
+
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+
+            if (segment->trigrams[middle].trigram < query_trigrams[i]) low = middle + 1;
+            else high = middle;
+        }
+
+        if (low == segment->header->trigrams_count || segment->trigrams[low].trigram != query_trigrams[i]) {
+            free(lists);
+            *none = true;
+
+            return NULL;
+        }
+
+        lists[lists_count++] = &segment->trigrams[low];
+    }
+
+    // start from the shortest list so the intersection only shrinks it
+    size_t shortest = 0;
+
+    for (size_t i = 1; i < lists_count; i++) {
+        if (lists[i]->count < lists[shortest]->count) shortest = i;
+    }
+
+    uint32_t *candidates = CL_ARRAY_INIT;
+    const uint32_t *first = segment->postings + lists[shortest]->first;
+
+    for (uint32_t i = 0; i < lists[shortest]->count; i++) cl_arr_push(candidates, first[i]);
+
+    for (size_t i = 0; i < lists_count && cl_arr_len(candidates) > 0; i++) {
+        if (i == shortest) continue;
+
+        const uint32_t *postings = segment->postings + lists[i]->first;
+        uint32_t count = lists[i]->count;
+        size_t kept = 0, k = 0;
+
+        for (size_t j = 0; j < cl_arr_len(candidates); j++) {
+            while (k < count && postings[k] < candidates[j]) k++;
+
+            if (k < count && postings[k] == candidates[j]) candidates[kept++] = candidates[j];
+        }
+
+        cl_arr_truncate(candidates, kept);
+    }
+
+    free(lists);
+
+    if (cl_arr_len(candidates) == 0) *none = true;
+
+    return candidates;
+}
+
+// every term must match, the title weighs more than the description and
+// matches at the start of a word more than the ones inside of it
+static bool score_task(const Search_Task *task, const char *content, size_t length, char **terms, Search_Result *result) {
+    if ((uint64_t)task->title_start + task->title_length > length) return false;
+    if ((uint64_t)task->description_start + task->description_length > length) return false;
+
+    const char *title = content + task->title_start;
+    const char *description = content + task->description_start;
+    bool has_match = false;
+
+    result->score = 0;
+
+    for (size_t i = 0; i < cl_arr_len(terms); i++) {
+        size_t term_length = strlen(terms[i]);
+        const char *match = find_folded(title, task->title_length, terms[i], term_length);
+
+        if (match != NULL) {
+            result->score += 4 + (is_word_start(title, match) ? 2 : 0);
+        } else {
+            match = find_folded(description, task->description_length, terms[i], term_length);
+
+            if (match == NULL) return false;
+
+            result->score += 1 + (is_word_start(description, match) ? 1 : 0);
+        }
+
+        uint32_t offset = (uint32_t)(match - content);
+        bool in_title = match >= title && match < title + task->title_length;
+
+        if (!has_match || (in_title && !result->in_title) || (in_title == result->in_title && offset < result->match_offset)) {
+            result->in_title = in_title;
+            result->match_offset = offset;
+        }
+
+        has_match = true;
+    }
+
+    return true;
+}
+
+static int compare_results(const void *a, const void *b) {
+    const Search_Result *x = a;
+    const Search_Result *y = b;
+
+    if (x->score != y->score) return y->score - x->score;
+    if (x->file != y->file) return x->file < y->file ? -1 : 1;
+
+    return (x->task > y->task) - (x->task < y->task);
+}
+
+static void print_location(const char *content, const Search_Task *task, uint32_t offset) {
+    int line = task->line;
+    int col = task->col;
+
+    for (uint32_t i = task->title_start; i < offset; i++) {
+        if (content[i] == '\n') {
+            line++;
+            col = 1;
+        } else {
+            col++;
+        }
+    }
+
+    printf("\"location\":{\"line\":%d,\"col\":%d}", line, col);
+}
+
+static const char *state_names[] = { "todo", "doing", "blocked", "done" };
+
+static void print_result(const Search_Result *result, const Segment *segment, const char *content) {
+    Database_File *file = global_database.files[result->file];
+    const Search_Task *task = &segment->tasks[result->task];
+
+    printf("{\"name\":");
+    print_scaped_string_to_fd((wodo_string_t){ .length = strlen(file->name), .value = file->name }, stdout);
+    printf(",\"path\":");
+    print_scaped_string_to_fd((wodo_string_t){ .length = strlen(file->view_absolute_filepath), .value = file->view_absolute_filepath }, stdout);
+    printf(",\"score\":%d", result->score);
+    printf(",\"title\":{\"content\":");
+    print_scaped_string_to_fd((wodo_string_t){ .length = task->title_length, .value = content + task->title_start }, stdout);
+    printf(",");
+    print_location(content, task, task->title_start);
+    printf("}");
+    printf(",\"state\":{\"content\":\"%s\"}", task->state < 4 ? state_names[task->state] : "todo");
+    printf(",\"match\":{\"field\":\"%s\",", result->in_title ? "title" : "description");
+    print_location(content, task, result->match_offset);
+    printf("}}");
+}
+
+struct Search_Index {
+    char *path;
+    void *mapped;               // the index file as it was on disk
+    size_t mapped_size;
+    Byte_Buffer rebuilt;        // the new index, when something changed
+    Segment *segments;          // CL_ARRAY_INIT, in the database order
+    size_t *segment_files;      // CL_ARRAY_INIT, index in global_database.files of every segment
+};
+
+// brings the index up to date with the database files
+static void update_index(Search_Index *index) {
+    TRACE_SCOPE("update_index");
+
+    index->path = join_paths("%s/%s", database_folder(), index_filename);
+
+    Segment *old_segments = load_index(index->path, &index->mapped, &index->mapped_size);
+
+    index->rebuilt = (Byte_Buffer){0};
+    index->segments = CL_ARRAY_INIT;
+    index->segment_files = CL_ARRAY_INIT;
+
+    bool changed = cl_arr_len(old_segments) != cl_arr_len(global_database.files);
+
+    size_t files_count = cl_arr_len(global_database.files);
+    const Segment **fresh = calloc(files_count + 1, sizeof(Segment *));
+    struct stat *stats = calloc(files_count + 1, sizeof(struct stat));
+    bool *exists = calloc(files_count + 1, sizeof(bool));
+
+    for (size_t i = 0; i < files_count; i++) {
+        Database_File *file = global_database.files[i];
+        struct stat *st = &stats[i];
+
+        exists[i] = stat(file->view_absolute_filepath, st) == 0;
+
+        if (!exists[i]) {
+            changed = true;
+
+            continue;
+        }
+
+        const Segment *segment = find_segment(old_segments, file->view_absolute_filepath);
+
+        if (segment != NULL
+            && segment->header->mtime_sec == st->st_mtim.tv_sec
+            && segment->header->mtime_nsec == st->st_mtim.tv_nsec
+            && segment->header->size == (uint64_t)st->st_size) {
+            fresh[i] = segment;
+        } else {
+            changed = true;
+        }
+    }
+
+    if (!changed) {
+        // nothing to write, the mapped index is used as it is
+        for (size_t i = 0; i < files_count; i++) {
+            cl_arr_push(index->segments, *fresh[i]);
+            cl_arr_push(index->segment_files, i);
+        }
+    } else {
+        Byte_Buffer *rebuilt = &index->rebuilt;
+        size_t *offsets = CL_ARRAY_INIT;
+
+        for (size_t i = 0; i < files_count; i++) {
+            if (!exists[i]) continue;
+
+            Database_File *file = global_database.files[i];
+
+            cl_arr_push(offsets, rebuilt->length);
+            cl_arr_push(index->segment_files, i);
+
+            if (fresh[i] != NULL) {
+                buffer_write(rebuilt, fresh[i]->bytes, fresh[i]->size);
+
+                continue;
+            }
+
+            char *content;
+            size_t length;
+            wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+            if (!read_from_file_no_quit(file->view_absolute_filepath, &content, &length)) {
+                content = NULL;
+                length = 0;
+            }
+
+            reset_parser_state();
+
+            wodo_task_t *tasks = content == NULL ? CL_ARRAY_INIT : parse_tasks_recovering(file->view_absolute_filepath, content, length, &diagnostics);
+
+            build_segment(rebuilt, file->view_absolute_filepath, &stats[i], content, tasks);
+
+            free(content);
+            free_tasks(tasks);
+            free_diagnostics(&diagnostics);
+        }
+
+        // the segments can only point into the buffer once it stopped growing
+        for (size_t i = 0; i < cl_arr_len(offsets); i++) {
+            Segment segment;
+
+            bool ok = read_segment(rebuilt->data + offsets[i], rebuilt->length - offsets[i], &segment);
+
+            assert(ok && "invalid search index segment");
+
+            cl_arr_push(index->segments, segment);
+        }
+
+        cl_arr_free(offsets);
+
+        if (!write_index(index->path, rebuilt, cl_arr_len(index->segments))) {
+            fprintf(stderr, "warning: could not write the search index %s: %s\n", index->path, strerror(errno));
+        }
+    }
+
+    free(fresh);
+    free(stats);
+    free(exists);
+    cl_arr_free(old_segments);
+}
+
+static void close_index(Search_Index *index) {
+    free(index->rebuilt.data);
+
+    if (index->mapped != NULL) munmap(index->mapped, index->mapped_size);
+
+    free(index->path);
+    cl_arr_free(index->segments);
+    cl_arr_free(index->segment_files);
+}
+
+int search_action(const char *query, Flags flags) {
+    TRACE_SCOPE("search");
+
+    init_fold_table();
+
+    // lower case terms and the trigrams all of them need
+    char **terms = CL_ARRAY_INIT;
+    uint32_t *query_trigrams = CL_ARRAY_INIT;
+    char *folded_query = strdup(query);
+
+    for (char *term = strtok(folded_query, " \t\n"); term != NULL; term = strtok(NULL, " \t\n")) {
+        for (char *c = term; *c; c++) *c = fold(*c);
+
+        cl_arr_push(terms, term);
+
+        for (size_t i = 0; i + 3 <= strlen(term); i++) {
+            cl_arr_push(query_trigrams, trigram_at(term + i));
+        }
+    }
+
+    if (cl_arr_len(terms) == 0) {
+        fprintf(stderr, "error: empty search query\n");
+        free(folded_query);
+
+        return 1;
+    }
+
+    Search_Index index;
+
+    update_index(&index);
+
+    Segment *segments = index.segments;
+    size_t *segment_files = index.segment_files;
+
+    TRACE_BEGIN("query");
+
+    Search_Result *results = CL_ARRAY_INIT;
+    // file contents of the segments with results, needed to print them
+    char **contents = calloc(cl_arr_len(segments) + 1, sizeof(char *));
+    size_t *content_sizes = calloc(cl_arr_len(segments) + 1, sizeof(size_t));
+
+    for (size_t i = 0; i < cl_arr_len(segments); i++) {
+        const Segment *segment = &segments[i];
+        bool none;
+
+        uint32_t *candidates = segment_candidates(segment, query_trigrams, &none);
+
+        if (none || segment->header->tasks_count == 0) {
+            cl_arr_free(candidates);
+
+            continue;
+        }
+
+        size_t length;
+        char *content = map_file(segment->path, &length);
+
+        if (content == NULL) {
+            cl_arr_free(candidates);
+
+            continue;
+        }
+
+        size_t count = candidates == NULL ? segment->header->tasks_count : cl_arr_len(candidates);
+        size_t results_before = cl_arr_len(results);
+
+        for (size_t j = 0; j < count; j++) {
+            uint32_t task = candidates == NULL ? (uint32_t)j : candidates[j];
+            Search_Result result = { .file = i, .task = task };
+
+            if (score_task(&segment->tasks[task], content, length, terms, &result)) {
+                cl_arr_push(results, result);
+            }
+        }
+
+        if (cl_arr_len(results) > results_before) {
+            contents[i] = content;
+            content_sizes[i] = length;
+        } else {
+            munmap(content, length);
+        }
+
+        cl_arr_free(candidates);
+    }
+
+    if (cl_arr_len(results) > 0) qsort(results, cl_arr_len(results), sizeof(Search_Result), compare_results);
+
+    TRACE_END();
+
+    size_t limit = flags.limit > 0 && (size_t)flags.limit < cl_arr_len(results) ? (size_t)flags.limit : cl_arr_len(results);
+
+    if (!flags.ndjson) printf("[");
+
+    for (size_t i = 0; i < limit; i++) {
+        Search_Result result = results[i];
+
+        // `file` is the segment index until here
+        const Segment *segment = &segments[result.file];
+        result.file = segment_files[result.file];
+
+        if (i > 0 && !flags.ndjson) printf(",");
+
+        print_result(&result, segment, contents[results[i].file]);
+
+        if (flags.ndjson) printf("\n");
+    }
+
+    if (!flags.ndjson) printf("]\n");
+
+    for (size_t i = 0; i < cl_arr_len(segments); i++) {
+        if (contents[i] != NULL) munmap(contents[i], content_sizes[i]);
+    }
+
+    free(contents);
+    free(content_sizes);
+    free(folded_query);
+    close_index(&index);
+    cl_arr_free(results);
+    cl_arr_free(terms);
+    cl_arr_free(query_trigrams);
+
+    return 0;
+}
+
+Task_Titles load_task_titles(void) {
+    TRACE_SCOPE("load_task_titles");
+
+    Task_Titles titles = { .titles = CL_ARRAY_INIT, .index = malloc(sizeof(Search_Index)) };
+
+    update_index(titles.index);
+
+    const Search_Index *index = titles.index;
+
+    for (size_t i = 0; i < cl_arr_len(index->segments); i++) {
+        const Segment *segment = &index->segments[i];
+
+        for (uint32_t j = 0; j < segment->header->tasks_count; j++) {
+            const Search_Task *task = &segment->tasks[j];
+
+            Task_Title title = {
+                .file = index->segment_files[i],
+                .title = { .value = segment->titles + task->title_copy, .length = task->title_length },
+                .line = task->line,
+                .col = task->col,
+                .state = (wodo_task_state_t)task->state,
+            };
+
+            cl_arr_push(titles.titles, title);
+        }
+    }
+
+    return titles;
+}
+
+void free_task_titles(Task_Titles *titles) {
+    if (titles->index != NULL) {
+        close_index(titles->index);
+        free(titles->index);
+    }
+
+    cl_arr_free(titles->titles);
+}
@@ -0,0 +1,34 @@
+#ifndef _WODO_SEARCH_H_
+#define _WODO_SEARCH_H_
+
+#include "argparser.h"
+#include "systemtypes.h"
+
+typedef struct {
+    size_t file;                // index in global_database.files
+    wodo_string_t title;        // points into the search index
+    int line, col;              // location of the title
+    wodo_task_state_t state;
+} Task_Title;
+
+typedef struct Search_Index Search_Index;
+
+typedef struct {
+    Task_Title *titles;         // CL_ARRAY_INIT
+    Search_Index *index;        // the titles point into it
+} Task_Titles;
+
+// `wodo search <query>`
+//
+// every whitespace separated term of the query must be found (case
+// insensitive, as a substring) in the title or in the description of a task.
+// Candidates come from a trigram index kept in .wodo/.search-index, which is
+// updated only for the files that changed since the last search.
+int search_action(const char *query, Flags flags);
+
+// titles of every task in the repository, in the database order. They are
+// copied in the search index, so only the files that changed are read.
+Task_Titles load_task_titles(void);
+void free_task_titles(Task_Titles *titles);
+
+#endif // !_WODO_SEARCH_H_
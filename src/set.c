@@ -0,0 +1,563 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "set.h"
+#include "arr.h"
+#include "database.h"
+#include "io.h"
+#include "json.h"
+#include "parser.h"
+#include "utils.h"
+#include "trace.h"
+
+#define SET_MAX_THREADS 16
+
+static const char *state_names[] = { "todo", "doing", "blocked", "done" };
+
+typedef struct {
+    bool has_state;
+    wodo_task_state_t state;
+    wodo_string_t *add_tags;        // CL_ARRAY
+    wodo_string_t *remove_tags;     // CL_ARRAY
+    wodo_string_t *rename_from;     // CL_ARRAY
+    wodo_string_t *rename_to;       // CL_ARRAY, same length as `rename_from`
+} Edit;
+
+typedef struct {
+    size_t start, end;              // replaced bytes of the file
+    char *replacement;              // CL_ARRAY
+} Patch;
+
+typedef struct {
+    wodo_node_t title;
+    wodo_task_state_t old_state;
+    bool state_changed;
+    wodo_string_t *added_tags;      // CL_ARRAY
+    wodo_string_t *removed_tags;    // CL_ARRAY
+} Task_Change;
+
+typedef struct {
+    Database_File *file;
+    // the changes point into it, so it's kept until the summary is printed
+    char *content;
+    Task_Change *changes;           // CL_ARRAY
+    wodo_diagnostic_t *diagnostics; // CL_ARRAY
+    bool failed;
+} File_Result;
+
+typedef struct {
+    Flags flags;
+    Edit edit;
+    File_Result *results;
+    size_t count;
+    size_t next;
+} Set_Job;
+
+static bool is_valid_tag(const char *tag, size_t length) {
+    if (length == 0) return false;
+
+    for (size_t i = 0; i < length; i++) {
+        if (!((tag[i] >= 'a' && tag[i] <= 'z') || tag[i] == '_')) return false;
+    }
+
+    return true;
+}
+
+static wodo_string_t cstring(const char *value, size_t length) {
+    return (wodo_string_t){ .value = value, .length = length };
+}
+
+static bool string_eq(wodo_string_t a, wodo_string_t b) {
+    return a.length == b.length && memcmp(a.value, b.value, a.length) == 0;
+}
+
+static bool contains_tag(wodo_string_t *tags, wodo_string_t tag) {
+    for (size_t i = 0; i < cl_arr_len(tags); i++) {
+        if (string_eq(tags[i], tag)) return true;
+    }
+
+    return false;
+}
+
+// returns false and prints the error when a flag is invalid
+static bool read_edit(Flags flags, Edit *edit) {
+    *edit = (Edit){0};
+
+    if (flags.set_state != NULL) {
+        bool found = false;
+
+        for (size_t i = 0; i < sizeof(state_names) / sizeof(state_names[0]); i++) {
+            if (strcmp(flags.set_state, state_names[i]) == 0) {
+                edit->state = (wodo_task_state_t)i;
+                found = true;
+            }
+        }
+
+        if (!found) {
+            fprintf(stderr, "error: invalid state \"%s\", expected todo, doing, blocked or done\n", flags.set_state);
+
+            return false;
+        }
+
+        edit->has_state = true;
+    }
+
+    for (size_t i = 0; i < cl_arr_len(flags.add_tags); i++) {
+        const char *tag = flags.add_tags[i];
+
+        if (!is_valid_tag(tag, strlen(tag))) {
+            fprintf(stderr, "error: invalid tag \"%s\", tags only have lowercase letters and '_'\n", tag);
+
+            return false;
+        }
+
+        cl_arr_push(edit->add_tags, cstring(tag, strlen(tag)));
+    }
+
+    for (size_t i = 0; i < cl_arr_len(flags.remove_tags); i++) {
+        const char *tag = flags.remove_tags[i];
+
+        cl_arr_push(edit->remove_tags, cstring(tag, strlen(tag)));
+    }
+
+    for (size_t i = 0; i < cl_arr_len(flags.rename_tags); i++) {
+        const char *rename = flags.rename_tags[i];
+        const char *separator = strchr(rename, '=');
+
+        if (separator == NULL || !is_valid_tag(separator + 1, strlen(separator + 1))) {
+            fprintf(stderr, "error: invalid tag rename \"%s\", expected <old>=<new>\n", rename);
+
+            return false;
+        }
+
+        cl_arr_push(edit->rename_from, cstring(rename, separator - rename));
+        cl_arr_push(edit->rename_to, cstring(separator + 1, strlen(separator + 1)));
+    }
+
+    if (!edit->has_state && cl_arr_len(edit->add_tags) == 0 && cl_arr_len(edit->remove_tags) == 0 && cl_arr_len(edit->rename_from) == 0) {
+        fprintf(stderr, "error: nothing to set, use --state, --add-tag, --remove-tag or --rename-tag\n");
+
+        return false;
+    }
+
+    return true;
+}
+
+static void free_edit(Edit *edit) {
+    cl_arr_free(edit->add_tags);
+    cl_arr_free(edit->remove_tags);
+    cl_arr_free(edit->rename_from);
+    cl_arr_free(edit->rename_to);
+}
+
+// the tags of the task after the edit (CL_ARRAY)
+static wodo_string_t *edited_tags(const Edit *edit, wodo_node_t *tags) {
+    wodo_string_t *result = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(tags); i++) {
+        wodo_string_t tag = tags[i].string;
+
+        for (size_t j = 0; j < cl_arr_len(edit->rename_from); j++) {
+            if (string_eq(tag, edit->rename_from[j])) {
+                tag = edit->rename_to[j];
+
+                break;
+            }
+        }
+
+        if (contains_tag(edit->remove_tags, tag) || contains_tag(result, tag)) continue;
+
+        cl_arr_push(result, tag);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(edit->add_tags); i++) {
+        if (!contains_tag(result, edit->add_tags[i])) cl_arr_push(result, edit->add_tags[i]);
+    }
+
+    return result;
+}
+
+// byte offset of the beginning of `target_line`, walking from `offset` at `line`
+static size_t line_offset(const char *content, size_t length, size_t offset, int line, int target_line) {
+    while (line < target_line) {
+        const char *newline = memchr(content + offset, '\n', length - offset);
+
+        if (newline == NULL) return length;
+
+        offset = newline + 1 - content;
+        line++;
+    }
+
+    return offset;
+}
+
+static size_t line_end(const char *content, size_t length, size_t offset) {
+    const char *newline = memchr(content + offset, '\n', length - offset);
+    size_t end = newline == NULL ? length : (size_t)(newline - content);
+
+    if (end > offset && content[end - 1] == '\r') end--;
+
+    return end;
+}
+
+static void push_text(char **out, const char *text, size_t length) {
+    for (size_t i = 0; i < length; i++) cl_arr_push(*out, text[i]);
+}
+
+static char *tags_line(wodo_string_t *tags) {
+    char *line = CL_ARRAY_INIT;
+
+    push_text(&line, ".tags", 5);
+
+    for (size_t i = 0; i < cl_arr_len(tags); i++) {
+        cl_arr_push(line, ' ');
+        push_text(&line, tags[i].value, tags[i].length);
+    }
+
+    return line;
+}
+
+// appends the patches of `task` and returns true when anything changes
+static bool patch_task(const Edit *edit, const char *content, size_t length, wodo_task_t task, Patch **patches, Task_Change *change) {
+    // the title points after the '%'
+    size_t title_line = task.title.string.value - content;
+
+    while (title_line > 0 && content[title_line - 1] != '\n') title_line--;
+
+    int line = task.title.location.line;
+    bool changed = false;
+
+    *change = (Task_Change){ .title = task.title, .old_state = task.state_property.state };
+
+    size_t state_line = line_offset(content, length, title_line, line, task.state_property.location.line);
+
+    if (edit->has_state && edit->state != task.state_property.state) {
+        // .state <token>
+        size_t start = state_line + 6;
+
+        while (start < length && (content[start] == ' ' || content[start] == '\t')) start++;
+
+        size_t end = start;
+
+        while (end < length && content[end] >= 'a' && content[end] <= 'z') end++;
+
+        Patch patch = { .start = start, .end = end, .replacement = CL_ARRAY_INIT };
+
+        push_text(&patch.replacement, state_names[edit->state], strlen(state_names[edit->state]));
+        cl_arr_push(*patches, patch);
+
+        change->state_changed = true;
+        changed = true;
+    }
+
+    wodo_node_t *old_tags = task.tags_property.node_array;
+    wodo_string_t *new_tags = edited_tags(edit, old_tags);
+
+    for (size_t i = 0; i < cl_arr_len(new_tags); i++) {
+        bool found = false;
+
+        for (size_t j = 0; j < cl_arr_len(old_tags) && !found; j++) found = string_eq(new_tags[i], old_tags[j].string);
+
+        if (!found) cl_arr_push(change->added_tags, new_tags[i]);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(old_tags); i++) {
+        if (!contains_tag(new_tags, old_tags[i].string)) cl_arr_push(change->removed_tags, old_tags[i].string);
+    }
+
+    // a rename to a tag that's already there only drops the duplicate
+    bool tags_changed = cl_arr_len(change->added_tags) > 0 || cl_arr_len(change->removed_tags) > 0 || cl_arr_len(new_tags) != cl_arr_len(old_tags);
+
+    if (tags_changed) {
+        Patch patch = { .replacement = tags_line(new_tags) };
+
+        if (task.tags_property.location.col != 0) {
+            patch.start = line_offset(content, length, title_line, line, task.tags_property.location.line);
+            patch.end = line_end(content, length, patch.start);
+        } else {
+            // a new .tags line right after the .state line
+            patch.start = line_end(content, length, state_line);
+
+            if (patch.start < length && content[patch.start] == '\r') patch.start++;
+
+            if (patch.start < length) {
+                patch.start++;
+                cl_arr_push(patch.replacement, '\n');
+            } else {
+                // the .state line is the last one of the file
+                char *line = CL_ARRAY_INIT;
+
+                cl_arr_push(line, '\n');
+                push_text(&line, patch.replacement, cl_arr_len(patch.replacement));
+                cl_arr_free(patch.replacement);
+                patch.replacement = line;
+            }
+
+            patch.end = patch.start;
+        }
+
+        cl_arr_push(*patches, patch);
+        changed = true;
+    }
+
+    cl_arr_free(new_tags);
+
+    return changed;
+}
+
+static int compare_patches(const void *a, const void *b) {
+    const Patch *x = a;
+    const Patch *y = b;
+
+    return x->start < y->start ? -1 : x->start > y->start;
+}
+
+static void set_file(Set_Job *job, File_Result *result) {
+    const char *path = result->file->view_absolute_filepath;
+
+    TRACE_SCOPE_ARG("set_file", path);
+
+    struct stat st;
+    char *content;
+    size_t length;
+
+    if (stat(path, &st) != 0 || !read_from_file_no_quit(path, &content, &length)) {
+        push_diagnostic(&result->diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+        result->failed = true;
+
+        return;
+    }
+
+    result->content = content;
+
+    reset_parser_state();
+
+    wodo_task_t *tasks = parse_tasks_recovering(path, content, length, &result->diagnostics);
+    Patch *patches = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        if (!default_task_predicate(tasks[i], job->flags)) continue;
+
+        Task_Change change;
+
+        if (patch_task(&job->edit, content, length, tasks[i], &patches, &change)) {
+            cl_arr_push(result->changes, change);
+        } else {
+            cl_arr_free(change.added_tags);
+            cl_arr_free(change.removed_tags);
+        }
+    }
+
+    if (cl_arr_len(patches) > 0 && !job->flags.dry_run) {
+        qsort(patches, cl_arr_len(patches), sizeof(Patch), compare_patches);
+
+        size_t patched_length = length;
+
+        for (size_t i = 0; i < cl_arr_len(patches); i++) {
+            patched_length += cl_arr_len(patches[i].replacement) - (patches[i].end - patches[i].start);
+        }
+
+        char *patched = malloc(patched_length + 1);
+        size_t cursor = 0;
+        size_t written = 0;
+
+        for (size_t i = 0; i < cl_arr_len(patches); i++) {
+            memcpy(patched + written, content + cursor, patches[i].start - cursor);
+            written += patches[i].start - cursor;
+
+            memcpy(patched + written, patches[i].replacement, cl_arr_len(patches[i].replacement));
+            written += cl_arr_len(patches[i].replacement);
+
+            cursor = patches[i].end;
+        }
+
+        memcpy(patched + written, content + cursor, length - cursor);
+
+        struct stat now;
+
+        // someone else saved the file while it was being edited
+        if (stat(path, &now) != 0 || now.st_mtim.tv_sec != st.st_mtim.tv_sec || now.st_mtim.tv_nsec != st.st_mtim.tv_nsec || now.st_size != st.st_size) {
+            push_diagnostic(&result->diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "file changed while it was being edited, nothing was written");
+            result->failed = true;
+        } else if (!write_file_atomically(path, patched, patched_length)) {
+            push_diagnostic(&result->diagnostics, path, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not write file: %s", strerror(errno));
+            result->failed = true;
+        }
+
+        free(patched);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(patches); i++) cl_arr_free(patches[i].replacement);
+
+    cl_arr_free(patches);
+    free_tasks(tasks);
+}
+
+static void *set_worker(void *data) {
+    Set_Job *job = data;
+
+    while (true) {
+        size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+
+        if (i >= job->count) break;
+
+        set_file(job, &job->results[i]);
+    }
+
+    return NULL;
+}
+
+static void print_tags_as_json(wodo_string_t *tags) {
+    printf("[");
+
+    for (size_t i = 0; i < cl_arr_len(tags); i++) {
+        if (i > 0) printf(",");
+
+        printf("\"%.*s\"", (int)tags[i].length, tags[i].value);
+    }
+
+    printf("]");
+}
+
+static void print_change_as_json(const Task_Change *change, const Edit *edit, Flags flags) {
+    printf("{\"title\":{\"content\":");
+    print_scaped_string_to_fd(change->title.string, stdout);
+
+    if (!flags.no_locations) {
+        printf(",\"location\":{\"line\":%d,\"col\":%d}", change->title.location.line, change->title.location.col);
+    }
+
+    printf("}");
+
+    if (change->state_changed) {
+        printf(",\"state\":{\"from\":\"%s\",\"to\":\"%s\"}", state_names[change->old_state], state_names[edit->state]);
+    }
+
+    if (cl_arr_len(change->added_tags) > 0 || cl_arr_len(change->removed_tags) > 0) {
+        printf(",\"tags\":{\"added\":");
+        print_tags_as_json(change->added_tags);
+        printf(",\"removed\":");
+        print_tags_as_json(change->removed_tags);
+        printf("}");
+    }
+
+    printf("}");
+}
+
+static void print_summary(Set_Job *job) {
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+    size_t changed_files = 0;
+    size_t changed_tasks = 0;
+    bool first = true;
+
+    printf("{\"dry_run\":%s,\"files\":[", job->flags.dry_run ? "true" : "false");
+
+    for (size_t i = 0; i < job->count; i++) {
+        File_Result *result = &job->results[i];
+
+        for (size_t j = 0; j < cl_arr_len(result->diagnostics); j++) cl_arr_push(diagnostics, result->diagnostics[j]);
+
+        if (cl_arr_len(result->changes) == 0 || result->failed) continue;
+
+        changed_files++;
+        changed_tasks += cl_arr_len(result->changes);
+
+        if (!first) printf(",");
+
+        first = false;
+
+        printf("{\"name\":");
+        print_scaped_string_to_fd(cstring(result->file->name, strlen(result->file->name)), stdout);
+        printf(",\"path\":");
+        print_scaped_string_to_fd(cstring(result->file->view_absolute_filepath, strlen(result->file->view_absolute_filepath)), stdout);
+        printf(",\"tasks\":[");
+
+        for (size_t j = 0; j < cl_arr_len(result->changes); j++) {
+            if (j > 0) printf(",");
+
+            print_change_as_json(&result->changes[j], &job->edit, job->flags);
+        }
+
+        printf("]}");
+    }
+
+    printf("],\"changed\":{\"files\":%zu,\"tasks\":%zu},\"diagnostics\":", changed_files, changed_tasks);
+    print_diagnostics_to_stdout_as_json(diagnostics);
+    printf("}\n");
+
+    // the messages are owned by the results
+    cl_arr_free(diagnostics);
+}
+
+static size_t set_threads_count(size_t files_count) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t count = cpus > 1 ? (size_t)cpus : 1;
+
+    if (count > files_count) count = files_count;
+    if (count > SET_MAX_THREADS) count = SET_MAX_THREADS;
+
+    return count;
+}
+
+int set_action(Flags flags) {
+    TRACE_SCOPE("set");
+
+    Set_Job job = { .flags = flags };
+
+    if (!read_edit(flags, &job.edit)) return 1;
+
+    job.results = calloc(cl_arr_len(global_database.files) + 1, sizeof(File_Result));
+
+    for (size_t i = 0; i < cl_arr_len(global_database.files); i++) {
+        if (global_database.files[i]->view_deleted) continue;
+
+        job.results[job.count++].file = global_database.files[i];
+    }
+
+    // the descriptions are not needed, the tags are always
+    set_parser_options((wodo_parser_options_t){ .skip_description = true });
+
+    size_t threads_count = set_threads_count(job.count);
+    pthread_t threads[SET_MAX_THREADS];
+    bool started[SET_MAX_THREADS] = {0};
+
+    // this thread is one of the workers
+    for (size_t i = 1; i < threads_count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, set_worker, &job) == 0;
+    }
+
+    set_worker(&job);
+
+    for (size_t i = 1; i < threads_count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    print_summary(&job);
+
+    int return_code = 0;
+
+    for (size_t i = 0; i < job.count; i++) {
+        File_Result *result = &job.results[i];
+
+        if (result->failed) return_code = 1;
+
+        for (size_t j = 0; j < cl_arr_len(result->changes); j++) {
+            cl_arr_free(result->changes[j].added_tags);
+            cl_arr_free(result->changes[j].removed_tags);
+        }
+
+        cl_arr_free(result->changes);
+        free_diagnostics(&result->diagnostics);
+        free(result->content);
+    }
+
+    free(job.results);
+    free_edit(&job.edit);
+
+    return return_code;
+}
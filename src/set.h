@@ -0,0 +1,15 @@
+#ifndef _WODO_SET_H_
+#define _WODO_SET_H_
+
+#include "argparser.h"
+
+// `wodo set [-ft <tag>] [-fs <state>] --state <state> --add-tag <tag> ...`
+//
+// edits every task that matches the filters in every database file. Only the
+// state token and the .tags line of the changed tasks are rewritten, the rest
+// of the file is kept byte by byte. Files are processed at the same time and
+// every changed file is replaced atomically. Prints a summary of the changes,
+// with --dry-run nothing is written.
+int set_action(Flags flags);
+
+#endif // !_WODO_SET_H_
@@ -0,0 +1,629 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "sort.h"
+#include "arr.h"
+#include "database.h"
+#include "date.h"
+#include "io.h"
+#include "json.h"
+#include "parser.h"
+#include "properties.h"
+#include "taskid.h"
+#include "utils.h"
+#include "trace.h"
+
+/*
+ * .wodo/.sort-index layout (native endianness, like the database file):
+ *
+ *   Index_Header
+ *   Summary * entries_count, sorted by path_hash
+ *
+ * A summary is only used while the mtime and the size of its file are the
+ * same, files with diagnostics have none so they are always read again.
+ */
+static const char *index_file_name = ".sort-index";
+static const char index_magic[8] = "WODOSRT";
+
+#define SORT_INDEX_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t entries_count;
+} Index_Header;
+
+typedef struct {
+    // fnv1a of the relative path of the file
+    uint64_t path_hash;
+    int64_t mtime_sec, mtime_nsec;
+    uint64_t size;
+    // unix timestamps of the oldest and newest task
+    int64_t min_date, max_date;
+    // one bit per state of its tasks
+    uint32_t states;
+    uint32_t tasks_count;
+} Summary;
+
+typedef enum {
+    Sort_Key_Date,
+    Sort_Key_State,
+    Sort_Key_Title,
+    Sort_Key_File,
+    Sort_Key_Mtime,
+    Sort_Key_Property,
+} Sort_Kind;
+
+typedef struct {
+    Sort_Kind kind;
+    bool descending;
+    // index in the registry for Sort_Key_Property
+    uint32_t property;
+} Sort_Key;
+
+typedef struct {
+    Database_File *file;
+    struct stat st;
+    bool has_stat;
+    // rank of the name, for Sort_Key_File
+    uint32_t name_rank;
+    // best key any of its tasks can have
+    uint64_t bound;
+    // kept while any of its tasks is in the heap
+    char *content;
+    wodo_task_t *tasks;
+    Task_Id *ids;
+    size_t references;
+    bool visited;
+} Sort_File;
+
+// tasks are compared by `key` first, the title is only needed by Sort_Key_Title
+typedef struct {
+    uint64_t key;
+    uint32_t file;
+    uint32_t task;
+    wodo_string_t title;
+} Sort_Entry;
+
+typedef struct {
+    Sort_Key key;
+    size_t limit;
+    Sort_File *files;
+    Sort_Entry *heap;   // CL_ARRAY
+} Sorter;
+
+// maps a signed value to an unsigned one with the same order
+static inline uint64_t ordered(int64_t value) {
+    return (uint64_t)value ^ (1ULL << 63);
+}
+
+static inline uint64_t directed(const Sort_Key *key, uint64_t value) {
+    return key->descending ? ~value : value;
+}
+
+static bool parse_sort_key(const char *text, Sort_Key *key) {
+    static const struct { const char *name; Sort_Kind kind; } keys[] = {
+        { "date", Sort_Key_Date },
+        { "state", Sort_Key_State },
+        { "title", Sort_Key_Title },
+        { "file", Sort_Key_File },
+        { "mtime", Sort_Key_Mtime },
+    };
+
+    key->descending = text[0] == '-';
+
+    if (key->descending) text++;
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (strcmp(text, keys[i].name) == 0) {
+            key->kind = keys[i].kind;
+
+            return true;
+        }
+    }
+
+    int property = find_property(text, strlen(text));
+
+    if (property < 0) return false;
+
+    key->kind = Sort_Key_Property;
+    key->property = property;
+
+    return true;
+}
+
+static wodo_string_t trimmed_title(wodo_task_t task) {
+    wodo_string_t title = task.title.string;
+
+    while (title.length > 0 && title.value[0] == ' ') {
+        title.value++;
+        title.length--;
+    }
+
+    while (title.length > 0 && title.value[title.length - 1] == ' ') title.length--;
+
+    return title;
+}
+
+// first 8 bytes of the title, big endian so they compare like memcmp
+static uint64_t title_prefix(wodo_string_t title) {
+    uint64_t prefix = 0;
+
+    for (size_t i = 0; i < 8; i++) {
+        prefix = (prefix << 8) | (i < title.length ? (unsigned char)title.value[i] : 0);
+    }
+
+    return prefix;
+}
+
+static inline int64_t mtime_of(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static Sort_Entry make_entry(const Sorter *sorter, uint32_t file, uint32_t task) {
+    const Sort_Key *key = &sorter->key;
+    const Sort_File *it = &sorter->files[file];
+    wodo_task_t value = it->tasks[task];
+    Sort_Entry entry = { .file = file, .task = task };
+
+    switch (key->kind) {
+        case Sort_Key_Date: entry.key = directed(key, ordered(datetime_to_timestamp(value.date_property.datetime))); break;
+        case Sort_Key_State: entry.key = directed(key, value.state_property.state); break;
+        case Sort_Key_Title: {
+            entry.title = trimmed_title(value);
+            entry.key = directed(key, title_prefix(entry.title));
+        } break;
+        case Sort_Key_File: entry.key = directed(key, it->name_rank); break;
+        case Sort_Key_Mtime: entry.key = directed(key, ordered(mtime_of(&it->st))); break;
+        case Sort_Key_Property: {
+            const wodo_property_value_t *property = task_property(value, key->property);
+
+            // the tasks without it go last in both directions
+            entry.key = property == NULL ? UINT64_MAX : directed(key, ordered(property->value));
+        } break;
+        default: assert(0 && "unimplemented sort key");
+    }
+
+    return entry;
+}
+
+static int compare_titles(wodo_string_t a, wodo_string_t b) {
+    size_t length = a.length < b.length ? a.length : b.length;
+    int compared = memcmp(a.value, b.value, length);
+
+    if (compared != 0) return compared;
+
+    return (a.length > b.length) - (a.length < b.length);
+}
+
+// a goes after b: bigger key, then bigger title, then later in the database
+static bool is_worse(const Sorter *sorter, const Sort_Entry *a, const Sort_Entry *b) {
+    if (a->key != b->key) return a->key > b->key;
+
+    if (sorter->key.kind == Sort_Key_Title) {
+        int compared = compare_titles(a->title, b->title);
+
+        if (compared != 0) return sorter->key.descending ? compared < 0 : compared > 0;
+    }
+
+    if (a->file != b->file) return a->file > b->file;
+
+    return a->task > b->task;
+}
+
+static void heap_sift_down(const Sorter *sorter, Sort_Entry *heap, size_t count, size_t i) {
+    for (;;) {
+        size_t worst = i;
+        size_t left = i * 2 + 1;
+        size_t right = left + 1;
+
+        if (left < count && is_worse(sorter, &heap[left], &heap[worst])) worst = left;
+        if (right < count && is_worse(sorter, &heap[right], &heap[worst])) worst = right;
+
+        if (worst == i) return;
+
+        Sort_Entry swap = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = swap;
+        i = worst;
+    }
+}
+
+static void heap_sift_up(const Sorter *sorter, Sort_Entry *heap, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+
+        if (!is_worse(sorter, &heap[i], &heap[parent])) return;
+
+        Sort_Entry swap = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = swap;
+        i = parent;
+    }
+}
+
+static void free_file_tasks(Sort_File *file) {
+    free_tasks(file->tasks);
+    cl_arr_free(file->ids);
+    free(file->content);
+
+    file->tasks = CL_ARRAY_INIT;
+    file->content = NULL;
+}
+
+static void release_file(Sorter *sorter, uint32_t file) {
+    Sort_File *it = &sorter->files[file];
+
+    if (--it->references == 0 && it->visited) free_file_tasks(it);
+}
+
+// keeps the best `limit` entries with the worst one on top, 0 keeps all of them
+static void keep_entry(Sorter *sorter, Sort_Entry entry) {
+    size_t count = cl_arr_len(sorter->heap);
+
+    if (sorter->limit == 0 || count < sorter->limit) {
+        cl_arr_push(sorter->heap, entry);
+        sorter->files[entry.file].references++;
+
+        if (sorter->limit != 0) heap_sift_up(sorter, sorter->heap, count);
+    } else if (is_worse(sorter, &sorter->heap[0], &entry)) {
+        uint32_t evicted = sorter->heap[0].file;
+
+        sorter->heap[0] = entry;
+        sorter->files[entry.file].references++;
+        heap_sift_down(sorter, sorter->heap, count, 0);
+
+        release_file(sorter, evicted);
+    }
+}
+
+// in place, best first: the worst entry of the heap goes to the end until
+// it's empty. Without a limit the entries are not a heap yet
+static void sort_entries(Sorter *sorter) {
+    Sort_Entry *heap = sorter->heap;
+    size_t count = cl_arr_len(heap);
+
+    if (sorter->limit == 0) {
+        for (size_t i = count / 2; i > 0; i--) heap_sift_down(sorter, heap, count, i - 1);
+    }
+
+    while (count > 1) {
+        Sort_Entry swap = heap[0];
+        heap[0] = heap[count - 1];
+        heap[count - 1] = swap;
+
+        heap_sift_down(sorter, heap, --count, 0);
+    }
+}
+
+// the file can't have a task better than the kept ones
+static bool can_skip(const Sorter *sorter, const Sort_File *file) {
+    return sorter->limit != 0 && cl_arr_len(sorter->heap) == sorter->limit && file->bound > sorter->heap[0].key;
+}
+
+static int compare_files_by_bound(const void *a, const void *b) {
+    const Sort_File *x = *(Sort_File *const *)a;
+    const Sort_File *y = *(Sort_File *const *)b;
+
+    if (x->bound != y->bound) return x->bound < y->bound ? -1 : 1;
+
+    // keeps the database order
+    return (x > y) - (x < y);
+}
+
+static int compare_files_by_name(const void *a, const void *b) {
+    const Sort_File *x = *(Sort_File *const *)a;
+    const Sort_File *y = *(Sort_File *const *)b;
+    int compared = strcmp(x->file->name, y->file->name);
+
+    if (compared != 0) return compared;
+
+    return (x > y) - (x < y);
+}
+
+static int compare_summaries(const void *a, const void *b) {
+    uint64_t x = ((const Summary *)a)->path_hash;
+    uint64_t y = ((const Summary *)b)->path_hash;
+
+    return (x > y) - (x < y);
+}
+
+static char *index_path(void) {
+    return join_paths("%s/%s", database_folder(), index_file_name);
+}
+
+// a missing or broken index only means every file is read
+static Summary *read_index(void) {
+    Summary *summaries = CL_ARRAY_INIT;
+    char *path = index_path();
+    char *content;
+    size_t length;
+
+    if (!read_from_file_no_quit(path, &content, &length)) {
+        free(path);
+
+        return summaries;
+    }
+
+    free(path);
+
+    Index_Header header;
+
+    if (length >= sizeof(header)) {
+        memcpy(&header, content, sizeof(header));
+
+        if (memcmp(header.magic, index_magic, sizeof(index_magic)) == 0 && header.version == SORT_INDEX_VERSION && (length - sizeof(header)) / sizeof(Summary) == header.entries_count) {
+            for (uint32_t i = 0; i < header.entries_count; i++) {
+                Summary summary;
+
+                memcpy(&summary, content + sizeof(header) + i * sizeof(Summary), sizeof(summary));
+                cl_arr_push(summaries, summary);
+            }
+        }
+    }
+
+    free(content);
+
+    return summaries;
+}
+
+static bool write_index(Summary *summaries) {
+    if (cl_arr_len(summaries) > 0) qsort(summaries, cl_arr_len(summaries), sizeof(Summary), compare_summaries);
+
+    Index_Header header = {
+        .version = SORT_INDEX_VERSION,
+        .entries_count = cl_arr_len(summaries),
+    };
+
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+
+    size_t length = sizeof(header) + cl_arr_len(summaries) * sizeof(Summary);
+    char *content = malloc(length);
+
+    memcpy(content, &header, sizeof(header));
+    if (cl_arr_len(summaries) > 0) memcpy(content + sizeof(header), summaries, cl_arr_len(summaries) * sizeof(Summary));
+
+    char *path = index_path();
+    bool ok = write_file_atomically(path, content, length);
+
+    free(path);
+    free(content);
+
+    return ok;
+}
+
+static uint64_t path_hash(const Database_File *file) {
+    return fnv1a(FNV1A_OFFSET_BASIS, file->relative_filepath, strlen(file->relative_filepath));
+}
+
+static const Summary *find_summary(const Summary *summaries, const Sort_File *file) {
+    if (!file->has_stat || cl_arr_len(summaries) == 0) return NULL;
+
+    Summary key = { .path_hash = path_hash(file->file) };
+    const Summary *summary = bsearch(&key, summaries, cl_arr_len(summaries), sizeof(Summary), compare_summaries);
+
+    if (summary == NULL) return NULL;
+
+    if (summary->mtime_sec != file->st.st_mtim.tv_sec || summary->mtime_nsec != file->st.st_mtim.tv_nsec || summary->size != (uint64_t)file->st.st_size) return NULL;
+
+    return summary;
+}
+
+static Summary summarize(const Sort_File *file) {
+    Summary summary = {
+        .path_hash = path_hash(file->file),
+        .mtime_sec = file->st.st_mtim.tv_sec,
+        .mtime_nsec = file->st.st_mtim.tv_nsec,
+        .size = file->st.st_size,
+        .min_date = INT64_MAX,
+        .max_date = INT64_MIN,
+        .tasks_count = cl_arr_len(file->tasks),
+    };
+
+    for (size_t i = 0; i < cl_arr_len(file->tasks); i++) {
+        int64_t date = datetime_to_timestamp(file->tasks[i].date_property.datetime);
+
+        if (date < summary.min_date) summary.min_date = date;
+        if (date > summary.max_date) summary.max_date = date;
+
+        summary.states |= 1u << file->tasks[i].state_property.state;
+    }
+
+    return summary;
+}
+
+// best key the tasks of a summarized file can have, files without tasks are
+// never part of the output
+static uint64_t summary_bound(const Sort_Key *key, const Summary *summary) {
+    if (summary->tasks_count == 0) return UINT64_MAX;
+
+    if (key->kind == Sort_Key_Date) {
+        return key->descending ? directed(key, ordered(summary->max_date)) : ordered(summary->min_date);
+    }
+
+    int min_state = __builtin_ctz(summary->states);
+    int max_state = 31 - __builtin_clz(summary->states);
+
+    return directed(key, key->descending ? max_state : min_state);
+}
+
+static void print_entry(Sorter *sorter, const Sort_Entry *entry, Flags flags) {
+    Sort_File *file = &sorter->files[entry->file];
+
+    if ((flags.fields & WODO_FIELD_ID) && file->ids == NULL) file->ids = compute_task_ids(file->tasks);
+
+    printf("{\"name\":");
+    print_scaped_string_to_fd((wodo_string_t){ .value = file->file->name, .length = strlen(file->file->name) }, stdout);
+    printf(",\"path\":");
+    print_scaped_string_to_fd((wodo_string_t){ .value = file->file->view_absolute_filepath, .length = strlen(file->file->view_absolute_filepath) }, stdout);
+    printf(",\"task\":");
+    print_task_to_stdout_as_json(file->tasks[entry->task], file->ids == NULL ? NULL : file->ids[entry->task].value, flags);
+    printf("}");
+}
+
+int sorted_list_action(Flags flags) {
+    TRACE_SCOPE("sorted_list");
+
+    Sorter sorter = { .limit = flags.limit, .heap = CL_ARRAY_INIT };
+
+    if (!parse_sort_key(flags.sort, &sorter.key)) {
+        fprintf(stderr, "error: invalid sort key \"%s\", expected date, state, title, file, mtime or a property of .wodo/properties\n", flags.sort);
+
+        return 1;
+    }
+
+    size_t files_count = cl_arr_len(global_database.files);
+    Sort_File **order = malloc((files_count + 1) * sizeof(Sort_File *));
+    const Sort_Key *key = &sorter.key;
+
+    sorter.files = calloc(files_count + 1, sizeof(Sort_File));
+
+    // the date and state ranges can only skip files when there's a limit
+    bool use_index = sorter.limit != 0 && (key->kind == Sort_Key_Date || key->kind == Sort_Key_State);
+    bool index_changed = false;
+    Summary *summaries = use_index ? read_index() : CL_ARRAY_INIT;
+    Summary *updated = CL_ARRAY_INIT;
+
+    TRACE_BEGIN("bounds");
+
+    for (size_t i = 0; i < files_count; i++) {
+        Sort_File *it = &sorter.files[i];
+
+        it->file = global_database.files[i];
+        order[i] = it;
+
+        if (use_index || key->kind == Sort_Key_Mtime) it->has_stat = stat(it->file->view_absolute_filepath, &it->st) == 0;
+    }
+
+    if (key->kind == Sort_Key_File) {
+        qsort(order, files_count, sizeof(Sort_File *), compare_files_by_name);
+
+        for (size_t i = 0; i < files_count; i++) order[i]->name_rank = i;
+    }
+
+    for (size_t i = 0; i < files_count; i++) {
+        Sort_File *it = &sorter.files[i];
+
+        switch (key->kind) {
+            case Sort_Key_File: it->bound = directed(key, it->name_rank); break;
+            case Sort_Key_Mtime: it->bound = directed(key, ordered(mtime_of(&it->st))); break;
+            case Sort_Key_Date:
+            case Sort_Key_State: {
+                const Summary *summary = use_index ? find_summary(summaries, it) : NULL;
+
+                if (summary != NULL) {
+                    it->bound = summary_bound(key, summary);
+
+                    cl_arr_push(updated, *summary);
+                }
+            } break;
+            default: break;
+        }
+
+        order[i] = it;
+    }
+
+    // best files first, so the heap fills up with good tasks early
+    if (files_count > 0) qsort(order, files_count, sizeof(Sort_File *), compare_files_by_bound);
+
+    TRACE_END();
+
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+    set_parser_options(parser_options_from_flags(flags));
+
+    for (size_t i = 0; i < files_count; i++) {
+        Sort_File *it = order[i];
+        uint32_t file = it - sorter.files;
+
+        // the files after it can't have better tasks either
+        if (can_skip(&sorter, it)) break;
+
+        TRACE_BEGIN_ARG("file", it->file->view_absolute_filepath);
+
+        size_t length;
+
+        if (!read_from_file_no_quit(it->file->view_absolute_filepath, &it->content, &length)) {
+            push_diagnostic(&diagnostics, it->file->view_absolute_filepath, (wodo_location_t){0}, Wodo_Diagnostic_Error, "could not read file: %s", strerror(errno));
+            it->visited = true;
+
+            TRACE_END();
+
+            continue;
+        }
+
+        size_t diagnostics_count = cl_arr_len(diagnostics);
+
+        reset_parser_state();
+
+        it->tasks = parse_tasks_recovering(it->file->view_absolute_filepath, it->content, length, &diagnostics);
+
+        if (use_index && it->has_stat && cl_arr_len(diagnostics) == diagnostics_count && find_summary(summaries, it) == NULL) {
+            cl_arr_push(updated, summarize(it));
+            index_changed = true;
+        }
+
+        for (size_t j = 0; j < cl_arr_len(it->tasks); j++) {
+            if (!default_task_predicate(it->tasks[j], flags)) continue;
+
+            keep_entry(&sorter, make_entry(&sorter, file, j));
+        }
+
+        it->visited = true;
+
+        if (it->references == 0) free_file_tasks(it);
+
+        TRACE_END();
+    }
+
+    // the files that were not visited keep their summaries, the ones that
+    // are not in the database anymore are dropped
+    if (index_changed && !write_index(updated)) {
+        fprintf(stderr, "warning: could not write the sort index: %s\n", strerror(errno));
+    }
+
+    TRACE_BEGIN("sort");
+
+    sort_entries(&sorter);
+
+    TRACE_END();
+
+    TRACE_BEGIN("serialize");
+
+    if (!flags.ndjson) printf("{\"tasks\":[");
+
+    for (size_t i = 0; i < cl_arr_len(sorter.heap); i++) {
+        if (i > 0 && !flags.ndjson) printf(",");
+
+        print_entry(&sorter, &sorter.heap[i], flags);
+
+        if (flags.ndjson) printf("\n");
+    }
+
+    if (flags.ndjson) {
+        print_diagnostics_to_stdout_as_ndjson(diagnostics, 0);
+    } else {
+        printf("],\"diagnostics\":");
+        print_diagnostics_to_stdout_as_json(diagnostics);
+        printf("}\n");
+    }
+
+    TRACE_END();
+
+    for (size_t i = 0; i < files_count; i++) {
+        if (sorter.files[i].content != NULL) free_file_tasks(&sorter.files[i]);
+    }
+
+    free_diagnostics(&diagnostics);
+    cl_arr_free(sorter.heap);
+    cl_arr_free(summaries);
+    cl_arr_free(updated);
+    free(sorter.files);
+    free(order);
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef _WODO_SORT_H_
+#define _WODO_SORT_H_
+
+#include "argparser.h"
+
+// `wodo list --sort <key> [--limit <n>]`
+//
+// outputs the matching tasks of every database file as one list ordered by
+// <key> (date, state, title, file, mtime or a property of .wodo/properties,
+// descending with a '-' prefix): {"tasks":[{"name","path","task"}],"diagnostics":[]}
+//
+// with --limit only the best <n> tasks are kept, in a heap, while the files
+// are read. Files are visited from the one that can have the best task, by
+// name, mtime or the date and state ranges kept in .wodo/.sort-index, and the
+// visit stops at the first one that can't beat the kept tasks.
+int sorted_list_action(Flags flags);
+
+#endif // !_WODO_SORT_H_
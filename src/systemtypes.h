@@ -3,6 +3,7 @@
 
 #include <time.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct {
     int year, month, day, hour, minute, second;
@@ -41,6 +42,16 @@ struct wodo_node_t {
     };
 };
 
+// value of a custom property of a task, see properties.h
+typedef struct {
+    wodo_location_t       location;
+    // int, duration (seconds), enum (index of the value) or datetime (unix
+    // timestamp), so the values of a property compare as integers
+    int64_t               value;
+    // index of the property in the registry
+    uint32_t              property;
+} wodo_property_value_t;
+
 typedef struct {
     // string_val
     wodo_node_t title;
@@ -54,8 +65,44 @@ typedef struct {
     wodo_node_t date_property;
     // bool_val
     wodo_node_t remind_property;
+    // array<wodo_string_t>, the task ids of `.depends`. Empty when it's not set
+    wodo_node_t depends_property;
+    // custom properties sorted by `property`, owned. NULL when there are none
+    wodo_property_value_t *properties;
+    size_t properties_count;
 } wodo_task_t;
 
+typedef enum {
+    Wodo_Compare_Equal,         // =
+    Wodo_Compare_Not_Equal,     // !=
+    Wodo_Compare_Less,          // <
+    Wodo_Compare_Less_Equal,    // <=
+    Wodo_Compare_Greater,       // >
+    Wodo_Compare_Greater_Equal, // >=
+} wodo_compare_t;
+
+// --filter-property resolved against the registry
+typedef struct {
+    uint32_t        property;
+    wodo_compare_t  compare;
+    int64_t         value;
+} wodo_property_filter_t;
+
+typedef enum {
+    Wodo_Diagnostic_Error,      // the task was discarded
+    Wodo_Diagnostic_Warning,    // the task was kept
+} wodo_diagnostic_severity_t;
+
+typedef struct {
+    // not owned, it's usually the path of a database file
+    const char                  *filename;
+    // line 0 means the diagnostic is about the whole file
+    wodo_location_t             location;
+    wodo_diagnostic_severity_t  severity;
+    // owned
+    char                        *message;
+} wodo_diagnostic_t;
+
 // general
 
 typedef struct {
@@ -0,0 +1,432 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "taskid.h"
+#include "arr.h"
+#include "database.h"
+#include "io.h"
+#include "json.h"
+#include "msgpack.h"
+#include "parser.h"
+#include "utils.h"
+#include "trace.h"
+
+/*
+ * .wodo/.task-ids/<file> layout (native endianness, like the database file):
+ *
+ *   Id_Index_Header
+ *   Id_Index_Slot * slots_count, an open addressing table of the task ids
+ *     with linear probing, slots with an empty id are free
+ *
+ * So a lookup reads the header, one or a few slots and the range of the task.
+ */
+static const char *ids_folder_name = ".task-ids";
+static const char ids_magic[8] = "WODOTID";
+
+#define IDS_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots_count;       // power of two
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t size;
+} Id_Index_Header;
+
+typedef struct {
+    char id[TASK_ID_MAX_SIZE];
+    // from the '%' of the task to the '%' of the next one
+    uint32_t start, length;
+    // line of `start`
+    int32_t line;
+    uint32_t padding;
+    // FNV-1a of the bytes in the range
+    uint64_t hash;
+} Id_Index_Slot;
+
+typedef enum {
+    LOOKUP_FOUND,
+    LOOKUP_MISSING,
+    LOOKUP_STALE,
+} Lookup_Result;
+
+typedef struct {
+    char *content;
+    size_t length;
+    int line;
+} Task_Slice;
+
+static uint64_t title_hash(wodo_string_t title) {
+    const char *start = title.value;
+    const char *end = title.value + title.length;
+
+    while (start < end && (*start == ' ' || *start == '\t')) start++;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+
+    return fnv1a(FNV1A_OFFSET_BASIS, start, end - start);
+}
+
+static void counter_grow(Task_Id_Counter *counter) {
+    uint32_t *keys = counter->keys;
+    uint32_t *counts = counter->counts;
+    size_t capacity = counter->capacity;
+
+    counter->capacity = capacity == 0 ? 16 : capacity * 2;
+    counter->keys = calloc(counter->capacity, sizeof(uint32_t));
+    counter->counts = calloc(counter->capacity, sizeof(uint32_t));
+
+    for (size_t i = 0; i < capacity; i++) {
+        if (keys[i] == 0) continue;
+
+        size_t slot = ((keys[i] - 1) * 0x9e3779b1u) & (counter->capacity - 1);
+
+        while (counter->keys[slot] != 0) slot = (slot + 1) & (counter->capacity - 1);
+
+        counter->keys[slot] = keys[i];
+        counter->counts[slot] = counts[i];
+    }
+
+    free(keys);
+    free(counts);
+}
+
+Task_Id next_task_id(Task_Id_Counter *counter, wodo_task_t task) {
+    if ((counter->used + 1) * 2 > counter->capacity) counter_grow(counter);
+
+    // 28 bits are 7 hex digits, collisions only matter inside a file
+    uint32_t base = (uint32_t)(title_hash(task.title.string) >> 36);
+    size_t slot = (base * 0x9e3779b1u) & (counter->capacity - 1);
+
+    while (counter->keys[slot] != 0 && counter->keys[slot] != base + 1) slot = (slot + 1) & (counter->capacity - 1);
+
+    if (counter->keys[slot] == 0) counter->used++;
+
+    counter->keys[slot] = base + 1;
+    counter->counts[slot]++;
+
+    Task_Id id;
+
+    if (counter->counts[slot] == 1) {
+        snprintf(id.value, sizeof(id.value), "%07" PRIx32, base);
+    } else {
+        snprintf(id.value, sizeof(id.value), "%07" PRIx32 "-%" PRIu32, base, counter->counts[slot]);
+    }
+
+    return id;
+}
+
+void free_task_id_counter(Task_Id_Counter *counter) {
+    free(counter->keys);
+    free(counter->counts);
+
+    *counter = (Task_Id_Counter){0};
+}
+
+Task_Id *compute_task_ids(wodo_task_t *tasks) {
+    Task_Id_Counter counter = {0};
+    Task_Id *ids = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) cl_arr_push(ids, next_task_id(&counter, tasks[i]));
+
+    free_task_id_counter(&counter);
+
+    return ids;
+}
+
+static uint64_t id_hash(const char *id) {
+    return fnv1a(FNV1A_OFFSET_BASIS, id, strnlen(id, TASK_ID_MAX_SIZE));
+}
+
+static char *index_path_for(const char *filepath) {
+    char *filepath_copy = strdup(filepath);
+    char *path = join_paths("%s/%s/%s", database_folder(), ids_folder_name, basename(filepath_copy));
+
+    free(filepath_copy);
+
+    return path;
+}
+
+static bool write_slots(const char *path, const struct stat *st, Id_Index_Slot *slots, uint32_t slots_count) {
+    char *folder = join_paths("%s/%s", database_folder(), ids_folder_name);
+
+    if (mkdir(folder, 0777) != 0 && errno != EEXIST) {
+        free(folder);
+
+        return false;
+    }
+
+    free(folder);
+
+    Id_Index_Header header = {
+        .version = IDS_VERSION,
+        .slots_count = slots_count,
+        .mtime_sec = st->st_mtim.tv_sec,
+        .mtime_nsec = st->st_mtim.tv_nsec,
+        .size = (uint64_t)st->st_size,
+    };
+
+    memcpy(header.magic, ids_magic, sizeof(ids_magic));
+
+    size_t length = sizeof(header) + sizeof(Id_Index_Slot) * slots_count;
+    char *data = malloc(length);
+
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), slots, sizeof(Id_Index_Slot) * slots_count);
+
+    bool ok = write_file_atomically(path, data, length);
+
+    free(data);
+
+    return ok;
+}
+
+static bool read_range(const char *filepath, const Id_Index_Slot *slot, Task_Slice *slice) {
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) return false;
+
+    char *content = malloc(slot->length + 1);
+    ssize_t size = pread(fd, content, slot->length, slot->start);
+
+    close(fd);
+
+    if (size != (ssize_t)slot->length || fnv1a(FNV1A_OFFSET_BASIS, content, slot->length) != slot->hash) {
+        free(content);
+
+        return false;
+    }
+
+    content[slot->length] = '\0';
+
+    *slice = (Task_Slice){ .content = content, .length = slot->length, .line = slot->line };
+
+    return true;
+}
+
+static Lookup_Result lookup_index(const char *index_path, const char *filepath, const char *id, Task_Slice *slice) {
+    TRACE_SCOPE("lookup_index");
+
+    struct stat st;
+
+    if (stat(filepath, &st) != 0) return LOOKUP_STALE;
+
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) return LOOKUP_STALE;
+
+    Lookup_Result result = LOOKUP_STALE;
+    Id_Index_Header header;
+
+    bool valid = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+        && memcmp(header.magic, ids_magic, sizeof(ids_magic)) == 0
+        && header.version == IDS_VERSION
+        && header.mtime_sec == st.st_mtim.tv_sec
+        && header.mtime_nsec == st.st_mtim.tv_nsec
+        && header.size == (uint64_t)st.st_size
+        && header.slots_count > 0
+        && (header.slots_count & (header.slots_count - 1)) == 0;
+
+    if (valid) {
+        uint64_t hash = id_hash(id);
+
+        for (uint32_t probe = 0; probe < header.slots_count; probe++) {
+            uint32_t i = (uint32_t)((hash + probe) & (header.slots_count - 1));
+            off_t offset = sizeof(header) + (off_t)i * sizeof(Id_Index_Slot);
+            Id_Index_Slot slot;
+
+            if (pread(fd, &slot, sizeof(slot), offset) != sizeof(slot)) break;
+
+            if (slot.id[0] == '\0') {
+                result = LOOKUP_MISSING;
+
+                break;
+            }
+
+            if (strncmp(slot.id, id, TASK_ID_MAX_SIZE) == 0) {
+                // a range that doesn't hash the same means the file changed
+                // within the mtime resolution
+                if (read_range(filepath, &slot, slice)) result = LOOKUP_FOUND;
+
+                break;
+            }
+        }
+    }
+
+    close(fd);
+
+    return result;
+}
+
+// parses the whole file, writes its index and looks `id` up in it
+static Lookup_Result rebuild_index(const char *index_path, const char *filepath, const char *id, Task_Slice *slice) {
+    TRACE_SCOPE("rebuild_index");
+
+    struct stat st;
+    char *content;
+    size_t length;
+
+    if (stat(filepath, &st) != 0 || !read_from_file_no_quit(filepath, &content, &length)) {
+        fprintf(stderr, "error: could not read file %s: %s\n", filepath, strerror(errno));
+
+        return LOOKUP_STALE;
+    }
+
+    wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+    // only the titles are needed for the ids and the ranges
+    reset_parser_state();
+    set_parser_options((wodo_parser_options_t){ .skip_tags = true, .skip_description = true });
+
+    wodo_task_t *tasks = parse_tasks_recovering(filepath, content, length, &diagnostics);
+    Task_Id *ids = compute_task_ids(tasks);
+
+    uint32_t slots_count = 8;
+
+    while (slots_count < cl_arr_len(tasks) * 2) slots_count *= 2;
+
+    Id_Index_Slot *slots = calloc(slots_count, sizeof(Id_Index_Slot));
+    Lookup_Result result = LOOKUP_MISSING;
+
+    for (size_t i = 0; i < cl_arr_len(tasks); i++) {
+        size_t start, end;
+
+        task_byte_range(content, length, tasks[i], &start, &end);
+
+        Id_Index_Slot slot = {
+            .start = (uint32_t)start,
+            .length = (uint32_t)(end - start),
+            .line = tasks[i].title.location.line,
+            .hash = fnv1a(FNV1A_OFFSET_BASIS, content + start, end - start),
+        };
+
+        memcpy(slot.id, ids[i].value, TASK_ID_MAX_SIZE);
+
+        uint64_t hash = id_hash(slot.id);
+        uint32_t at = (uint32_t)(hash & (slots_count - 1));
+
+        while (slots[at].id[0] != '\0') at = (at + 1) & (slots_count - 1);
+
+        slots[at] = slot;
+
+        if (result == LOOKUP_MISSING && strncmp(slot.id, id, TASK_ID_MAX_SIZE) == 0) {
+            *slice = (Task_Slice){
+                .content = strndup(content + start, end - start),
+                .length = end - start,
+                .line = slot.line,
+            };
+
+            result = LOOKUP_FOUND;
+        }
+    }
+
+    if (!write_slots(index_path, &st, slots, slots_count)) {
+        fprintf(stderr, "warning: could not write the task ids index %s: %s\n", index_path, strerror(errno));
+    }
+
+    free(slots);
+    free(content);
+    cl_arr_free(ids);
+    free_tasks(tasks);
+    free_diagnostics(&diagnostics);
+
+    return result;
+}
+
+static void shift_node(wodo_node_t *node, int lines) {
+    if (node->location.line != 0) node->location.line += lines;
+}
+
+// the slice is parsed on its own, so its lines start at 1
+static void shift_task_lines(wodo_task_t *task, int lines) {
+    shift_node(&task->title, lines);
+    shift_node(&task->description, lines);
+    shift_node(&task->state_property, lines);
+    shift_node(&task->tags_property, lines);
+    shift_node(&task->date_property, lines);
+    shift_node(&task->remind_property, lines);
+    shift_node(&task->depends_property, lines);
+
+    for (size_t i = 0; i < cl_arr_len(task->tags_property.node_array); i++) {
+        shift_node(&task->tags_property.node_array[i], lines);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(task->depends_property.node_array); i++) {
+        shift_node(&task->depends_property.node_array[i], lines);
+    }
+
+    for (size_t i = 0; i < task->properties_count; i++) {
+        if (task->properties[i].location.line != 0) task->properties[i].location.line += lines;
+    }
+}
+
+int get_action(const char *filepath, const char *id, Flags flags) {
+    TRACE_SCOPE("get");
+
+    char *absolute_filepath = realpath(filepath, NULL);
+
+    if (absolute_filepath == NULL || database_get_file_by_filepath(NULL, absolute_filepath) != DATABASE_OK_STATUS_CODE) {
+        fprintf(stderr, "error: %s is not a file of the repository\n", filepath);
+        free(absolute_filepath);
+
+        return 1;
+    }
+
+    char *index_path = index_path_for(absolute_filepath);
+    Task_Slice slice = {0};
+    Lookup_Result result = strlen(id) < TASK_ID_MAX_SIZE ? lookup_index(index_path, absolute_filepath, id, &slice) : LOOKUP_MISSING;
+
+    if (result == LOOKUP_STALE) result = rebuild_index(index_path, absolute_filepath, id, &slice);
+
+    int return_code = 1;
+
+    if (result == LOOKUP_MISSING) {
+        fprintf(stderr, "error: there is no task with id %s in %s\n", id, filepath);
+    } else if (result == LOOKUP_FOUND) {
+        wodo_diagnostic_t *diagnostics = CL_ARRAY_INIT;
+
+        reset_parser_state();
+        set_parser_options(parser_options_from_flags(flags));
+
+        wodo_task_t *tasks = parse_tasks_recovering(absolute_filepath, slice.content, slice.length, &diagnostics);
+
+        for (size_t i = 0; i < cl_arr_len(diagnostics); i++) {
+            wodo_diagnostic_t diagnostic = diagnostics[i];
+
+            fprintf(stderr, "%s: %s:%d:%d: %s\n",
+                diagnostic.severity == Wodo_Diagnostic_Error ? "error" : "warning",
+                diagnostic.filename, diagnostic.location.line + slice.line - 1, diagnostic.location.col,
+                diagnostic.message);
+        }
+
+        if (cl_arr_len(tasks) == 1) {
+            shift_task_lines(&tasks[0], slice.line - 1);
+
+            if (flags.format == OF_MSGPACK) {
+                print_task_to_stdout_as_msgpack(tasks[0], id, flags);
+            } else {
+                print_task_to_stdout_as_json(tasks[0], id, flags);
+                printf("\n");
+            }
+
+            return_code = 0;
+        }
+
+        free_tasks(tasks);
+        free_diagnostics(&diagnostics);
+    }
+
+    free(slice.content);
+    free(index_path);
+    free(absolute_filepath);
+
+    return return_code;
+}
@@ -0,0 +1,44 @@
+#ifndef _WODO_TASKID_H_
+#define _WODO_TASKID_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "argparser.h"
+#include "systemtypes.h"
+
+// "a1b2c3d" or "a1b2c3d-2", null terminated
+#define TASK_ID_MAX_SIZE 24
+
+typedef struct {
+    char value[TASK_ID_MAX_SIZE];
+} Task_Id;
+
+// short id of every task of a file, in the same order (CL_ARRAY).
+//
+// The id is a hash of the trimmed title, so it doesn't change when the task
+// is moved or when any other property is edited. The second task of the file
+// with the same id gets "-2", the third "-3" and so on.
+Task_Id *compute_task_ids(wodo_task_t *tasks);
+
+// the same ids for callers that see the tasks of a file one at a time, it
+// only keeps a counter per distinct id. Zero initialized
+typedef struct {
+    // base id + 1 -> how many tasks got it so far, 0 is a free slot
+    uint32_t *keys;
+    uint32_t *counts;
+    size_t capacity;
+    size_t used;
+} Task_Id_Counter;
+
+Task_Id next_task_id(Task_Id_Counter *counter, wodo_task_t task);
+void free_task_id_counter(Task_Id_Counter *counter);
+
+// `wodo get <file> <id>`
+//
+// prints the task with `id` in the database file. The byte range of every
+// task is kept in .wodo/.task-ids/<file>, so only that range is read and
+// parsed. The index is checked against the mtime and size of the file and the
+// hash of the range, and rebuilt when any of them doesn't match.
+int get_action(const char *filepath, const char *id, Flags flags);
+
+#endif // !_WODO_TASKID_H_
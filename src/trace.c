@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#define CL_ARRAY_IMPLEMENTATION
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "arr.h"
+#include "utils.h"
+
+#ifdef WODO_TRACE
+
+#define TRACE_MAX_DEPTH 32
+
+typedef struct {
+    const char *name;
+    // owned, NULL when the span has no file
+    char *file;
+    double start_us;
+    double duration_us;
+    long tid;
+} Trace_Event;
+
+typedef struct {
+    const char *name;
+    const char *file;
+    double start_us;
+} Trace_Open_Span;
+
+static bool trace_enabled = false;
+static char *trace_output_path = NULL;
+static Trace_Event *trace_events = CL_ARRAY_INIT;
+static pthread_mutex_t trace_events_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local Trace_Open_Span open_spans[TRACE_MAX_DEPTH];
+static _Thread_local int open_spans_count = 0;
+
+static double now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+bool trace_start(const char *output_path) {
+    trace_output_path = strdup(output_path);
+    trace_enabled = trace_output_path != NULL;
+
+    return trace_enabled;
+}
+
+int trace_begin(const char *name, const char *file) {
+    if (!trace_enabled) return 0;
+
+    // deeper spans are dropped, their trace_end calls are still balanced
+    if (open_spans_count < TRACE_MAX_DEPTH) {
+        open_spans[open_spans_count] = (Trace_Open_Span){
+            .name = name,
+            .file = file,
+            .start_us = now_us()
+        };
+    }
+
+    open_spans_count++;
+
+    return 0;
+}
+
+void trace_end(void) {
+    if (!trace_enabled || open_spans_count == 0) return;
+
+    open_spans_count--;
+
+    if (open_spans_count >= TRACE_MAX_DEPTH) return;
+
+    Trace_Open_Span span = open_spans[open_spans_count];
+
+    Trace_Event event = {
+        .name = span.name,
+        .file = span.file != NULL ? strdup(span.file) : NULL,
+        .start_us = span.start_us,
+        .duration_us = now_us() - span.start_us,
+        .tid = (long)syscall(SYS_gettid)
+    };
+
+    pthread_mutex_lock(&trace_events_lock);
+    cl_arr_push(trace_events, event);
+    pthread_mutex_unlock(&trace_events_lock);
+}
+
+void trace_scope_end(int *scope) {
+    (void)scope;
+
+    trace_end();
+}
+
+void trace_finish(void) {
+    if (!trace_enabled) return;
+
+    trace_enabled = false;
+
+    FILE *file = fopen(trace_output_path, "w");
+
+    if (file == NULL) {
+        fprintf(stderr, "error: could not write trace file %s: %s\n", trace_output_path, strerror(errno));
+    } else {
+        long pid = (long)getpid();
+
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+        for (size_t i = 0; i < cl_arr_len(trace_events); i++) {
+            Trace_Event event = trace_events[i];
+
+            if (i > 0) fprintf(file, ",");
+
+            fprintf(file, "\n{\"name\":\"%s\",\"cat\":\"wodo\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld",
+                    event.name, event.start_us, event.duration_us, pid, event.tid);
+
+            if (event.file != NULL) {
+                fprintf(file, ",\"args\":{\"file\":");
+                print_scaped_string_to_fd((wodo_string_t){
+                    .length = strlen(event.file),
+                    .value = event.file
+                }, file);
+                fprintf(file, "}");
+            }
+
+            fprintf(file, "}");
+        }
+
+        fprintf(file, "\n]}\n");
+        fclose(file);
+    }
+
+    for (size_t i = 0; i < cl_arr_len(trace_events); i++) {
+        free(trace_events[i].file);
+    }
+
+    cl_arr_free(trace_events);
+    free(trace_output_path);
+    trace_output_path = NULL;
+}
+
+#endif // WODO_TRACE
@@ -0,0 +1,48 @@
+#ifndef _WODO_TRACE_H_
+#define _WODO_TRACE_H_
+
+#include <stdbool.h>
+
+/*
+ * Phase tracing in Chrome trace-event format (chrome://tracing, Perfetto).
+ *
+ * It only exists when built with WODO_TRACE (`make TRACE=1`), otherwise all
+ * the macros below compile to nothing. Even when it's built in, nothing is
+ * recorded until `trace_start` is called (`--trace <file>`).
+ *
+ *   TRACE_SCOPE("database_load");           // ends when the scope ends
+ *   TRACE_SCOPE_ARG("parse_tasks", path);   // same, with a "file" argument
+ *   TRACE_BEGIN("filter"); ... TRACE_END(); // explicit span
+ **/
+
+#ifdef WODO_TRACE
+
+bool trace_start(const char *output_path);
+// writes the trace file, spans that are still open are discarded
+void trace_finish(void);
+int trace_begin(const char *name, const char *file);
+void trace_end(void);
+void trace_scope_end(int *scope);
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_BEGIN(name) trace_begin((name), NULL)
+#define TRACE_BEGIN_ARG(name, file) trace_begin((name), (file))
+#define TRACE_END() trace_end()
+#define TRACE_SCOPE(name) \
+    __attribute__((cleanup(trace_scope_end))) int TRACE_CONCAT(trace_scope_, __LINE__) = trace_begin((name), NULL)
+#define TRACE_SCOPE_ARG(name, file) \
+    __attribute__((cleanup(trace_scope_end))) int TRACE_CONCAT(trace_scope_, __LINE__) = trace_begin((name), (file))
+
+#else
+
+#define TRACE_BEGIN(name) do {} while (0)
+#define TRACE_BEGIN_ARG(name, file) do { (void)(file); } while (0)
+#define TRACE_END() do {} while (0)
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_ARG(name, file)
+
+#endif // WODO_TRACE
+
+#endif // !_WODO_TRACE_H_
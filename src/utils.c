@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include "utils.h"
+#include "properties.h"
 #include "arr.h"
 #include "systemtypes.h"
 #include "argparser.h"
@@ -216,10 +217,19 @@ void print_scaped_string_to_fd(wodo_string_t string, FILE *file) {
     fprintf(file, "\"");
 }
 
+wodo_parser_options_t parser_options_from_flags(Flags flags) {
+    return (wodo_parser_options_t){
+        .skip_tags = !(flags.fields & WODO_FIELD_TAGS) && cl_arr_len(flags.tag_filter) == 0,
+        .skip_description = !(flags.fields & WODO_FIELD_DESCRIPTION),
+    };
+}
+
 bool default_task_predicate(wodo_task_t task, Flags flags) {
     bool matched_any_states = cl_arr_len(flags.state_filter) == 0;
     bool matched_any_tags = cl_arr_len(flags.tag_filter) == 0;
 
+    if (cl_arr_len(flags.property_filters) > 0 && !property_filters_match(task, flags)) return false;
+
     if (matched_any_states && matched_any_tags) return true;
 
     wodo_task_state_t task_state = task.state_property.state;
@@ -274,3 +284,29 @@ bool default_task_predicate(wodo_task_t task, Flags flags) {
 
     return matched_any_states && matched_any_tags;
 }
+
+size_t utf8_prefix_size(wodo_string_t string, int max_chars) {
+    int chars = 0;
+
+    for (size_t i = 0; i < string.length; i++) {
+        // continuation bytes (10xxxxxx) belong to the previous character
+        if (((unsigned char)string.value[i] & 0xC0) == 0x80) continue;
+
+        if (chars == max_chars) return i;
+
+        chars++;
+    }
+
+    return string.length;
+}
+
+uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
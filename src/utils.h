@@ -3,10 +3,12 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <time.h>
 #include "argparser.h"
 #include "systemtypes.h"
+#include "parser.h"
 
 const char *get_user_home_folder(void);
 bool file_exists(const char *filepath, bool is_folder);
@@ -21,5 +23,14 @@ bool arg_cmp_single(const char *actual, const char *expected);
 bool cmp_sized_strings(const char *a, const char *b, size_t len_a, size_t len_b);
 void print_scaped_string_to_fd(wodo_string_t string, FILE *file);
 bool default_task_predicate(wodo_task_t task, Flags flags);
+// skips the parser work for fields that are not going to be printed nor filtered
+wodo_parser_options_t parser_options_from_flags(Flags flags);
+// returns the size in bytes of the first `max_chars` UTF-8 characters of `string`
+size_t utf8_prefix_size(wodo_string_t string, int max_chars);
+
+#define FNV1A_OFFSET_BASIS 0xcbf29ce484222325ULL
+
+// FNV-1a, start with FNV1A_OFFSET_BASIS and chain the calls to hash several fields
+uint64_t fnv1a(uint64_t hash, const void *data, size_t size);
 
 #endif // _WODO_UTILS_H_
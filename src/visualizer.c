@@ -7,40 +7,67 @@
 #include "date.h"
 
 void print_wodo_datetime(wodo_datetime_t timezoned_datetime, bool simple)
+{
+    char buffer[WODO_DATETIME_MAX_SIZE];
+
+    size_t size = format_wodo_datetime(buffer, timezoned_datetime, simple);
+
+    fwrite(buffer, sizeof(char), size, stdout);
+}
+
+static char *write_2_digits(char *cursor, int value)
+{
+    cursor[0] = '0' + value / 10;
+    cursor[1] = '0' + value % 10;
+
+    return cursor + 2;
+}
+
+size_t format_wodo_datetime(char *buffer, wodo_datetime_t timezoned_datetime, bool simple)
 {
     wodo_datetime_t datetime = convert_to_local(timezoned_datetime);
 
-    if (simple) {
-        printf("%04d-%02d-%02d %02d:%02d",
-               datetime.year,
-               datetime.month,
-               datetime.day,
-               datetime.hour,
-               datetime.minute);
-    } else {
-        printf("%04d-%02d-%02d %02d:%02d:%02d",
-               datetime.year,
-               datetime.month,
-               datetime.day,
-               datetime.hour,
-               datetime.minute,
-               datetime.second);
-
-        if (datetime.tz_offset == 0) {
-            printf("+00:00");
-        } else {
-            int offset = datetime.tz_offset;
-            char sign = '+';
-
-            if (offset < 0) {
-                sign = '-';
-                offset = -offset;
-            }
-
-            int hours = offset / 60;
-            int minutes = offset % 60;
-
-            printf("%c%02d:%02d", sign, hours, minutes);
+    int offset = datetime.tz_offset;
+    char sign = '+';
+
+    if (offset < 0) {
+        sign = '-';
+        offset = -offset;
+    }
+
+    // every field has a fixed width unless the year or the offset are out of range
+    if (datetime.year < 0 || datetime.year > 9999 || offset / 60 > 99) {
+        if (simple) {
+            return snprintf(buffer, WODO_DATETIME_MAX_SIZE, "%04d-%02d-%02d %02d:%02d",
+                            datetime.year, datetime.month, datetime.day, datetime.hour, datetime.minute);
         }
+
+        return snprintf(buffer, WODO_DATETIME_MAX_SIZE, "%04d-%02d-%02d %02d:%02d:%02d%c%02d:%02d",
+                        datetime.year, datetime.month, datetime.day, datetime.hour, datetime.minute,
+                        datetime.second, sign, offset / 60, offset % 60);
     }
+
+    char *cursor = buffer;
+
+    cursor = write_2_digits(cursor, datetime.year / 100);
+    cursor = write_2_digits(cursor, datetime.year % 100);
+    *cursor++ = '-';
+    cursor = write_2_digits(cursor, datetime.month);
+    *cursor++ = '-';
+    cursor = write_2_digits(cursor, datetime.day);
+    *cursor++ = ' ';
+    cursor = write_2_digits(cursor, datetime.hour);
+    *cursor++ = ':';
+    cursor = write_2_digits(cursor, datetime.minute);
+
+    if (simple) return cursor - buffer;
+
+    *cursor++ = ':';
+    cursor = write_2_digits(cursor, datetime.second);
+    *cursor++ = sign;
+    cursor = write_2_digits(cursor, offset / 60);
+    *cursor++ = ':';
+    cursor = write_2_digits(cursor, offset % 60);
+
+    return cursor - buffer;
 }
@@ -4,6 +4,12 @@
 #include <stdbool.h>
 #include "systemtypes.h"
 
+// "YYYY-MM-DD HH:MM:SS+HH:MM", with room for 5+ digits years
+#define WODO_DATETIME_MAX_SIZE 64
+
 void print_wodo_datetime(wodo_datetime_t timezoned_datetime, bool simple);
+// writes the same text as `print_wodo_datetime` into `buffer` (not null terminated)
+// and returns its size. The buffer needs at least WODO_DATETIME_MAX_SIZE bytes.
+size_t format_wodo_datetime(char *buffer, wodo_datetime_t timezoned_datetime, bool simple);
 
 #endif // !_WODO_VISUALIZER_H_
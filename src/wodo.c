@@ -1,8 +1,23 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include "database.h"
 #include "actions.h"
+#include "search.h"
+#include "pick.h"
+#include "workspace.h"
+#include "diff.h"
+#include "taskid.h"
+#include "batch.h"
+#include "set.h"
+#include "archive.h"
+#include "gc.h"
+#include "depends.h"
+#include "properties.h"
+#include "utils.h"
+#include "trace.h"
 
 #define defer(code) do { return_code = code; goto end; } while (0)
 
@@ -11,18 +26,35 @@
  **/
 Database global_database = {0};
 
-int main(int argc, char **argv) {
-    int return_code = 0;
+// the actions that change the database or the task files
+static bool is_writer(ArgumentKind kind) {
+    switch (kind) {
+        case AK_ADD:
+        case AK_REMOVE:
+        case AK_RENAME:
+        case AK_BATCH:
+        case AK_SET:
+        case AK_ARCHIVE:
+        case AK_GC:
+            return true;
+        default:
+            return false;
+    }
+}
 
-    Arguments *args = parse_arguments(argc, argv);
+// the custom properties have to be known before parsing any task
+static bool load_repository_properties(void) {
+    char *properties_path = join_paths("%s/properties", database_folder());
+    bool properties_loaded = load_properties(properties_path);
 
-    if (args == NULL)
-        defer(1);
+    free(properties_path);
 
-    if (args->kind == AK_INIT) {
-        defer(init_repository_action());
-    }
+    return properties_loaded;
+}
 
+// loads the repository of the working directory and runs the action on it
+static int run_action(Arguments *args) {
+    int return_code = 0;
     database_status_code_t status_code;
 
     if ((status_code = load_wodo_database_working_directory()) != DATABASE_OK_STATUS_CODE) {
@@ -31,28 +63,94 @@ int main(int argc, char **argv) {
         return status_code;
     }
 
+    // writers run one at a time, readers load the last saved snapshot
+    if (is_writer(args->kind) && (status_code = database_lock_exclusive()) != DATABASE_OK_STATUS_CODE) {
+        fprintf(stderr, "error: could not lock the repository: %s\n", strerror(errno));
+
+        return status_code;
+    }
+
     if ((status_code = database_load()) != DATABASE_OK_STATUS_CODE) {
         fprintf(stderr, "error: %s\n", database_status_code_string(status_code));
         return status_code;
     }
 
+    if (!load_repository_properties() || !compile_property_filters(&args->flags)) return 1;
+
+
+    TRACE_BEGIN("action");
 
     switch (args->kind) {
         case AK_ADD: return_code = add_wodo_file_action(args->arg1); break;
         case AK_REMOVE: return_code = remove_wodo_file_action(args->arg1); break;
         case AK_PARSE: return_code = parse_wodo_file_from_stdin_action(args->arg1, args->flags); break;
         case AK_LIST: return_code = list_action(args->flags); break;
-        case AK_FORMAT: return_code = format_wodo_file_from_stdin_action(args->arg1); break;
+        case AK_FORMAT: return_code = format_wodo_file_from_stdin_action(args->arg1, args->flags); break;
         case AK_RENAME: return_code = rename_wodo_file_action(args->arg1, args->arg2); break;
-        case AK_GET_REMINDERS: return_code = get_reminders_action(); break;
+        case AK_GET_REMINDERS: return_code = get_reminders_action(args->flags); break;
+        case AK_CHECK: return_code = check_action(); break;
+        case AK_SEARCH: return_code = search_action(args->arg1, args->flags); break;
+        case AK_PICK: return_code = pick_action(args->flags); break;
+        case AK_BATCH: return_code = batch_action(); break;
+        case AK_SET: return_code = set_action(args->flags); break;
+        case AK_ARCHIVE: return_code = archive_action(args->flags); break;
+        case AK_GC: return_code = gc_action(args->flags); break;
+        case AK_GET: return_code = get_action(args->arg1, args->arg2, args->flags); break;
+        case AK_NEXT: return_code = next_action(args->flags); break;
         default: {
             usage(stderr, args->program_name, "invalid command line options");
 
-            defer(1);
+            return_code = 1;
         } break;
     }
 
+    TRACE_END();
+
+    return return_code;
+}
+
+int main(int argc, char **argv) {
+    int return_code = 0;
+
+    Arguments *args = parse_arguments(argc, argv);
+
+    if (args == NULL)
+        defer(1);
+
+    if (args->trace_output != NULL) {
+#ifdef WODO_TRACE
+        if (!trace_start(args->trace_output)) {
+            fprintf(stderr, "error: could not start tracing\n");
+            defer(1);
+        }
+#else
+        fprintf(stderr, "warning: wodo was built without tracing support, rebuild it with TRACE=1\n");
+#endif
+    }
+
+    if (args->kind == AK_INIT) {
+        defer(init_repository_action());
+    }
+
+    // works on any two files, there is no need for a repository. When there
+    // is one its custom properties are parsed like in the other actions
+    if (args->kind == AK_DIFF) {
+        if (load_wodo_database_working_directory() == DATABASE_OK_STATUS_CODE && !load_repository_properties()) defer(1);
+
+        defer(diff_action(args->arg1, args->arg2, args->flags));
+    }
+
+    if (args->workspace != NULL) {
+        defer(workspace_action(args, run_action));
+    }
+
+    return_code = run_action(args);
+
 end:
+#ifdef WODO_TRACE
+    trace_finish();
+#endif
+
     if (args != NULL) free(args);
 
     database_free();
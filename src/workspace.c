@@ -0,0 +1,353 @@
+#define CL_ARRAY_IMPLEMENTATION
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "workspace.h"
+#include "arr.h"
+#include "io.h"
+#include "utils.h"
+#include "trace.h"
+
+typedef struct {
+    char *root;                 // as written in the workspace file
+    char *directory;            // resolved against the workspace file folder
+    pid_t pid;
+    int fd;
+    int status;
+    // everything the repository printed, one JSON object per line
+    char *output;
+    size_t length;
+    size_t capacity;
+} Repository;
+
+typedef struct {
+    const char *line;
+    size_t length;
+    size_t repository;
+    int score;
+} Output_Line;
+
+static void append_output(Repository *repository, const char *data, size_t size) {
+    if (repository->length + size > repository->capacity) {
+        size_t capacity = repository->capacity == 0 ? 4096 : repository->capacity;
+
+        while (repository->length + size > capacity) capacity *= 2;
+
+        repository->output = realloc(repository->output, capacity);
+        repository->capacity = capacity;
+
+        assert(repository->output != NULL && "buy more ram lol");
+    }
+
+    memcpy(repository->output + repository->length, data, size);
+    repository->length += size;
+}
+
+// one root per line, blank lines and lines starting with # are ignored.
+// Relative roots are relative to the folder of the workspace file
+static Repository *read_workspace(const char *filepath) {
+    char *content;
+    size_t length;
+
+    if (!read_from_file_no_quit(filepath, &content, &length)) {
+        fprintf(stderr, "error: could not read workspace %s: %s\n", filepath, strerror(errno));
+
+        return NULL;
+    }
+
+    char *filepath_copy = strdup(filepath);
+    const char *folder = dirname(filepath_copy);
+
+    Repository *repositories = CL_ARRAY_INIT;
+    char *cursor = content;
+
+    while (cursor < content + length) {
+        char *end = memchr(cursor, '\n', content + length - cursor);
+
+        if (end == NULL) end = content + length;
+
+        char *start = cursor;
+        char *stop = end;
+
+        cursor = end + 1;
+
+        while (start < stop && (*start == ' ' || *start == '\t')) start++;
+        while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t' || stop[-1] == '\r')) stop--;
+
+        if (start == stop || *start == '#') continue;
+
+        Repository repository = { .fd = -1, .pid = -1 };
+
+        repository.root = strndup(start, stop - start);
+        repository.directory = *repository.root == '/' ? strdup(repository.root) : join_paths("%s/%s", folder, repository.root);
+
+        cl_arr_push(repositories, repository);
+    }
+
+    free(content);
+    free(filepath_copy);
+
+    if (cl_arr_len(repositories) == 0) {
+        fprintf(stderr, "error: workspace %s does not list any repository\n", filepath);
+        cl_arr_free(repositories);
+
+        return NULL;
+    }
+
+    return repositories;
+}
+
+// the child runs the action inside the repository and writes NDJSON to the pipe
+static bool spawn_repository(Repository *repository, Arguments *args, int (*run)(Arguments *)) {
+    int fds[2];
+
+    if (pipe(fds) != 0) return false;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+
+        if (dup2(fds[1], STDOUT_FILENO) < 0) _exit(1);
+
+        close(fds[1]);
+
+        if (chdir(repository->directory) != 0) {
+            fprintf(stderr, "error: could not open repository %s: %s\n", repository->root, strerror(errno));
+
+            _exit(1);
+        }
+
+        args->flags.ndjson = true;
+
+        int code = run(args);
+
+        fflush(stdout);
+        _exit(code == 0 ? 0 : 1);
+    }
+
+    close(fds[1]);
+
+    repository->pid = pid;
+    repository->fd = fds[0];
+
+    return true;
+}
+
+// the "score" of a search result, it's always written right after the path
+static int line_score(const char *line, size_t length) {
+    const char *key = ",\"score\":";
+    size_t key_length = strlen(key);
+
+    for (size_t i = 0; i + key_length < length; i++) {
+        if (memcmp(line + i, key, key_length) == 0) return atoi(line + i + key_length);
+    }
+
+    return 0;
+}
+
+static int compare_lines(const void *a, const void *b) {
+    const Output_Line *x = a;
+    const Output_Line *y = b;
+
+    if (x->score != y->score) return y->score - x->score;
+    if (x->repository != y->repository) return x->repository < y->repository ? -1 : 1;
+
+    return x->line < y->line ? -1 : x->line > y->line;
+}
+
+// `{...}` -> `{"repository":"root",...}`
+static void print_with_repository(const char *object, size_t length, const char *root) {
+    printf("{\"repository\":");
+    print_scaped_string_to_fd((wodo_string_t){ .value = root, .length = strlen(root) }, stdout);
+
+    if (length > 2) printf(",");
+
+    fwrite(object + 1, 1, length - 1, stdout);
+}
+
+static void print_merged(Repository *repositories, ArgumentKind kind, Flags flags) {
+    static const char diagnostic_prefix[] = "{\"diagnostic\":";
+    const size_t prefix_length = sizeof(diagnostic_prefix) - 1;
+
+    Output_Line *lines = CL_ARRAY_INIT;
+
+    for (size_t i = 0; i < cl_arr_len(repositories); i++) {
+        const char *cursor = repositories[i].output;
+        const char *end = cursor + repositories[i].length;
+
+        while (cursor < end) {
+            const char *newline = memchr(cursor, '\n', end - cursor);
+            size_t length = (newline == NULL ? end : newline) - cursor;
+
+            if (length > 0 && *cursor == '{') {
+                Output_Line line = { .line = cursor, .length = length, .repository = i };
+
+                if (kind == AK_SEARCH) line.score = line_score(cursor, length);
+
+                cl_arr_push(lines, line);
+            }
+
+            cursor += length + 1;
+        }
+    }
+
+    // search results are ranked across repositories, everything else keeps
+    // the order of the workspace file
+    if (kind == AK_SEARCH && cl_arr_len(lines) > 0) {
+        qsort(lines, cl_arr_len(lines), sizeof(Output_Line), compare_lines);
+
+        if (flags.limit > 0) cl_arr_truncate(lines, flags.limit);
+    }
+
+    if (flags.ndjson) {
+        for (size_t i = 0; i < cl_arr_len(lines); i++) {
+            print_with_repository(lines[i].line, lines[i].length, repositories[lines[i].repository].root);
+            printf("\n");
+        }
+    } else if (kind == AK_SEARCH) {
+        printf("[");
+
+        for (size_t i = 0; i < cl_arr_len(lines); i++) {
+            if (i > 0) printf(",");
+
+            print_with_repository(lines[i].line, lines[i].length, repositories[lines[i].repository].root);
+        }
+
+        printf("]\n");
+    } else {
+        bool first = true;
+
+        printf("{\"files\":[");
+
+        for (size_t i = 0; i < cl_arr_len(lines); i++) {
+            if (lines[i].length >= prefix_length && memcmp(lines[i].line, diagnostic_prefix, prefix_length) == 0) continue;
+
+            if (!first) printf(",");
+
+            print_with_repository(lines[i].line, lines[i].length, repositories[lines[i].repository].root);
+            first = false;
+        }
+
+        printf("],\"diagnostics\":[");
+        first = true;
+
+        for (size_t i = 0; i < cl_arr_len(lines); i++) {
+            if (lines[i].length < prefix_length || memcmp(lines[i].line, diagnostic_prefix, prefix_length) != 0) continue;
+
+            if (!first) printf(",");
+
+            // {"diagnostic":{...}} -> {"repository":"root",...}
+            print_with_repository(lines[i].line + prefix_length, lines[i].length - prefix_length - 1, repositories[lines[i].repository].root);
+            first = false;
+        }
+
+        printf("]}\n");
+    }
+
+    cl_arr_free(lines);
+}
+
+int workspace_action(Arguments *args, int (*run)(Arguments *)) {
+    TRACE_SCOPE("workspace");
+
+    if (args->kind != AK_LIST && args->kind != AK_GET_REMINDERS && args->kind != AK_SEARCH) {
+        fprintf(stderr, "error: --workspace only works with list, reminders and search\n");
+
+        return 1;
+    }
+
+    if (args->flags.follow || args->flags.format != OF_JSON || args->flags.sort != NULL) {
+        fprintf(stderr, "error: --workspace does not support --follow, --sort and --format msgpack\n");
+
+        return 1;
+    }
+
+    Repository *repositories = read_workspace(args->workspace);
+
+    if (repositories == NULL) return 1;
+
+    size_t count = cl_arr_len(repositories);
+    struct pollfd *fds = calloc(count, sizeof(struct pollfd));
+    size_t open_count = 0;
+    int return_code = 0;
+
+    // every repository loads and parses its files in its own process, so
+    // the whole thing takes about as long as the slowest one
+    for (size_t i = 0; i < count; i++) {
+        if (!spawn_repository(&repositories[i], args, run)) {
+            fprintf(stderr, "error: could not start a process for %s: %s\n", repositories[i].root, strerror(errno));
+            return_code = 1;
+        } else {
+            open_count++;
+        }
+
+        fds[i] = (struct pollfd){ .fd = repositories[i].fd, .events = POLLIN };
+    }
+
+    char chunk[65536];
+
+    while (open_count > 0) {
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+
+            fprintf(stderr, "error: could not wait for the repositories: %s\n", strerror(errno));
+            return_code = 1;
+
+            break;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (fds[i].fd < 0 || fds[i].revents == 0) continue;
+
+            ssize_t size = read(fds[i].fd, chunk, sizeof(chunk));
+
+            if (size > 0) {
+                append_output(&repositories[i], chunk, size);
+            } else if (size == 0 || errno != EINTR) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                repositories[i].fd = -1;
+                open_count--;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (repositories[i].pid < 0) continue;
+
+        if (repositories[i].fd >= 0) close(repositories[i].fd);
+
+        while (waitpid(repositories[i].pid, &repositories[i].status, 0) < 0 && errno == EINTR);
+
+        if (!WIFEXITED(repositories[i].status) || WEXITSTATUS(repositories[i].status) != 0) return_code = 1;
+    }
+
+    print_merged(repositories, args->kind, args->flags);
+
+    for (size_t i = 0; i < count; i++) {
+        free(repositories[i].root);
+        free(repositories[i].directory);
+        free(repositories[i].output);
+    }
+
+    free(fds);
+    cl_arr_free(repositories);
+
+    return return_code;
+}
@@ -0,0 +1,14 @@
+#ifndef _WODO_WORKSPACE_H_
+#define _WODO_WORKSPACE_H_
+
+#include "argparser.h"
+
+// `wodo <list|reminders|search> --workspace <file>`
+//
+// the workspace file lists repository roots, one per line. `run` is forked
+// once per repository, inside of it, and the NDJSON every one of them prints
+// is merged in the order of the workspace file (search results are ranked by
+// score) with a "repository" field added to every object.
+int workspace_action(Arguments *args, int (*run)(Arguments *));
+
+#endif // !_WODO_WORKSPACE_H_